@@ -0,0 +1,205 @@
+#include "app/console.h"
+#include "app/params.h"
+#include "drivers/uart.h"
+#include "drivers/adc.h"
+#include "drivers/i2c.h"
+#include "drivers/millis.h"
+#include "common/assert_handler.h"
+#include "common/trace.h"
+#include "common/defines.h"
+#include <stdbool.h>
+#include <string.h>
+
+#define CONSOLE_LINE_SIZE (24u)
+#define CONSOLE_ARG_MAX (3u)
+
+static char line[CONSOLE_LINE_SIZE];
+static uint8_t line_len = 0;
+static bool line_overflow = false;
+// Since the last reset, to compute the ADC sample rate
+static uint32_t stats_ms = 0;
+static uint32_t stats_adc_sequence_cnt = 0;
+
+static bool initialized = false;
+void console_init(void)
+{
+    ASSERT(!initialized);
+    uart_init();
+    initialized = true;
+}
+
+// Decimal only, false if not a number or larger than 16 bits
+static bool parse_u16(const char *string, uint16_t *value)
+{
+    uint32_t result = 0;
+    if (*string == '\0') {
+        return false;
+    }
+    for (; *string; string++) {
+        if (*string < '0' || *string > '9') {
+            return false;
+        }
+        result = result * 10 + (uint8_t)(*string - '0');
+        if (result > UINT16_MAX) {
+            return false;
+        }
+    }
+    *value = (uint16_t)result;
+    return true;
+}
+
+// Splits the line in place on spaces, returns the number of arguments
+static uint8_t split(char *string, char *args[CONSOLE_ARG_MAX])
+{
+    uint8_t count = 0;
+    while (*string) {
+        while (*string == ' ') {
+            *string++ = '\0';
+        }
+        if (*string == '\0') {
+            break;
+        }
+        if (count == CONSOLE_ARG_MAX) {
+            return CONSOLE_ARG_MAX + 1;
+        }
+        args[count++] = string;
+        while (*string && *string != ' ') {
+            string++;
+        }
+    }
+    return count;
+}
+
+static void trace_param(param_e param)
+{
+    UNUSED(param);
+    TRACE("%s %u", params_name(param), params_get(param));
+}
+
+static void cmd_get(char *args[], uint8_t count)
+{
+    if (count == 1) {
+        for (uint8_t param = 0; param < PARAM_COUNT; param++) {
+            trace_param(param);
+        }
+        return;
+    }
+    const param_e param = params_find(args[1]);
+    if (param == PARAM_COUNT) {
+        TRACE("Unknown parameter %s", args[1]);
+        return;
+    }
+    trace_param(param);
+}
+
+static void cmd_set(char *args[], uint8_t count)
+{
+    if (count != 3) {
+        TRACE("Usage: set <name> <value>");
+        return;
+    }
+    const param_e param = params_find(args[1]);
+    uint16_t value = 0;
+    if (param == PARAM_COUNT) {
+        TRACE("Unknown parameter %s", args[1]);
+    } else if (!parse_u16(args[2], &value) || !params_set(param, value)) {
+        TRACE("Invalid value %s", args[2]);
+    } else {
+        trace_param(param);
+    }
+}
+
+static void trace_uart_stats(void)
+{
+    struct uart_stats stats;
+    uart_get_stats(&stats);
+    TRACE("uart: tx dropped %u blocked %u rx dropped %u", stats.tx_dropped, stats.tx_blocked,
+          stats.rx_dropped);
+}
+
+static void trace_adc_stats(void)
+{
+    // In tenths of a second, to not overflow (for ~10 hours)
+    const uint32_t tenths = (millis() - stats_ms) / 100;
+    const uint32_t sequences = adc_get_sequence_count() - stats_adc_sequence_cnt;
+    UNUSED(tenths);
+    UNUSED(sequences);
+    TRACE("adc: %lu sequences/s, isr max %u cycles",
+          (unsigned long)(tenths ? sequences * 10 / tenths : 0), adc_get_isr_cycles_max());
+}
+
+static void trace_i2c_stats(void)
+{
+    TRACE("i2c: isr max %u cycles", i2c_get_isr_cycles_max());
+}
+
+static void reset_stats(void)
+{
+    uart_reset_stats();
+    stats_ms = millis();
+    stats_adc_sequence_cnt = adc_get_sequence_count();
+    adc_reset_isr_cycles_max();
+    i2c_reset_isr_cycles_max();
+}
+
+static console_request_e handle_line(char *string)
+{
+    char *args[CONSOLE_ARG_MAX];
+    const uint8_t count = split(string, args);
+    if (count == 0) {
+        return CONSOLE_REQUEST_NONE;
+    } else if (count > CONSOLE_ARG_MAX) {
+        TRACE("Too many arguments");
+    } else if (strcmp(args[0], "get") == 0) {
+        cmd_get(args, count);
+    } else if (strcmp(args[0], "set") == 0) {
+        cmd_set(args, count);
+    } else if (strcmp(args[0], "defaults") == 0) {
+        return CONSOLE_REQUEST_DEFAULTS;
+    } else if (strcmp(args[0], "save") == 0) {
+        return CONSOLE_REQUEST_SAVE;
+    } else if (strcmp(args[0], "stats") == 0) {
+        trace_uart_stats();
+        trace_adc_stats();
+        trace_i2c_stats();
+        return CONSOLE_REQUEST_STATS;
+    } else if (strcmp(args[0], "reset") == 0) {
+        reset_stats();
+        return CONSOLE_REQUEST_RESET;
+    } else if (strcmp(args[0], "start") == 0) {
+        return CONSOLE_REQUEST_START;
+    } else if (strcmp(args[0], "stop") == 0) {
+        return CONSOLE_REQUEST_STOP;
+    } else {
+        TRACE("Unknown command %s", args[0]);
+    }
+    return CONSOLE_REQUEST_NONE;
+}
+
+console_request_e console_process(void)
+{
+    ASSERT(initialized);
+    uint8_t c;
+    // Read one at a time to stop after a request, the rest stays buffered until the next call
+    while (uart_read(&c, 1)) {
+        if (c == '\r' || c == '\n') {
+            const bool overflow = line_overflow;
+            line[line_len] = '\0';
+            line_len = 0;
+            line_overflow = false;
+            if (overflow) {
+                TRACE("Line too long");
+                continue;
+            }
+            const console_request_e request = handle_line(line);
+            if (request != CONSOLE_REQUEST_NONE) {
+                return request;
+            }
+        } else if (line_len < CONSOLE_LINE_SIZE - 1) {
+            line[line_len++] = (char)c;
+        } else {
+            line_overflow = true;
+        }
+    }
+    return CONSOLE_REQUEST_NONE;
+}
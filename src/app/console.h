@@ -0,0 +1,33 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+/* Line-based command console on the UART, for tuning without rebuilding. Replies are
+ * traced, so they need a build with traces (e.g. TRACE=TOKENIZED on target).
+ *
+ * get [name]          print a parameter (all if no name)
+ * set <name> <value>  change a parameter (see params.h)
+ * defaults            restore the compiled default parameters (only when stopped)
+ * save                save the parameters to flash (loaded at boot, only when stopped)
+ * stats               print the UART, ADC, I2C and loop stats (the I2C interrupt maximum
+ *                     hasn't been measured on the robot yet, see i2c.h)
+ * reset               reset the stats
+ * start / stop        start and stop the robot (like the remote control) */
+
+typedef enum
+{
+    CONSOLE_REQUEST_NONE,
+    CONSOLE_REQUEST_START,
+    CONSOLE_REQUEST_STOP,
+    CONSOLE_REQUEST_STATS,
+    CONSOLE_REQUEST_RESET,
+    CONSOLE_REQUEST_DEFAULTS,
+    CONSOLE_REQUEST_SAVE,
+} console_request_e;
+
+void console_init(void);
+/* Handles the lines received since the last call. Parameter commands are handled here, the
+ * rest is returned for the state machine (one request per call, so call it until it returns
+ * CONSOLE_REQUEST_NONE, the lines after a request stay buffered until then). */
+console_request_e console_process(void);
+
+#endif // CONSOLE_H
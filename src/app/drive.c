@@ -1,4 +1,5 @@
 #include "app/drive.h"
+#include "app/params.h"
 #include "drivers/tb6612fng.h"
 #include "common/assert_handler.h"
 #include "common/defines.h"
@@ -68,31 +69,38 @@ static void drive_inverse_speeds(int8_t *speed_left, int8_t *speed_right)
     }
 }
 
+// Scales the table speeds down by the speed parameter (percent), e.g. for a slippery dohyo
+static inline int8_t drive_scale_speed(int8_t speed, int16_t percent)
+{
+    // Skip the division (no hardware multiplier/divider) in the common case
+    if (percent == 100) {
+        return speed;
+    }
+    return (int8_t)((speed * percent) / 100);
+}
+
 void drive_set(drive_dir_e direction, drive_speed_e speed)
 {
     drive_dir_e primary_direction = DRIVE_PRIMARY_DIRECTION(direction);
-    int8_t speed_left = drive_primary_speeds[primary_direction][speed].left;
-    int8_t speed_right = drive_primary_speeds[primary_direction][speed].right;
+    const struct drive_speeds *speeds = &drive_primary_speeds[primary_direction][speed];
+    const int16_t percent = (int16_t)params_get(PARAM_DRIVE_SPEED);
+    int8_t speed_left = drive_scale_speed(speeds->left, percent);
+    int8_t speed_right = drive_scale_speed(speeds->right, percent);
     if (direction != primary_direction) {
         drive_inverse_speeds(&speed_left, &speed_right);
     }
     ASSERT(speed_left != 0 && speed_right != 0);
     const tb6612fng_mode_e mode_left =
         speed_left > 0 ? TB6612FNG_MODE_FORWARD : TB6612FNG_MODE_REVERSE;
-    tb6612fng_set_mode(TB6612FNG_LEFT, mode_left);
     const tb6612fng_mode_e mode_right =
         speed_right > 0 ? TB6612FNG_MODE_FORWARD : TB6612FNG_MODE_REVERSE;
-    tb6612fng_set_mode(TB6612FNG_RIGHT, mode_right);
-    tb6612fng_set_pwm(TB6612FNG_LEFT, ABS(speed_left));
-    tb6612fng_set_pwm(TB6612FNG_RIGHT, ABS(speed_right));
+    // Ignored until the line is handled if the line interrupt drove the motors (see line.c)
+    tb6612fng_set_motors(mode_left, ABS(speed_left), mode_right, ABS(speed_right));
 }
 
 void drive_stop(void)
 {
-    tb6612fng_set_mode(TB6612FNG_LEFT, TB6612FNG_MODE_STOP);
-    tb6612fng_set_mode(TB6612FNG_RIGHT, TB6612FNG_MODE_STOP);
-    tb6612fng_set_pwm(TB6612FNG_LEFT, 0);
-    tb6612fng_set_pwm(TB6612FNG_RIGHT, 0);
+    tb6612fng_set_motors(TB6612FNG_MODE_STOP, 0, TB6612FNG_MODE_STOP, 0);
 }
 
 static bool initialized = false;
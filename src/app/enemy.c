@@ -1,39 +1,44 @@
 #include "app/enemy.h"
+#include "app/params.h"
 #include "drivers/vl53l0x.h"
 #include "common/assert_handler.h"
 #include "common/trace.h"
 
-#define RANGE_DETECT_THRESHOLD (600u) // mm
 #define INVALID_RANGE (UINT16_MAX)
-#define RANGE_CLOSE (100u) // mm
-#define RANGE_MID (200u) // mm
-#define RANGE_FAR (300u) // mm
+
+static bool fresh_values = false;
+
+static const vl53l0x_profile_e sensing_profiles[] = {
+    [ENEMY_SENSING_LONG_RANGE] = VL53L0X_PROFILE_LONG_RANGE,
+    [ENEMY_SENSING_HIGH_SPEED] = VL53L0X_PROFILE_HIGH_SPEED,
+};
 
 struct enemy enemy_get(void)
 {
     struct enemy enemy = { ENEMY_POS_NONE, ENEMY_RANGE_NONE };
     vl53l0x_ranges_t ranges;
-    bool fresh_values = false;
+    fresh_values = false;
     vl53l0x_result_e result = vl53l0x_read_range_multiple(ranges, &fresh_values);
     if (result) {
         TRACE("read range failed %u", result);
         return enemy;
     }
 
-    const uint16_t range_front = ranges[VL53L0X_IDX_FRONT];
-    const uint16_t range_front_left = ranges[VL53L0X_IDX_FRONT_LEFT];
-    const uint16_t range_front_right = ranges[VL53L0X_IDX_FRONT_RIGHT];
+    const uint16_t range_front = ranges[VL53L0X_IDX_FRONT].range;
+    const uint16_t range_front_left = ranges[VL53L0X_IDX_FRONT_LEFT].range;
+    const uint16_t range_front_right = ranges[VL53L0X_IDX_FRONT_RIGHT].range;
 #if 0 // Skip left and right (badly mounted on the robot)
-    const uint16_t range_left = ranges[VL53L0X_IDX_LEFT];
-    const uint16_t range_right = ranges[VL53L0X_IDX_RIGHT];
+    const uint16_t range_left = ranges[VL53L0X_IDX_LEFT].range;
+    const uint16_t range_right = ranges[VL53L0X_IDX_RIGHT].range;
 #endif
 
-    const bool front = range_front < RANGE_DETECT_THRESHOLD;
-    const bool front_left = range_front_left < RANGE_DETECT_THRESHOLD;
-    const bool front_right = range_front_right < RANGE_DETECT_THRESHOLD;
+    const uint16_t range_detect_threshold = params_get(PARAM_ENEMY_RANGE);
+    const bool front = range_front < range_detect_threshold;
+    const bool front_left = range_front_left < range_detect_threshold;
+    const bool front_right = range_front_right < range_detect_threshold;
 #if 0 // Skip left and right (badly mounted on the robot)
-    const bool left = range_left < RANGE_DETECT_THRESHOLD;
-    const bool right = range_right < RANGE_DETECT_THRESHOLD;
+    const bool left = range_left < range_detect_threshold;
+    const bool right = range_right < range_detect_threshold;
 #endif
 
     uint16_t range = INVALID_RANGE;
@@ -90,9 +95,9 @@ struct enemy enemy_get(void)
         return enemy;
     }
 
-    if (range < RANGE_CLOSE) {
+    if (range < params_get(PARAM_ENEMY_RANGE_CLOSE)) {
         enemy.range = ENEMY_RANGE_CLOSE;
-    } else if (range < RANGE_MID) {
+    } else if (range < params_get(PARAM_ENEMY_RANGE_MID)) {
         enemy.range = ENEMY_RANGE_MID;
     } else {
         enemy.range = ENEMY_RANGE_FAR;
@@ -101,6 +106,19 @@ struct enemy enemy_get(void)
     return enemy;
 }
 
+bool enemy_fresh(void)
+{
+    return fresh_values;
+}
+
+void enemy_set_sensing(enemy_sensing_e sensing)
+{
+    const vl53l0x_result_e result = vl53l0x_set_profile(sensing_profiles[sensing]);
+    if (result) {
+        TRACE("set profile failed %u", result);
+    }
+}
+
 bool enemy_detected(const struct enemy *enemy)
 {
     return enemy->position != ENEMY_POS_NONE && enemy->position != ENEMY_POS_IMPOSSIBLE;
@@ -132,5 +150,17 @@ void enemy_init(void)
         TRACE("Failed to initialize vl53l0x %u", result);
         return;
     }
+    // Let the sensors free-run, so reading them doesn't have to start every measurement
+    result = vl53l0x_set_ranging(VL53L0X_RANGING_CONTINUOUS, 0);
+    if (result) {
+        TRACE("Failed to set vl53l0x ranging %u", result);
+        return;
+    }
+    // Start with the search profile, this blocks, but later changes don't (see enemy_set_sensing)
+    result = vl53l0x_set_profile(sensing_profiles[ENEMY_SENSING_LONG_RANGE]);
+    if (result) {
+        TRACE("Failed to set vl53l0x profile %u", result);
+        return;
+    }
     initialized = true;
 }
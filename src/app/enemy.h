@@ -28,6 +28,13 @@ typedef enum
     ENEMY_RANGE_FAR,
 } enemy_range_e;
 
+// Trade-off of the range sensors between range and update rate
+typedef enum
+{
+    ENEMY_SENSING_LONG_RANGE,
+    ENEMY_SENSING_HIGH_SPEED,
+} enemy_sensing_e;
+
 struct enemy
 {
     enemy_pos_e position;
@@ -36,6 +43,11 @@ struct enemy
 
 void enemy_init(void);
 struct enemy enemy_get(void);
+// True if the last enemy_get was based on new range measurements (not cached ones)
+bool enemy_fresh(void);
+/* Doesn't block once enemy_get has started the sensors, they are then reconfigured in the
+ * background one at a time (see vl53l0x_set_timing_budget) */
+void enemy_set_sensing(enemy_sensing_e sensing);
 bool enemy_detected(const struct enemy *enemy);
 bool enemy_at_left(const struct enemy *enemy);
 bool enemy_at_right(const struct enemy *enemy);
@@ -1,5 +1,4 @@
 #include "app/input_history.h"
-#include "common/ring_buffer.h"
 
 static bool input_equal(const struct input *a, const struct input *b)
 {
@@ -7,7 +6,7 @@ static bool input_equal(const struct input *a, const struct input *b)
         && a->enemy.range == b->enemy.range;
 }
 
-void input_history_save(struct ring_buffer *history, const struct input *input)
+void input_history_save(struct input_history_buffer *history, const struct input *input)
 {
     // Skip if no input detected
     if (input->enemy.position == ENEMY_POS_NONE && input->line == LINE_NONE) {
@@ -15,24 +14,21 @@ void input_history_save(struct ring_buffer *history, const struct input *input)
     }
 
     // Skip if identical input detected
-    if (ring_buffer_count(history)) {
-        struct input last_input;
-        ring_buffer_peek_head(history, &last_input, 0);
-        if (input_equal(input, &last_input)) {
+    if (input_history_buffer_count(history)) {
+        if (input_equal(input, input_history_buffer_peek_head(history, 0))) {
             return;
         }
     }
 
-    ring_buffer_put(history, input);
+    input_history_buffer_put_overwrite(history, input);
 }
 
-struct enemy input_history_last_directed_enemy(const struct ring_buffer *history)
+struct enemy input_history_last_directed_enemy(const struct input_history_buffer *history)
 {
-    for (uint8_t offset = 0; offset < ring_buffer_count(history); offset++) {
-        struct input input;
-        ring_buffer_peek_head(history, &input, offset);
-        if (enemy_at_left(&input.enemy) || enemy_at_right(&input.enemy)) {
-            return input.enemy;
+    for (uint8_t offset = 0; offset < input_history_buffer_count(history); offset++) {
+        const struct input *input = input_history_buffer_peek_head(history, offset);
+        if (enemy_at_left(&input->enemy) || enemy_at_right(&input->enemy)) {
+            return input->enemy;
         }
     }
     const struct enemy enemy_none = { ENEMY_POS_NONE, ENEMY_RANGE_NONE };
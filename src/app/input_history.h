@@ -3,8 +3,7 @@
 
 #include "app/enemy.h"
 #include "app/line.h"
-
-struct ring_buffer;
+#include "common/ring_buffer.h"
 
 struct input
 {
@@ -12,7 +11,10 @@ struct input
     line_e line;
 };
 
-void input_history_save(struct ring_buffer *history, const struct input *input);
-struct enemy input_history_last_directed_enemy(const struct ring_buffer *history);
+#define INPUT_HISTORY_BUFFER_SIZE (8u)
+DEFINE_RING_BUFFER(input_history_buffer, struct input, INPUT_HISTORY_BUFFER_SIZE)
+
+void input_history_save(struct input_history_buffer *history, const struct input *input);
+struct enemy input_history_last_directed_enemy(const struct input_history_buffer *history);
 
 #endif // INPUT_HISTORY
@@ -0,0 +1,62 @@
+#if defined(INPUT_RECORD)
+#include "app/input_record.h"
+#include "drivers/uart.h"
+#include "common/assert_handler.h"
+#include <assert.h>
+#include <stdbool.h>
+
+#if !defined(DISABLE_TRACE) && !defined(HOST)
+#error "Input record shares the UART with trace, build with DISABLE_TRACE"
+#endif
+
+static_assert(ENEMY_POS_IMPOSSIBLE <= INPUT_RECORD_POS_MASK, "Enemy position must fit");
+static_assert(ENEMY_RANGE_FAR <= INPUT_RECORD_RANGE_MASK, "Enemy range must fit");
+static_assert(LINE_DIAGONAL_RIGHT <= INPUT_RECORD_LINE_MASK, "Line must fit");
+
+static bool initialized = false;
+static uint32_t last_time_ms = 0;
+
+void input_record_init(void)
+{
+    ASSERT(!initialized);
+    uart_init();
+    // A dropped byte would corrupt the rest of the recording
+    uart_set_tx_policy(UART_TX_POLICY_BLOCK);
+    const uint8_t header[INPUT_RECORD_HEADER_SIZE] = { 'N', 'S', 'R', INPUT_RECORD_VERSION };
+    uart_write(header, sizeof(header));
+    initialized = true;
+}
+
+void input_record_save(const struct input_record *record)
+{
+    ASSERT(initialized);
+    const uint32_t delta_ms = record->time_ms - last_time_ms;
+    // The loop never stalls this long
+    ASSERT(delta_ms <= UINT16_MAX);
+    last_time_ms = record->time_ms;
+
+    uint8_t buffer[INPUT_RECORD_MAX_SIZE];
+    uint8_t size = 0;
+    const bool extended = delta_ms >= INPUT_RECORD_DELTA_EXTENDED;
+    const uint8_t delta_field = extended ? INPUT_RECORD_DELTA_EXTENDED : (uint8_t)delta_ms;
+    buffer[size++] = (uint8_t)(delta_field << INPUT_RECORD_DELTA_SHIFT) | record->line;
+    uint8_t enemy = (uint8_t)(record->enemy.position
+                              | (record->enemy.range << INPUT_RECORD_RANGE_SHIFT));
+    if (record->fresh) {
+        enemy |= INPUT_RECORD_FRESH_BIT;
+    }
+    if (record->cmd != IR_CMD_NONE) {
+        enemy |= INPUT_RECORD_CMD_BIT;
+    }
+    buffer[size++] = enemy;
+    if (record->cmd != IR_CMD_NONE) {
+        buffer[size++] = record->cmd;
+    }
+    if (extended) {
+        buffer[size++] = delta_ms & 0xFF;
+        buffer[size++] = delta_ms >> 8;
+    }
+    uart_write(buffer, size);
+}
+
+#endif // INPUT_RECORD
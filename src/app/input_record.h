@@ -0,0 +1,57 @@
+#ifndef INPUT_RECORD_H
+#define INPUT_RECORD_H
+
+/* Records the input of every state machine iteration in a compact binary format, streamed
+ * over UART. The host build can replay a recording through the state machine, which then
+ * makes the same decisions as it did on target (see timer_update).
+ *
+ * Built with RECORD=1 (INPUT_RECORD) and shares the UART with trace, which is disabled on
+ * target. Replay is built with HW=HOST REPLAY=1 (INPUT_REPLAY).
+ *
+ * Format (little-endian)
+ * Header: 'N' 'S' 'R' <version>, sent once at boot
+ * Record: [delta/line] [enemy] [cmd (optional)] [delta 16-bit (optional)]
+ *     delta/line: bits 0-3 line_e, bits 4-7 milliseconds since the previous record, or
+ *                 INPUT_RECORD_DELTA_EXTENDED if a 16-bit delta follows
+ *     enemy:      bits 0-3 enemy_pos_e, bits 4-5 enemy_range_e, bit 6 fresh, bit 7 set if
+ *                 a cmd byte (ir_cmd_e) follows
+ * The loop runs every millisecond without a command most of the time, so most records are
+ * two bytes. */
+
+#include "app/enemy.h"
+#include "app/line.h"
+#include "drivers/ir_remote.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define INPUT_RECORD_VERSION (1u)
+#define INPUT_RECORD_HEADER_SIZE (4u)
+#define INPUT_RECORD_MAX_SIZE (5u)
+
+#define INPUT_RECORD_LINE_MASK (0x0Fu)
+#define INPUT_RECORD_DELTA_SHIFT (4u)
+#define INPUT_RECORD_DELTA_EXTENDED (0x0Fu)
+#define INPUT_RECORD_POS_MASK (0x0Fu)
+#define INPUT_RECORD_RANGE_SHIFT (4u)
+#define INPUT_RECORD_RANGE_MASK (0x03u)
+#define INPUT_RECORD_FRESH_BIT (0x40u)
+#define INPUT_RECORD_CMD_BIT (0x80u)
+
+struct input_record
+{
+    uint32_t time_ms;
+    struct enemy enemy;
+    bool fresh;
+    line_e line;
+    ir_cmd_e cmd;
+};
+
+void input_record_init(void);
+void input_record_save(const struct input_record *record);
+
+#if defined(INPUT_REPLAY)
+// Implemented by the host build (src/sim/sim_replay.c), exits when the recording ends
+void input_replay_next(struct input_record *record);
+#endif
+
+#endif // INPUT_RECORD_H
@@ -1,27 +1,148 @@
 #include "app/line.h"
+#include "app/params.h"
 #include "drivers/qre1113.h"
+#include "drivers/tb6612fng.h"
 #include "common/assert_handler.h"
+#include "common/defines.h"
+#include <assert.h>
 #include <stdbool.h>
 
-// Based on readings from the sensors when they are above the white line
-#define LINE_DETECTED_VOLTAGE_THRESHOLD (700u)
+// Below this difference between the black and white level, no white line was seen
+#define CALIBRATION_CONTRAST_MIN (200u)
+// The threshold is kept this far below the black level (noise and uneven surface)
+#define CALIBRATION_BLACK_MARGIN (100u)
+// To not move the thresholds before the levels have settled
+#define CALIBRATION_SAMPLES_MIN (16u)
+/* The levels are averaged (y += (x - y) / 2^shift), one sample per iteration. The short
+ * average keeps a single sample from setting the white level, and the long one follows the
+ * typical black level, so an outlier (e.g. ~1023 while the robot is lifted) only moves it
+ * for a moment instead of for good. */
+#define CALIBRATION_FRACTION_BITS (4u)
+#define CALIBRATION_LEVEL_SHIFT (2u)
+#define CALIBRATION_BLACK_SHIFT (5u)
+
+typedef enum
+{
+    LINE_SENSOR_FRONT_LEFT,
+    LINE_SENSOR_FRONT_RIGHT,
+    LINE_SENSOR_BACK_LEFT,
+    LINE_SENSOR_BACK_RIGHT,
+    LINE_SENSOR_COUNT
+} line_sensor_e;
+static_assert(PARAM_LINE_BACK_RIGHT - PARAM_LINE_FRONT_LEFT == LINE_SENSOR_BACK_RIGHT,
+              "The threshold parameters must be in the same order as the sensors");
+
+struct calibration
+{
+    int16_t level; // Short average of the samples (CALIBRATION_FRACTION_BITS)
+    int16_t black; // Long average of the levels that aren't white (CALIBRATION_FRACTION_BITS)
+    uint16_t white; // Lowest level
+};
+
+#define QRE1113_FRONT (QRE1113_FRONT_LEFT | QRE1113_FRONT_RIGHT)
+#define QRE1113_BACK (QRE1113_BACK_LEFT | QRE1113_BACK_RIGHT)
+#define EMERGENCY_DUTY_CYCLE (100u)
+
+static bool detected[LINE_SENSOR_COUNT];
+// Set from the ADC interrupt
+static volatile uint8_t edge_sensors = 0;
+static volatile bool emergency_armed = false;
+static struct calibration calibrations[LINE_SENSOR_COUNT];
+static uint16_t calibration_samples = 0;
+
+static void get_voltages(uint16_t voltages[LINE_SENSOR_COUNT])
+{
+    struct qre1113_voltages qre1113_voltages;
+    qre1113_get_voltages(&qre1113_voltages);
+    voltages[LINE_SENSOR_FRONT_LEFT] = qre1113_voltages.front_left;
+    voltages[LINE_SENSOR_FRONT_RIGHT] = qre1113_voltages.front_right;
+    voltages[LINE_SENSOR_BACK_LEFT] = qre1113_voltages.back_left;
+    voltages[LINE_SENSOR_BACK_RIGHT] = qre1113_voltages.back_right;
+}
+
+static bool sensor_detect(line_sensor_e sensor, uint16_t voltage)
+{
+    uint16_t threshold = params_get(PARAM_LINE_FRONT_LEFT + sensor);
+    // Hysteresis, so a sample close to the threshold doesn't toggle the detection
+    if (detected[sensor]) {
+        threshold += params_get(PARAM_LINE_HYSTERESIS);
+    }
+    detected[sensor] = voltage < threshold;
+    return detected[sensor];
+}
+
+/* Directly through the motor driver, since drive_set isn't meant for interrupt context. The
+ * command stays until line_get has passed the edge on, so the main loop doesn't override it
+ * with a command from before the edge. */
+static void emergency_set_mode(tb6612fng_mode_e mode)
+{
+    const uint8_t duty_cycle = mode == TB6612FNG_MODE_STOP ? 0 : EMERGENCY_DUTY_CYCLE;
+    tb6612fng_post_emergency(mode, duty_cycle);
+}
+
+// Interrupt context
+static void isr_line_edge(uint8_t sensors)
+{
+    edge_sensors |= sensors;
+    if (!emergency_armed || !params_get(PARAM_LINE_EMERGENCY)) {
+        return;
+    }
+    if (!(sensors & QRE1113_BACK)) {
+        emergency_set_mode(TB6612FNG_MODE_REVERSE);
+    } else if (!(sensors & QRE1113_FRONT)) {
+        emergency_set_mode(TB6612FNG_MODE_FORWARD);
+    } else {
+        emergency_set_mode(TB6612FNG_MODE_STOP);
+    }
+}
+
+// The thresholds may change (calibration, console), so pass them on before each read
+static void update_edge_thresholds(void)
+{
+    const struct qre1113_voltages thresholds = {
+        .front_left = params_get(PARAM_LINE_FRONT_LEFT),
+        .front_right = params_get(PARAM_LINE_FRONT_RIGHT),
+        .back_left = params_get(PARAM_LINE_BACK_LEFT),
+        .back_right = params_get(PARAM_LINE_BACK_RIGHT),
+    };
+    qre1113_set_thresholds(&thresholds);
+}
 
 static bool initialized = false;
 void line_init(void)
 {
     ASSERT(!initialized);
     qre1113_init();
+    update_edge_thresholds();
+    qre1113_set_line_isr(isr_line_edge);
     initialized = true;
 }
 
+void line_arm_emergency(bool armed)
+{
+    emergency_armed = armed;
+}
+
 line_e line_get(void)
 {
-    struct qre1113_voltages voltages;
-    qre1113_get_voltages(&voltages);
-    const bool front_left = voltages.front_left < LINE_DETECTED_VOLTAGE_THRESHOLD;
-    const bool front_right = voltages.front_right < LINE_DETECTED_VOLTAGE_THRESHOLD;
-    const bool back_left = voltages.back_left < LINE_DETECTED_VOLTAGE_THRESHOLD;
-    const bool back_right = voltages.back_right < LINE_DETECTED_VOLTAGE_THRESHOLD;
+    update_edge_thresholds();
+    /* Before reading the edges, so an emergency command posted after this is kept until the
+     * next call, the state machine reacts to the edges read here */
+    tb6612fng_clear_emergency();
+    // Clear only the ones read, a single instruction (bic), so no edge is lost in between
+    const uint8_t edges = edge_sensors;
+    edge_sensors &= ~edges;
+    uint16_t voltages[LINE_SENSOR_COUNT];
+    get_voltages(voltages);
+    const bool front_left = sensor_detect(LINE_SENSOR_FRONT_LEFT, voltages[LINE_SENSOR_FRONT_LEFT])
+        || (edges & QRE1113_FRONT_LEFT);
+    const bool front_right =
+        sensor_detect(LINE_SENSOR_FRONT_RIGHT, voltages[LINE_SENSOR_FRONT_RIGHT])
+        || (edges & QRE1113_FRONT_RIGHT);
+    const bool back_left = sensor_detect(LINE_SENSOR_BACK_LEFT, voltages[LINE_SENSOR_BACK_LEFT])
+        || (edges & QRE1113_BACK_LEFT);
+    const bool back_right = sensor_detect(LINE_SENSOR_BACK_RIGHT, voltages[LINE_SENSOR_BACK_RIGHT])
+        || (edges & QRE1113_BACK_RIGHT);
 
     if (front_left) {
         if (front_right) {
@@ -52,3 +173,74 @@ line_e line_get(void)
     }
     return LINE_NONE;
 }
+
+static inline uint16_t calibration_round(int16_t value)
+{
+    return (uint16_t)(value + (1 << (CALIBRATION_FRACTION_BITS - 1))) >> CALIBRATION_FRACTION_BITS;
+}
+
+static void calibration_sample(struct calibration *calibration, uint16_t voltage)
+{
+    const int16_t value = (int16_t)(voltage << CALIBRATION_FRACTION_BITS);
+    if (calibration_samples == 0) {
+        // Start from the first sample, not from 0 (which would look like the line)
+        calibration->level = value;
+        calibration->black = value;
+        calibration->white = UINT16_MAX;
+    }
+    calibration->level += (int16_t)(value - calibration->level) >> CALIBRATION_LEVEL_SHIFT;
+    const uint16_t level = calibration_round(calibration->level);
+    if (level < calibration->white) {
+        calibration->white = level;
+    }
+    // Once the line has been seen, leave the levels closer to white than black out
+    const uint16_t black = calibration_round(calibration->black);
+    const bool line_seen = black >= calibration->white + CALIBRATION_CONTRAST_MIN;
+    if (!line_seen || level > calibration->white + (black - calibration->white) / 2) {
+        calibration->black +=
+            (int16_t)((int16_t)(level << CALIBRATION_FRACTION_BITS) - calibration->black)
+            >> CALIBRATION_BLACK_SHIFT;
+    }
+}
+
+static void calibrate_sensor(line_sensor_e sensor)
+{
+    const struct calibration *calibration = &calibrations[sensor];
+    const param_e param = PARAM_LINE_FRONT_LEFT + sensor;
+    const uint16_t black = calibration_round(calibration->black);
+    if (black <= CALIBRATION_BLACK_MARGIN) {
+        return;
+    }
+    // Never closer to the typical black level than the margin, so black isn't seen as line
+    const uint16_t threshold_max = black - CALIBRATION_BLACK_MARGIN;
+    if (black >= calibration->white + CALIBRATION_CONTRAST_MIN) {
+        /* Both levels are known, place the threshold closer to black than white, so the edge
+         * is detected as early as possible, with a quarter of the contrast as margin. */
+        const uint16_t threshold = black - (black - calibration->white) / 4;
+        params_set(param, threshold < threshold_max ? threshold : threshold_max);
+    } else if (params_get(param) > threshold_max) {
+        // Only black is known, only lower the threshold if it's too close to black
+        params_set(param, threshold_max);
+    }
+}
+
+void line_calibrate(void)
+{
+    uint16_t voltages[LINE_SENSOR_COUNT];
+    get_voltages(voltages);
+    for (uint8_t sensor = 0; sensor < LINE_SENSOR_COUNT; sensor++) {
+        calibration_sample(&calibrations[sensor], voltages[sensor]);
+    }
+    if (calibration_samples < CALIBRATION_SAMPLES_MIN) {
+        calibration_samples++;
+        return;
+    }
+    for (uint8_t sensor = 0; sensor < LINE_SENSOR_COUNT; sensor++) {
+        calibrate_sensor(sensor);
+    }
+}
+
+void line_calibrate_restart(void)
+{
+    calibration_samples = 0;
+}
@@ -3,6 +3,8 @@
 
 // Detect the boundary line of the circular sumobot platform
 
+#include <stdbool.h>
+
 typedef enum
 {
     LINE_NONE,
@@ -19,6 +21,22 @@ typedef enum
 } line_e;
 
 void line_init(void);
+/* Includes an edge seen by the ADC interrupt since the last call, even if the sensor has
+ * left the line again since then. */
 line_e line_get(void);
+/* When armed (and PARAM_LINE_EMERGENCY is set), an edge makes the ADC interrupt drive the
+ * motors away from the line at full speed right away, instead of when the state machine gets
+ * to it (which may be blocked on the range sensors). It reverses from the front sensors,
+ * goes forward from the back sensors, and stops if both see the line. The state machine
+ * overrides it when it handles the line event. */
+void line_arm_emergency(bool armed);
+/* Samples the sensors to calibrate the per-sensor thresholds (PARAM_LINE_*), called each
+ * iteration while waiting for the start. Keep the robot on the dohyo, and slide it over the
+ * white line to place the thresholds between the typical black level and the white level of
+ * each sensor. Without the white line, a threshold is only lowered if it's too close to the
+ * black level. */
+void line_calibrate(void);
+// Forgets the levels seen so far, e.g. after the robot has been moved to another dohyo
+void line_calibrate_restart(void);
 
 #endif // LINE_H
@@ -0,0 +1,238 @@
+#include "app/params.h"
+#include "drivers/flash.h"
+#include "common/assert_handler.h"
+#include "common/trace.h"
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
+/* The parameters are saved as a block in one of the information flash segments B-D. Each
+ * save goes to the next segment with an incremented sequence number, and the valid block with
+ * the highest sequence number is loaded at boot, so a reset or power loss in the middle of a
+ * save leaves the previous block intact (and spreads the wear over the segments).
+ *
+ * A block is valid if the magic, version, count and CRC match, and the enemy ranges are in
+ * order (see ranges_ordered). Bump PARAMS_VERSION when the
+ * meaning of the parameters changes (e.g. reordered or different units), since the block is
+ * then ignored and the defaults are used instead. */
+
+#define PARAMS_MAGIC (0x5053u) // "SP"
+#define PARAMS_VERSION (2u)
+#define CRC16_INIT (0xFFFFu)
+#define CRC16_POLYNOMIAL (0x1021u) // CCITT
+
+struct param_cfg
+{
+    const char *name;
+    uint16_t default_value;
+    uint16_t min;
+    uint16_t max;
+};
+
+static const struct param_cfg param_cfgs[] = {
+    [PARAM_ENEMY_RANGE] = { "range", 600, 50, 1200 },
+    [PARAM_ENEMY_RANGE_CLOSE] = { "close", 100, 10, 1200 },
+    [PARAM_ENEMY_RANGE_MID] = { "mid", 200, 10, 1200 },
+    // Based on readings from the sensors when they are above the white line
+    [PARAM_LINE_FRONT_LEFT] = { "line_fl", 700, 1, 1023 },
+    [PARAM_LINE_FRONT_RIGHT] = { "line_fr", 700, 1, 1023 },
+    [PARAM_LINE_BACK_LEFT] = { "line_bl", 700, 1, 1023 },
+    [PARAM_LINE_BACK_RIGHT] = { "line_br", 700, 1, 1023 },
+    [PARAM_LINE_HYSTERESIS] = { "line_hyst", 30, 0, 200 },
+    [PARAM_LINE_CALIBRATE] = { "line_cal", 1, 0, 1 },
+    [PARAM_LINE_EMERGENCY] = { "line_emerg", 1, 0, 1 },
+    // Can only slow down, since the fastest speeds are already at max
+    [PARAM_DRIVE_SPEED] = { "speed", 100, 20, 100 },
+    [PARAM_SEARCH_ROTATE_MS] = { "search_rot", 400, 50, 5000 },
+    [PARAM_SEARCH_FORWARD_MS] = { "search_fwd", 3000, 100, 10000 },
+    [PARAM_ATTACK_TIMEOUT_MS] = { "attack", 5000, 500, 20000 },
+    [PARAM_RETREAT_REVERSE_MS] = { "ret_rev", 300, 50, 2000 },
+    [PARAM_RETREAT_FORWARD_MS] = { "ret_fwd", 300, 50, 2000 },
+    [PARAM_RETREAT_ROTATE_MS] = { "ret_rot", 150, 50, 2000 },
+    [PARAM_RETREAT_ARCTURN_MS] = { "ret_arc", 150, 50, 2000 },
+    [PARAM_RETREAT_ALIGN_TURN_MS] = { "align_turn", 250, 50, 2000 },
+    [PARAM_RETREAT_ALIGN_ARC_MS] = { "align_arc", 300, 50, 2000 },
+};
+static_assert(sizeof(param_cfgs) / sizeof(param_cfgs[0]) == PARAM_COUNT, "Missing parameter");
+
+struct params_block
+{
+    uint16_t magic;
+    uint8_t version;
+    uint8_t count;
+    uint16_t sequence;
+    uint16_t values[PARAM_COUNT];
+    uint16_t crc; // Of the fields above
+};
+static_assert(sizeof(struct params_block) <= FLASH_INFO_SEGMENT_SIZE, "Block too large");
+
+static uint16_t values[PARAM_COUNT];
+// Where the last block was loaded from or saved to
+static flash_info_segment_e block_segment = FLASH_INFO_SEGMENT_COUNT;
+static uint16_t block_sequence = 0;
+
+// Bitwise to save flash, only computed when loading and saving
+static uint16_t crc16(const uint8_t *data, uint8_t size)
+{
+    uint16_t crc = CRC16_INIT;
+    for (uint8_t i = 0; i < size; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            if (crc & 0x8000u) {
+                crc = (uint16_t)(crc << 1) ^ CRC16_POLYNOMIAL;
+            } else {
+                crc = (uint16_t)(crc << 1);
+            }
+        }
+    }
+    return crc;
+}
+
+// The enemy range thresholds split the distance into close, mid and far, so must be in order
+static bool ranges_ordered(const uint16_t *param_values)
+{
+    return param_values[PARAM_ENEMY_RANGE_CLOSE] < param_values[PARAM_ENEMY_RANGE_MID]
+        && param_values[PARAM_ENEMY_RANGE_MID] < param_values[PARAM_ENEMY_RANGE];
+}
+
+static bool value_in_range(param_e param, uint16_t value)
+{
+    return value >= param_cfgs[param].min && value <= param_cfgs[param].max;
+}
+
+static bool block_valid(const struct params_block *block)
+{
+    return block->magic == PARAMS_MAGIC && block->version == PARAMS_VERSION
+        && block->count == PARAM_COUNT
+        && block->crc == crc16((const uint8_t *)block, offsetof(struct params_block, crc))
+        && ranges_ordered(block->values);
+}
+
+// The newest valid block, or NULL if there is none
+static const struct params_block *find_block(void)
+{
+    const struct params_block *newest = NULL;
+    for (flash_info_segment_e segment = 0; segment < FLASH_INFO_SEGMENT_COUNT; segment++) {
+        const struct params_block *block = flash_info_read(segment);
+        if (!block_valid(block)) {
+            continue;
+        }
+        // Signed difference, so the sequence number can wrap around
+        if (newest == NULL || (int16_t)(block->sequence - newest->sequence) > 0) {
+            newest = block;
+            block_segment = segment;
+        }
+    }
+    return newest;
+}
+
+static void load_block(void)
+{
+    const struct params_block *block = find_block();
+    if (block == NULL) {
+        TRACE("No saved parameters, using defaults");
+        return;
+    }
+    block_sequence = block->sequence;
+    /* Not through params_set, since the enemy ranges are only in order as a whole (one at a
+     * time, they may not be in order with the defaults) */
+    for (uint8_t param = 0; param < PARAM_COUNT; param++) {
+        // Keep the default if the allowed range has changed since the block was saved
+        if (value_in_range(param, block->values[param])) {
+            values[param] = block->values[param];
+        } else {
+            TRACE("Invalid saved %s %u", param_cfgs[param].name, block->values[param]);
+        }
+    }
+    // A default kept above may be out of order with the saved ranges
+    if (!ranges_ordered(values)) {
+        TRACE("Invalid saved ranges, using defaults");
+        values[PARAM_ENEMY_RANGE] = param_cfgs[PARAM_ENEMY_RANGE].default_value;
+        values[PARAM_ENEMY_RANGE_CLOSE] = param_cfgs[PARAM_ENEMY_RANGE_CLOSE].default_value;
+        values[PARAM_ENEMY_RANGE_MID] = param_cfgs[PARAM_ENEMY_RANGE_MID].default_value;
+    }
+}
+
+static bool initialized = false;
+void params_init(void)
+{
+    ASSERT(!initialized);
+    flash_init();
+    params_reset();
+    load_block();
+    initialized = true;
+}
+
+bool params_save(void)
+{
+    flash_info_segment_e segment = 0;
+    if (block_segment != FLASH_INFO_SEGMENT_COUNT) {
+        const struct params_block *current = flash_info_read(block_segment);
+        if (block_valid(current) && memcmp(current->values, values, sizeof(values)) == 0) {
+            // Unchanged, save an erase
+            return true;
+        }
+        segment = (block_segment + 1) % FLASH_INFO_SEGMENT_COUNT;
+    }
+    struct params_block block = {
+        .magic = PARAMS_MAGIC,
+        .version = PARAMS_VERSION,
+        .count = PARAM_COUNT,
+        .sequence = block_sequence + 1,
+    };
+    memcpy(block.values, values, sizeof(values));
+    block.crc = crc16((const uint8_t *)&block, offsetof(struct params_block, crc));
+
+    flash_info_erase(segment);
+    flash_info_write(segment, &block, sizeof(block));
+    if (!block_valid(flash_info_read(segment))) {
+        return false;
+    }
+    block_segment = segment;
+    block_sequence = block.sequence;
+    return true;
+}
+
+uint16_t params_get(param_e param)
+{
+    ASSERT(initialized);
+    return values[param];
+}
+
+bool params_set(param_e param, uint16_t value)
+{
+    ASSERT(param < PARAM_COUNT);
+    if (!value_in_range(param, value)) {
+        return false;
+    }
+    const uint16_t prev_value = values[param];
+    values[param] = value;
+    if (!ranges_ordered(values)) {
+        values[param] = prev_value;
+        return false;
+    }
+    return true;
+}
+
+void params_reset(void)
+{
+    for (uint8_t param = 0; param < PARAM_COUNT; param++) {
+        values[param] = param_cfgs[param].default_value;
+    }
+}
+
+const char *params_name(param_e param)
+{
+    ASSERT(param < PARAM_COUNT);
+    return param_cfgs[param].name;
+}
+
+param_e params_find(const char *name)
+{
+    for (uint8_t param = 0; param < PARAM_COUNT; param++) {
+        if (strcmp(param_cfgs[param].name, name) == 0) {
+            return param;
+        }
+    }
+    return PARAM_COUNT;
+}
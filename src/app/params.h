@@ -0,0 +1,52 @@
+#ifndef PARAMS_H
+#define PARAMS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Tunable parameters (thresholds, speeds and durations), which can be changed at runtime
+ * (e.g. from the console) without rebuilding. They are loaded at boot from a parameter block
+ * in the information flash (see params.c), so one binary can be tuned per robot and dohyo,
+ * and fall back to the compiled defaults if there is no valid block. */
+
+typedef enum
+{
+    PARAM_ENEMY_RANGE, // mm, closer is detected
+    PARAM_ENEMY_RANGE_CLOSE, // mm, closer is ENEMY_RANGE_CLOSE
+    PARAM_ENEMY_RANGE_MID, // mm, closer is ENEMY_RANGE_MID (further is ENEMY_RANGE_FAR)
+    // Per sensor ADC10 value (0-1023), lower is line (calibrated in wait, see line.h)
+    PARAM_LINE_FRONT_LEFT,
+    PARAM_LINE_FRONT_RIGHT,
+    PARAM_LINE_BACK_LEFT,
+    PARAM_LINE_BACK_RIGHT,
+    PARAM_LINE_HYSTERESIS, // Added to the threshold while the line is detected
+    PARAM_LINE_CALIBRATE, // 1 to calibrate the line thresholds in wait
+    PARAM_LINE_EMERGENCY, // 1 to drive away from the line from the ADC interrupt
+    PARAM_DRIVE_SPEED, // Percent of the speeds in drive.c
+    PARAM_SEARCH_ROTATE_MS,
+    PARAM_SEARCH_FORWARD_MS,
+    PARAM_ATTACK_TIMEOUT_MS,
+    PARAM_RETREAT_REVERSE_MS,
+    PARAM_RETREAT_FORWARD_MS,
+    PARAM_RETREAT_ROTATE_MS,
+    PARAM_RETREAT_ARCTURN_MS,
+    PARAM_RETREAT_ALIGN_TURN_MS,
+    PARAM_RETREAT_ALIGN_ARC_MS,
+    PARAM_COUNT
+} param_e;
+
+void params_init(void);
+uint16_t params_get(param_e param);
+/* Returns false if the value is outside the allowed range of the parameter, or would put the
+ * enemy ranges out of order (close < mid < range) */
+bool params_set(param_e param, uint16_t value);
+// Restores the compiled defaults (in RAM, the flash is kept until the next save)
+void params_reset(void);
+// Writes the parameters to the flash, returns false if the write failed
+bool params_save(void);
+// Short name (used by the console)
+const char *params_name(param_e param);
+// Returns PARAM_COUNT if there is no such parameter
+param_e params_find(const char *name);
+
+#endif // PARAMS_H
@@ -1,10 +1,10 @@
 #include "app/state_attack.h"
 #include "app/drive.h"
 #include "app/timer.h"
+#include "app/params.h"
+#include "app/enemy.h"
 #include "common/assert_handler.h"
 
-#define ATTACK_STATE_TIMEOUT (5000u)
-
 static void state_attack_run(const struct state_attack_data *data)
 {
     switch (data->state) {
@@ -18,7 +18,7 @@ static void state_attack_run(const struct state_attack_data *data)
         drive_set(DRIVE_DIR_ARCTURN_WIDE_RIGHT, DRIVE_SPEED_FAST);
         break;
     }
-    timer_start(data->common->timer, ATTACK_STATE_TIMEOUT);
+    timer_start(data->common->timer, params_get(PARAM_ATTACK_TIMEOUT_MS));
 }
 
 static attack_state_e next_attack_state(const struct enemy *enemy)
@@ -38,13 +38,13 @@ static attack_state_e next_attack_state(const struct enemy *enemy)
 // No blocking code (e.g. busy wait) allowed in this function
 void state_attack_enter(struct state_attack_data *data, state_e from, state_event_e event)
 {
-    const attack_state_e prev_attack_state = data->state;
-    data->state = next_attack_state(&data->common->enemy);
-
+    // The enemy is close, so update its position as often as possible
+    enemy_set_sensing(ENEMY_SENSING_HIGH_SPEED);
     switch (from) {
     case STATE_SEARCH:
         switch (event) {
         case STATE_EVENT_ENEMY:
+            data->state = next_attack_state(&data->common->enemy);
             state_attack_run(data);
             break;
         case STATE_EVENT_TIMEOUT:
@@ -59,19 +59,26 @@ void state_attack_enter(struct state_attack_data *data, state_e from, state_even
     case STATE_ATTACK:
         switch (event) {
         case STATE_EVENT_ENEMY:
+        {
+            const attack_state_e prev_attack_state = data->state;
+            data->state = next_attack_state(&data->common->enemy);
             if (prev_attack_state != data->state) {
                 state_attack_run(data);
             }
-            break;
+        } break;
         case STATE_EVENT_TIMEOUT:
-            // TODO: Consider adding a breakout strategy instead of asserting
-            ASSERT(0);
+            /* The enemy has stayed on the same side for the whole timeout (e.g. pushing head
+             * on), keep going and restart the timer. The timeout is checked before the enemy,
+             * so it may come after the enemy is lost, which then leaves on the next event. */
+            state_attack_run(data);
             break;
-        case STATE_EVENT_LINE:
         case STATE_EVENT_FINISHED:
+            // Attack posts no internal event, keep attacking
+            break;
+        case STATE_EVENT_LINE:
         case STATE_EVENT_COMMAND:
         case STATE_EVENT_NONE:
-            ASSERT(0);
+            // These leave the attack state (see state_transitions.h), nothing to do here
             break;
         }
         break;
@@ -27,7 +27,7 @@ typedef enum {
 
 struct state_machine_data;
 typedef uint32_t timer_t;
-struct ring_buffer;
+struct input_history_buffer;
 struct state_common_data
 {
     struct state_machine_data *state_machine_data;
@@ -35,7 +35,7 @@ struct state_common_data
     struct enemy enemy;
     line_e line;
     ir_cmd_e cmd;
-    struct ring_buffer *input_history;
+    struct input_history_buffer *input_history;
 };
 
 // Post event from inside a state
@@ -5,66 +5,60 @@
 #include "app/state_attack.h"
 #include "app/state_retreat.h"
 #include "app/state_manual.h"
+#include "app/state_transitions.h"
 #include "app/timer.h"
 #include "app/input_history.h"
+#include "app/input_record.h"
+#include "app/console.h"
+#include "app/line.h"
+#include "app/params.h"
 #include "common/trace.h"
 #include "common/defines.h"
 #include "common/assert_handler.h"
 #include "common/enum_to_string.h"
-#include "common/ring_buffer.h"
-#include "common/sleep.h"
+#include "common/cycle_stats.h"
+#include "drivers/millis.h"
+#include "drivers/cycles.h"
+#include "drivers/wakeup.h"
+#include "drivers/watchdog.h"
+#include <assert.h>
 
 /* A state machine implemented as a set of enums and functions. The states are linked through
  * transitions, which are triggered by events.
  *
  * Flow:
- *    1. Process input
+ *    1. Sleep until woken up (see drivers/wakeup.h), at least every millisecond
+ *    2. Process input
  *        - Check input (e.g. sensors, timer, internal event...)
  *        - Return event
- *    2. Process event
+ *    3. Process event
  *        - State/Change state
  *        - Run state function
- *    3. Repeat
+ *    4. Repeat
  *
- * The flow is continuous (never blocks), which avoids the need for event synchronization
- * mechanisms, since the input can be processed repeatedly at the beginning of each iteration
- * instead. No input is still treated as an event (STATE_EVENT_NONE), but treated as a NOOP
- * when processed. Of course, this means that the code inside the state machine can't block.
+ * Apart from the sleep, the flow is continuous (never blocks), which avoids the need for event
+ * synchronization mechanisms, since the input can be processed repeatedly at the beginning of
+ * each iteration instead. The wakeup events only tell which input is worth reading. No input
+ * is still treated as an event (STATE_EVENT_NONE), but treated as a NOOP when processed. Of
+ * course, this means that the code inside the state machine can't block.
  */
 
-struct state_transition
-{
-    state_e from;
-    state_event_e event;
-    state_e to;
+#define STATE_COUNT (STATE_MANUAL + 1)
+#define STATE_EVENT_COUNT (STATE_EVENT_NONE + 1)
+
+/* One enumerator per transition, so a duplicate (from, event) pair fails to compile, and
+ * together with the count below, so does a missing one. */
+#define STATE_TRANSITION_ENUM(from, event, to) STATE_TRANSITION_##from##_##event,
+enum {
+    STATE_TRANSITIONS(STATE_TRANSITION_ENUM) STATE_TRANSITION_COUNT
 };
+static_assert(STATE_TRANSITION_COUNT == STATE_COUNT * STATE_EVENT_COUNT,
+              "Every event must have a transition in every state (see docs/state_machine.uml)");
 
-// See docs/state_machine.png (docs/state_machine.uml)
-static const struct state_transition state_transitions[] = {
-    { STATE_WAIT, STATE_EVENT_NONE, STATE_WAIT },
-    { STATE_WAIT, STATE_EVENT_LINE, STATE_WAIT },
-    { STATE_WAIT, STATE_EVENT_ENEMY, STATE_WAIT },
-    { STATE_WAIT, STATE_EVENT_COMMAND, STATE_SEARCH },
-    { STATE_SEARCH, STATE_EVENT_NONE, STATE_SEARCH },
-    { STATE_SEARCH, STATE_EVENT_TIMEOUT, STATE_SEARCH },
-    { STATE_SEARCH, STATE_EVENT_ENEMY, STATE_ATTACK },
-    { STATE_SEARCH, STATE_EVENT_LINE, STATE_RETREAT },
-    { STATE_SEARCH, STATE_EVENT_COMMAND, STATE_MANUAL },
-    { STATE_ATTACK, STATE_EVENT_ENEMY, STATE_ATTACK },
-    { STATE_ATTACK, STATE_EVENT_LINE, STATE_RETREAT },
-    { STATE_ATTACK, STATE_EVENT_NONE, STATE_SEARCH }, // Enemy lost
-    { STATE_ATTACK, STATE_EVENT_COMMAND, STATE_MANUAL },
-    { STATE_ATTACK, STATE_EVENT_TIMEOUT, STATE_ATTACK },
-    { STATE_RETREAT, STATE_EVENT_LINE, STATE_RETREAT },
-    { STATE_RETREAT, STATE_EVENT_FINISHED, STATE_SEARCH },
-    { STATE_RETREAT, STATE_EVENT_TIMEOUT, STATE_RETREAT },
-    { STATE_RETREAT, STATE_EVENT_ENEMY, STATE_RETREAT },
-    { STATE_RETREAT, STATE_EVENT_NONE, STATE_RETREAT },
-    { STATE_RETREAT, STATE_EVENT_COMMAND, STATE_MANUAL },
-    { STATE_MANUAL, STATE_EVENT_COMMAND, STATE_MANUAL },
-    { STATE_MANUAL, STATE_EVENT_NONE, STATE_MANUAL },
-    { STATE_MANUAL, STATE_EVENT_LINE, STATE_MANUAL },
-    { STATE_MANUAL, STATE_EVENT_ENEMY, STATE_MANUAL },
+// See docs/state_machine.png (docs/state_machine.uml), indexed by [from][event]
+#define STATE_TRANSITION_ENTRY(from, event, to) [STATE_##from][STATE_EVENT_##event] = STATE_##to,
+static const state_e state_transitions[STATE_COUNT][STATE_EVENT_COUNT] = {
+    STATE_TRANSITIONS(STATE_TRANSITION_ENTRY)
 };
 
 struct state_machine_data
@@ -78,7 +72,9 @@ struct state_machine_data
     struct state_manual_data manual;
     state_event_e internal_event;
     timer_t timer;
-    struct ring_buffer input_history;
+    struct input_history_buffer input_history;
+    struct cycle_stats loop_cycles; // Time to process input and event (excluding sleep)
+    struct cycle_stats wait_cycles; // Time asleep (including interrupts that don't wake up)
 };
 
 static inline bool has_internal_event(const struct state_machine_data *data)
@@ -106,8 +102,10 @@ static void state_enter(struct state_machine_data *data, state_e from, state_eve
     if (from != to) {
         timer_clear(&data->timer);
         data->state = to;
-        TRACE("%s to %s (%s)", state_to_string(from), state_to_string(event),
-              state_event_to_string(to));
+        // Driving away from the line on its own only makes sense during the match
+        line_arm_emergency(to != STATE_WAIT && to != STATE_MANUAL);
+        TRACE("%s to %s (%s)", state_to_string(from), state_to_string(to),
+              state_event_to_string(event));
     }
     switch (to) {
     case STATE_WAIT:
@@ -130,20 +128,129 @@ static void state_enter(struct state_machine_data *data, state_e from, state_eve
 
 static inline void process_event(struct state_machine_data *data, state_event_e next_event)
 {
-    for (uint16_t i = 0; i < ARRAY_SIZE(state_transitions); i++) {
-        if (data->state == state_transitions[i].from && next_event == state_transitions[i].event) {
-            state_enter(data, state_transitions[i].from, next_event, state_transitions[i].to);
-            return;
+    state_enter(data, data->state, next_event, state_transitions[data->state][next_event]);
+}
+
+// Console commands are passed on as commands, so they are recorded like the remote control
+static inline void read_input(struct input_record *input, ir_cmd_e console_cmd, uint8_t events,
+                              const struct enemy *enemy_prev)
+{
+#if defined(INPUT_REPLAY)
+    UNUSED(console_cmd);
+    UNUSED(events);
+    UNUSED(enemy_prev);
+    input_replay_next(input);
+#else
+    input->time_ms = millis();
+    // Reading the range sensors (I2C) is slow, so don't delay the reaction to e.g. a line
+    if (events & (WAKEUP_TICK | WAKEUP_RANGE)) {
+        input->enemy = enemy_get();
+        input->fresh = enemy_fresh();
+    } else {
+        input->enemy = *enemy_prev;
+        input->fresh = false;
+    }
+    input->line = line_get();
+    input->cmd = ir_remote_get_cmd();
+    if (input->cmd == IR_CMD_NONE) {
+        input->cmd = console_cmd;
+    }
+#endif
+#if defined(INPUT_RECORD)
+    input_record_save(input);
+#endif
+}
+
+static void trace_loop_stats(const struct state_machine_data *data)
+{
+#ifndef DISABLE_TRACE
+    cycle_stats_trace(&data->loop_cycles, "loop");
+    cycle_stats_trace(&data->wait_cycles, "wait");
+    // Also the headroom left for more processing
+    const uint64_t total = data->loop_cycles.total + data->wait_cycles.total;
+    const uint32_t active_percent = total ? (uint32_t)(data->loop_cycles.total * 100 / total) : 0;
+    TRACE("cpu active %lu%%", (unsigned long)active_percent);
+#else
+    UNUSED(data);
+#endif
+}
+
+static void reset_loop_stats(struct state_machine_data *data)
+{
+    cycle_stats_reset(&data->loop_cycles);
+    cycle_stats_reset(&data->wait_cycles);
+}
+
+/* Handles every request received so far, except after a start or stop, which is passed on
+ * as a command first. The rest is then handled on the next iteration (woken up again). */
+static ir_cmd_e process_console(struct state_machine_data *data, uint8_t events)
+{
+    if (!(events & WAKEUP_UART)) {
+        return IR_CMD_NONE;
+    }
+    console_request_e request;
+    while ((request = console_process()) != CONSOLE_REQUEST_NONE) {
+        switch (request) {
+        case CONSOLE_REQUEST_NONE:
+            break;
+        case CONSOLE_REQUEST_START:
+            // Same as the remote control, which starts from wait and stops otherwise
+            if (data->state == STATE_WAIT) {
+                wakeup_post(WAKEUP_UART);
+                return IR_CMD_OK;
+            }
+            break;
+        case CONSOLE_REQUEST_STOP:
+            if (data->state != STATE_WAIT) {
+                wakeup_post(WAKEUP_UART);
+                return IR_CMD_OK;
+            }
+            break;
+        case CONSOLE_REQUEST_STATS:
+            trace_loop_stats(data);
+            break;
+        case CONSOLE_REQUEST_RESET:
+            reset_loop_stats(data);
+            break;
+        case CONSOLE_REQUEST_DEFAULTS:
+            // Not in the middle of a match
+            if (data->state != STATE_WAIT) {
+                TRACE("Stop first");
+                break;
+            }
+            params_reset();
+            break;
+        case CONSOLE_REQUEST_SAVE:
+            // Erasing the flash keeps the interrupts off for ~12 ms
+            if (data->state != STATE_WAIT) {
+                TRACE("Stop first");
+                break;
+            }
+            if (!params_save()) {
+                TRACE("Save failed");
+            }
+            break;
         }
     }
-    ASSERT(0);
+    return IR_CMD_NONE;
 }
 
-static inline state_event_e process_input(struct state_machine_data *data)
+static inline state_event_e process_input(struct state_machine_data *data, uint8_t events)
 {
-    data->common.enemy = enemy_get();
-    data->common.line = line_get();
-    data->common.cmd = ir_remote_get_cmd();
+    struct input_record input_record;
+    read_input(&input_record, process_console(data, events), events, &data->common.enemy);
+    timer_update(input_record.time_ms);
+    data->common.enemy = input_record.enemy;
+    data->common.line = input_record.line;
+    data->common.cmd = input_record.cmd;
+#ifndef DISABLE_TRACE
+    /* Dump the loop timing and start over. The command is still passed on to the states, so
+     * the remote behaves the same with and without traces (e.g. # stops in manual mode). */
+    if (data->common.cmd == IR_CMD_HASH) {
+        trace_loop_stats(data);
+        reset_loop_stats(data);
+    }
+#endif
     const struct input input = { .enemy = data->common.enemy, .line = data->common.line };
     input_history_save(&data->input_history, &input);
 
@@ -171,33 +278,50 @@ static inline void state_machine_init(struct state_machine_data *data)
     data->common.line = LINE_NONE;
     data->common.cmd = IR_CMD_NONE;
     data->common.timer = &data->timer;
+    data->common.input_history = &data->input_history;
     timer_clear(&data->timer);
+    input_history_buffer_clear(&data->input_history);
     data->internal_event = STATE_EVENT_NONE;
     data->wait.common = &data->common;
     data->search.common = &data->common;
     data->attack.common = &data->common;
     data->retreat.common = &data->common;
     data->manual.common = &data->common;
+    reset_loop_stats(data);
     state_search_init(&data->search);
     state_attack_init(&data->attack);
     state_retreat_init(&data->retreat);
 }
 
-#define INPUT_HISTORY_BUFFER_SIZE (6u)
+#if defined(BENCH)
+void state_machine_bench_process_event(state_e state, state_event_e event,
+                                       const struct enemy *enemy)
+{
+    static struct state_machine_data data;
+    static bool initialized = false;
+    if (!initialized) {
+        state_machine_init(&data);
+        initialized = true;
+    }
+    data.state = state;
+    data.common.enemy = *enemy;
+    process_event(&data, event);
+}
+#endif
+
 void state_machine_run(void)
 {
     struct state_machine_data data;
-
-    // Allocate input history here so the internal buffer remains allocated
-    LOCAL_RING_BUFFER(input_history, INPUT_HISTORY_BUFFER_SIZE, struct input);
-    data.input_history = input_history;
-    data.common.input_history = &data.input_history;
-
     state_machine_init(&data);
 
     while (1) {
-        const state_event_e next_event = process_input(&data);
+        const uint32_t wait_start_cycles = cycles_get();
+        const uint8_t events = wakeup_wait();
+        watchdog_kick();
+        const uint32_t start_cycles = cycles_get();
+        cycle_stats_add(&data.wait_cycles, start_cycles - wait_start_cycles);
+        const state_event_e next_event = process_input(&data, events);
         process_event(&data, next_event);
-        sleep_ms(1);
+        cycle_stats_add(&data.loop_cycles, cycles_get() - start_cycles);
     }
 }
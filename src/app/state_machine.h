@@ -5,4 +5,11 @@
 
 void state_machine_run(void);
 
+#if defined(BENCH)
+#include "app/state_common.h"
+// Processes an event in the given state, so src/test/bench.c can measure it in isolation
+void state_machine_bench_process_event(state_e state, state_event_e event,
+                                       const struct enemy *enemy);
+#endif
+
 #endif // STATE_MACHINE_H
@@ -1,6 +1,7 @@
 #include "app/state_retreat.h"
 #include "app/drive.h"
 #include "app/timer.h"
+#include "app/params.h"
 #include "common/assert_handler.h"
 #include "common/enum_to_string.h"
 #include <stdbool.h>
@@ -11,7 +12,7 @@ struct move
 {
     drive_dir_e dir;
     drive_speed_e speed;
-    uint16_t duration;
+    param_e duration; // ms
 };
 
 struct retreat_state
@@ -25,49 +26,49 @@ static const struct retreat_state retreat_states[] =
     [RETREAT_STATE_REVERSE] =
     {
         .move_cnt = 1,
-        .moves = { { DRIVE_DIR_REVERSE, DRIVE_SPEED_MAX, 300 } },
+        .moves = { { DRIVE_DIR_REVERSE, DRIVE_SPEED_MAX, PARAM_RETREAT_REVERSE_MS } },
     },
     [RETREAT_STATE_FORWARD] =
     {
         .move_cnt = 1,
-        .moves = { { DRIVE_DIR_FORWARD, DRIVE_SPEED_FAST, 300 } },
+        .moves = { { DRIVE_DIR_FORWARD, DRIVE_SPEED_FAST, PARAM_RETREAT_FORWARD_MS } },
     },
     [RETREAT_STATE_ROTATE_LEFT] =
     {
         .move_cnt = 1,
-        .moves = { { DRIVE_DIR_ROTATE_LEFT, DRIVE_SPEED_FAST, 150 } },
+        .moves = { { DRIVE_DIR_ROTATE_LEFT, DRIVE_SPEED_FAST, PARAM_RETREAT_ROTATE_MS } },
     },
     [RETREAT_STATE_ROTATE_RIGHT] =
     {
         .move_cnt = 1,
-        .moves = { { DRIVE_DIR_ROTATE_RIGHT, DRIVE_SPEED_FAST, 150 } },
+        .moves = { { DRIVE_DIR_ROTATE_RIGHT, DRIVE_SPEED_FAST, PARAM_RETREAT_ROTATE_MS } },
     },
     [RETREAT_STATE_ARCTURN_LEFT] =
     {
         .move_cnt = 1,
-        .moves = { { DRIVE_DIR_ARCTURN_SHARP_LEFT, DRIVE_SPEED_MAX, 150 } },
+        .moves = { { DRIVE_DIR_ARCTURN_SHARP_LEFT, DRIVE_SPEED_MAX, PARAM_RETREAT_ARCTURN_MS } },
     },
     [RETREAT_STATE_ARCTURN_RIGHT] =
     {
         .move_cnt = 1,
-        .moves = { { DRIVE_DIR_ARCTURN_SHARP_RIGHT, DRIVE_SPEED_MAX, 150 } },
+        .moves = { { DRIVE_DIR_ARCTURN_SHARP_RIGHT, DRIVE_SPEED_MAX, PARAM_RETREAT_ARCTURN_MS } },
     },
     [RETREAT_STATE_ALIGN_LEFT] =
     {
         .move_cnt = 3,
         .moves = {
-            { DRIVE_DIR_REVERSE, DRIVE_SPEED_MAX, 300 },
-            { DRIVE_DIR_ARCTURN_SHARP_LEFT, DRIVE_SPEED_MAX, 250 },
-            { DRIVE_DIR_ARCTURN_MID_RIGHT, DRIVE_SPEED_MAX, 300 },
+            { DRIVE_DIR_REVERSE, DRIVE_SPEED_MAX, PARAM_RETREAT_REVERSE_MS },
+            { DRIVE_DIR_ARCTURN_SHARP_LEFT, DRIVE_SPEED_MAX, PARAM_RETREAT_ALIGN_TURN_MS },
+            { DRIVE_DIR_ARCTURN_MID_RIGHT, DRIVE_SPEED_MAX, PARAM_RETREAT_ALIGN_ARC_MS },
         },
     },
     [RETREAT_STATE_ALIGN_RIGHT] =
     {
         .move_cnt = 3,
         .moves = {
-            { DRIVE_DIR_REVERSE, DRIVE_SPEED_MAX, 300 },
-            { DRIVE_DIR_ARCTURN_SHARP_RIGHT, DRIVE_SPEED_MAX, 250 },
-            { DRIVE_DIR_ARCTURN_MID_LEFT, DRIVE_SPEED_MAX, 300 },
+            { DRIVE_DIR_REVERSE, DRIVE_SPEED_MAX, PARAM_RETREAT_REVERSE_MS },
+            { DRIVE_DIR_ARCTURN_SHARP_RIGHT, DRIVE_SPEED_MAX, PARAM_RETREAT_ALIGN_TURN_MS },
+            { DRIVE_DIR_ARCTURN_MID_LEFT, DRIVE_SPEED_MAX, PARAM_RETREAT_ALIGN_ARC_MS },
         },
     },
 };
@@ -156,7 +157,7 @@ static void start_retreat_move(const struct state_retreat_data *data)
 {
     ASSERT(data->move_idx < retreat_states[data->state].move_cnt);
     const struct move move = retreat_states[data->state].moves[data->move_idx];
-    timer_start(data->common->timer, move.duration);
+    timer_start(data->common->timer, params_get(move.duration));
     drive_set(move.dir, move.speed);
 }
 
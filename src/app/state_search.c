@@ -2,11 +2,10 @@
 #include "app/drive.h"
 #include "app/timer.h"
 #include "app/input_history.h"
+#include "app/params.h"
+#include "app/enemy.h"
 #include "common/assert_handler.h"
 
-#define SEARCH_STATE_ROTATE_TIMEOUT (400u)
-#define SEARCH_STATE_FORWARD_TIMEOUT (3000u)
-
 static void state_search_run(struct state_search_data *data)
 {
     switch (data->state) {
@@ -20,11 +19,11 @@ static void state_search_run(struct state_search_data *data)
         } else {
             drive_set(DRIVE_DIR_ROTATE_LEFT, DRIVE_SPEED_FAST);
         }
-        timer_start(data->common->timer, SEARCH_STATE_ROTATE_TIMEOUT);
+        timer_start(data->common->timer, params_get(PARAM_SEARCH_ROTATE_MS));
     } break;
     case SEARCH_STATE_FORWARD:
         drive_set(DRIVE_DIR_FORWARD, DRIVE_SPEED_FAST);
-        timer_start(data->common->timer, SEARCH_STATE_FORWARD_TIMEOUT);
+        timer_start(data->common->timer, params_get(PARAM_SEARCH_FORWARD_MS));
         break;
     }
 }
@@ -32,6 +31,8 @@ static void state_search_run(struct state_search_data *data)
 // No blocking code (e.g. busy wait) allowed in this function
 void state_search_enter(struct state_search_data *data, state_e from, state_event_e event)
 {
+    // See as far as possible while the enemy is not in sight
+    enemy_set_sensing(ENEMY_SENSING_LONG_RANGE);
     switch (from) {
     case STATE_WAIT:
         ASSERT(event == STATE_EVENT_COMMAND);
@@ -77,10 +78,12 @@ void state_search_enter(struct state_search_data *data, state_e from, state_even
             state_search_run(data);
             break;
         case STATE_EVENT_FINISHED:
+            // Search posts no internal event, keep searching
+            break;
         case STATE_EVENT_LINE:
         case STATE_EVENT_ENEMY:
         case STATE_EVENT_COMMAND:
-            ASSERT(0);
+            // These leave the search state (see state_transitions.h), nothing to do here
             break;
         }
         break;
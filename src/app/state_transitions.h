@@ -0,0 +1,42 @@
+#ifndef STATE_TRANSITIONS_H
+#define STATE_TRANSITIONS_H
+
+/* Generated from docs/state_machine.uml by tools/gen_state_transitions.py, don't
+ * edit by hand, run "make transitions" instead.
+ *
+ * X(from, event, to), where from/to are state_e and event is state_event_e without
+ * prefix. */
+
+#define STATE_TRANSITIONS(X)                                                                       \
+    X(WAIT, COMMAND, SEARCH)                                                                       \
+    X(SEARCH, ENEMY, ATTACK)                                                                       \
+    X(SEARCH, LINE, RETREAT)                                                                       \
+    X(SEARCH, TIMEOUT, SEARCH)                                                                     \
+    X(SEARCH, COMMAND, MANUAL)                                                                     \
+    X(ATTACK, ENEMY, ATTACK)                                                                       \
+    X(ATTACK, LINE, RETREAT)                                                                       \
+    X(ATTACK, NONE, SEARCH)                                                                        \
+    X(ATTACK, COMMAND, MANUAL)                                                                     \
+    X(RETREAT, FINISHED, SEARCH)                                                                   \
+    X(RETREAT, TIMEOUT, RETREAT)                                                                   \
+    X(RETREAT, COMMAND, MANUAL)                                                                    \
+    X(MANUAL, COMMAND, MANUAL)                                                                     \
+    X(WAIT, TIMEOUT, WAIT)                                                                         \
+    X(WAIT, LINE, WAIT)                                                                            \
+    X(WAIT, ENEMY, WAIT)                                                                           \
+    X(WAIT, FINISHED, WAIT)                                                                        \
+    X(WAIT, NONE, WAIT)                                                                            \
+    X(SEARCH, FINISHED, SEARCH)                                                                    \
+    X(SEARCH, NONE, SEARCH)                                                                        \
+    X(ATTACK, TIMEOUT, ATTACK)                                                                     \
+    X(ATTACK, FINISHED, ATTACK)                                                                    \
+    X(RETREAT, LINE, RETREAT)                                                                      \
+    X(RETREAT, ENEMY, RETREAT)                                                                     \
+    X(RETREAT, NONE, RETREAT)                                                                      \
+    X(MANUAL, TIMEOUT, MANUAL)                                                                     \
+    X(MANUAL, LINE, MANUAL)                                                                        \
+    X(MANUAL, ENEMY, MANUAL)                                                                       \
+    X(MANUAL, FINISHED, MANUAL)                                                                    \
+    X(MANUAL, NONE, MANUAL)
+
+#endif // STATE_TRANSITIONS_H
@@ -1,4 +1,6 @@
 #include "app/state_wait.h"
+#include "app/line.h"
+#include "app/params.h"
 #include "common/assert_handler.h"
 #include "common/defines.h"
 
@@ -8,6 +10,13 @@ void state_wait_enter(struct state_wait_data *data, state_e from, state_event_e
     UNUSED(data);
     UNUSED(event);
     ASSERT(from == STATE_WAIT);
+    // Standing still on the dohyo, so the line sensors see its black level (see line.h)
+    if (params_get(PARAM_LINE_CALIBRATE)) {
+        line_calibrate();
+    } else {
+        // Starts over when it's turned on again (console), e.g. after moving the robot
+        line_calibrate_restart();
+    }
     // Command triggers transition
     // Note in actual sumobot competition this signal would come from another IR transceiver
     // than the one used here.
@@ -1,12 +1,18 @@
 #include "app/timer.h"
-#include "drivers/millis.h"
 #include "common/defines.h"
 
 #define TIMER_CLEARED (0u)
 
+static uint32_t now_ms = 0;
+
+void timer_update(uint32_t time_ms)
+{
+    now_ms = time_ms;
+}
+
 void timer_start(timer_t *timer, uint32_t timeout_ms)
 {
-    *timer = millis() + timeout_ms;
+    *timer = now_ms + timeout_ms;
 }
 
 bool timer_timeout(const timer_t *timer)
@@ -14,7 +20,7 @@ bool timer_timeout(const timer_t *timer)
     if (*timer == TIMER_CLEARED) {
         return false;
     }
-    return millis() > *timer;
+    return now_ms > *timer;
 }
 
 void timer_clear(timer_t *timer)
@@ -9,6 +9,10 @@
 // UINT32_MAX milliseconds ~= 25 days is max timeout
 typedef uint32_t timer_t;
 
+/* The timers use the time passed here (millis) instead of reading the time themselves. The
+ * state machine updates it once at the start of every iteration, so that an iteration only
+ * depends on its input, which makes it possible to replay a recording exactly. */
+void timer_update(uint32_t time_ms);
 void timer_start(timer_t *timer, uint32_t timeout_ms);
 bool timer_timeout(const timer_t *timer);
 void timer_clear(timer_t *timer);
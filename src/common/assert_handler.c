@@ -64,6 +64,8 @@ static void assert_stop_motors(void)
  * recursively until stack overflow. */
 void assert_handler(uint16_t program_counter)
 {
+    // Keep blinking instead of being reset by the watchdog
+    WDTCTL = WDTPW + WDTHOLD;
     assert_stop_motors();
     BREAKPOINT
     assert_trace(program_counter);
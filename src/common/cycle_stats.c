@@ -0,0 +1,66 @@
+#ifndef DISABLE_TRACE
+#include "common/cycle_stats.h"
+#include "common/trace.h"
+#include "common/defines.h"
+#include <stdbool.h>
+
+// Cycles per microsecond (SMCLK = MCLK)
+#define CYCLES_PER_us (CYCLES_16MHZ / 1000000u)
+
+static uint8_t bucket_index(uint32_t cycles)
+{
+    // No hardware multiplier/divider, so shift instead of computing log2 some other way
+    cycles >>= CYCLE_STATS_BUCKET_SHIFT;
+    uint8_t index = 0;
+    while (cycles && index < CYCLE_STATS_BUCKET_COUNT - 1) {
+        cycles >>= 1;
+        index++;
+    }
+    return index;
+}
+
+void cycle_stats_add(struct cycle_stats *stats, uint32_t cycles)
+{
+    if (stats->count == 0 || cycles < stats->min) {
+        stats->min = cycles;
+    }
+    if (cycles > stats->max) {
+        stats->max = cycles;
+    }
+    stats->total += cycles;
+    stats->count++;
+    const uint8_t index = bucket_index(cycles);
+    if (stats->buckets[index] < UINT16_MAX) {
+        stats->buckets[index]++;
+    }
+}
+
+void cycle_stats_reset(struct cycle_stats *stats)
+{
+    stats->min = 0;
+    stats->max = 0;
+    stats->total = 0;
+    stats->count = 0;
+    for (uint8_t i = 0; i < CYCLE_STATS_BUCKET_COUNT; i++) {
+        stats->buckets[i] = 0;
+    }
+}
+
+void cycle_stats_trace(const struct cycle_stats *stats, const char *name)
+{
+    const uint32_t mean = stats->count ? (uint32_t)(stats->total / stats->count) : 0;
+    TRACE("%s: n %lu min %lu max %lu mean %lu cycles (%lu/%lu/%lu us)", name,
+          (unsigned long)stats->count, (unsigned long)stats->min, (unsigned long)stats->max,
+          (unsigned long)mean, (unsigned long)(stats->min / CYCLES_PER_us),
+          (unsigned long)(stats->max / CYCLES_PER_us), (unsigned long)(mean / CYCLES_PER_us));
+    for (uint8_t i = 0; i < CYCLE_STATS_BUCKET_COUNT; i++) {
+        if (stats->buckets[i]) {
+            const bool last = i == CYCLE_STATS_BUCKET_COUNT - 1;
+            TRACE("%s: %s2^%u %u", name, last ? ">=" : "<",
+                  (unsigned)(CYCLE_STATS_BUCKET_SHIFT + i - (last ? 1 : 0)),
+                  stats->buckets[i]);
+        }
+    }
+}
+
+#endif // DISABLE_TRACE
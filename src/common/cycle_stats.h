@@ -0,0 +1,42 @@
+#ifndef CYCLE_STATS_H
+#define CYCLE_STATS_H
+
+/* Accumulates durations measured in CPU cycles (see drivers/cycles.h), e.g. how long each
+ * iteration of a loop takes. Keeps min/max/mean and a histogram with log2-sized buckets, so
+ * rare slow iterations show up without having to store every sample.
+ *
+ * Bucket 0: < 2^CYCLE_STATS_BUCKET_SHIFT cycles
+ * Bucket n: [2^(CYCLE_STATS_BUCKET_SHIFT + n - 1), 2^(CYCLE_STATS_BUCKET_SHIFT + n)) cycles
+ * Last bucket: Everything above
+ *
+ * The stats are only readable through trace, so they compile to nothing with DISABLE_TRACE
+ * to not waste RAM. */
+
+#include <stdint.h>
+
+#define CYCLE_STATS_BUCKET_COUNT (16u)
+// 2^10 cycles = 64 us at 16 MHz
+#define CYCLE_STATS_BUCKET_SHIFT (10u)
+
+struct cycle_stats
+{
+#ifndef DISABLE_TRACE
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+    uint32_t count;
+    uint16_t buckets[CYCLE_STATS_BUCKET_COUNT]; // Saturates at UINT16_MAX
+#endif
+};
+
+#ifndef DISABLE_TRACE
+void cycle_stats_add(struct cycle_stats *stats, uint32_t cycles);
+void cycle_stats_reset(struct cycle_stats *stats);
+void cycle_stats_trace(const struct cycle_stats *stats, const char *name);
+#else
+#define cycle_stats_add(stats, cycles) ((void)(stats), (void)(cycles))
+#define cycle_stats_reset(stats) ((void)(stats))
+#define cycle_stats_trace(stats, name) ((void)(stats), (void)(name))
+#endif
+
+#endif // CYCLE_STATS_H
@@ -1,44 +1,181 @@
 #ifndef RING_BUFFER_H
 #define RING_BUFFER_H
 
+#include "common/assert_handler.h"
 #include <stdint.h>
 #include <stdbool.h>
 #include <assert.h>
 
-// Circular buffer (FIFO) that can store elements of any size.
+/* Circular buffer (FIFO) of a fixed element type. DEFINE_RING_BUFFER(name, type, size)
+ * defines struct name and its functions (name_put, name_get...), which are static inline,
+ * so elements are copied by assignment. The size must be a power of two, so the index
+ * wraps around with a mask.
+ *
+ * head and tail are free-running 8-bit counters (head - tail is the count), so all slots
+ * are used. Only put writes head and only get writes tail, and 8-bit stores are atomic on
+ * the MSP430, so one producer and one consumer (e.g. an ISR and the main loop) can use the
+ * same buffer without disabling interrupts. put_overwrite also moves the tail, so it's only
+ * for buffers that are written and read from the same context.
+ *
+ * put_n/get_n move many elements with a single update of head or tail, and the span
+ * functions give direct access to the storage so the elements can be produced or consumed
+ * in place. Their cycle counts haven't been measured (see make bench). */
 
-struct ring_buffer
-{
-    uint8_t *buffer;
-    uint8_t buffer_size;
-    uint8_t elem_size;
-    uint8_t head_idx; // index of the next empty slot
-    uint8_t tail_idx; // index of the oldest element
-    bool full; // head == tail when full and empty, use this to distinguish
-};
+// Keeps the compiler from moving the element access past the store that publishes it
+#define RING_BUFFER_BARRIER() __asm__ volatile("" ::: "memory")
 
-#define RING_BUFFER(name, size, type, storage)                                                     \
-    static_assert(size < UINT8_MAX);                                                               \
-    storage uint8_t name##_buffer[size * sizeof(type)] = { 0 };                                    \
-    storage struct ring_buffer name = { .buffer = name##_buffer,                                   \
-                                        .buffer_size = size,                                       \
-                                        .elem_size = sizeof(type) }
-
-#define LOCAL_RING_BUFFER(name, size, type) RING_BUFFER(name, size, type, )
-#define STATIC_RING_BUFFER(name, size, type) RING_BUFFER(name, size, type, static)
-
-/* These functions include out-of-bounds checks, so it's not efficient
- * to call these many times consecutively */
-
-void ring_buffer_put(struct ring_buffer *rb, const void *data);
-void ring_buffer_get(struct ring_buffer *rb, void *data);
-// Look at the oldest element
-void ring_buffer_peek_tail(const struct ring_buffer *rb, void *data);
-// Look at the newest element (-offset)
-void ring_buffer_peek_head(const struct ring_buffer *rb, void *data, uint8_t offset);
-
-uint8_t ring_buffer_count(const struct ring_buffer *rb);
-bool ring_buffer_empty(const struct ring_buffer *rb);
-bool ring_buffer_full(const struct ring_buffer *rb);
+#define DEFINE_RING_BUFFER(name, type, size)                                                       \
+    static_assert((size) > 1 && (size) <= 128 && !((size) & ((size)-1)),                           \
+                  "Size must be a power of two (max 128)");                                        \
+    struct name                                                                                    \
+    {                                                                                              \
+        type buffer[size];                                                                         \
+        volatile uint8_t head; /* Written by put (producer) */                                     \
+        volatile uint8_t tail; /* Written by get (consumer) */                                     \
+    };                                                                                             \
+                                                                                                   \
+    static inline void name##_clear(struct name *rb)                                               \
+    {                                                                                              \
+        rb->head = 0;                                                                              \
+        rb->tail = 0;                                                                              \
+    }                                                                                              \
+                                                                                                   \
+    static inline uint8_t name##_count(const struct name *rb)                                      \
+    {                                                                                              \
+        return (uint8_t)(rb->head - rb->tail);                                                     \
+    }                                                                                              \
+                                                                                                   \
+    static inline bool name##_empty(const struct name *rb)                                         \
+    {                                                                                              \
+        return rb->head == rb->tail;                                                               \
+    }                                                                                              \
+                                                                                                   \
+    static inline bool name##_full(const struct name *rb)                                          \
+    {                                                                                              \
+        return name##_count(rb) == (size);                                                         \
+    }                                                                                              \
+                                                                                                   \
+    /* Returns false (and drops the element) if full */                                            \
+    static inline bool name##_put(struct name *rb, const type *data)                               \
+    {                                                                                              \
+        const uint8_t head = rb->head;                                                             \
+        if ((uint8_t)(head - rb->tail) == (size)) {                                                \
+            return false;                                                                          \
+        }                                                                                          \
+        rb->buffer[head & ((size)-1)] = *data;                                                     \
+        RING_BUFFER_BARRIER();                                                                     \
+        rb->head = head + 1;                                                                       \
+        return true;                                                                               \
+    }                                                                                              \
+                                                                                                   \
+    /* Removes the oldest element if full, not for buffers shared with an ISR */                   \
+    static inline void name##_put_overwrite(struct name *rb, const type *data)                     \
+    {                                                                                              \
+        if (name##_full(rb)) {                                                                     \
+            rb->tail++;                                                                            \
+        }                                                                                          \
+        name##_put(rb, data);                                                                      \
+    }                                                                                              \
+                                                                                                   \
+    /* Returns false if empty, data can be NULL to only remove the element */                      \
+    static inline bool name##_get(struct name *rb, type *data)                                     \
+    {                                                                                              \
+        const uint8_t tail = rb->tail;                                                             \
+        if (tail == rb->head) {                                                                    \
+            return false;                                                                          \
+        }                                                                                          \
+        RING_BUFFER_BARRIER();                                                                     \
+        if (data) {                                                                                \
+            *data = rb->buffer[tail & ((size)-1)];                                                 \
+        }                                                                                          \
+        RING_BUFFER_BARRIER();                                                                     \
+        rb->tail = tail + 1;                                                                       \
+        return true;                                                                               \
+    }                                                                                              \
+                                                                                                   \
+    /* Look at the oldest element */                                                               \
+    static inline const type *name##_peek_tail(const struct name *rb)                              \
+    {                                                                                              \
+        ASSERT(!name##_empty(rb));                                                                 \
+        return &rb->buffer[rb->tail & ((size)-1)];                                                 \
+    }                                                                                              \
+                                                                                                   \
+    /* Look at the newest element (-offset) */                                                     \
+    static inline const type *name##_peek_head(const struct name *rb, uint8_t offset)              \
+    {                                                                                              \
+        ASSERT(offset < name##_count(rb));                                                         \
+        return &rb->buffer[(uint8_t)(rb->head - 1 - offset) & ((size)-1)];                         \
+    }                                                                                              \
+                                                                                                   \
+    /* Puts as many of the count elements as fit, returns how many */                              \
+    static inline uint8_t name##_put_n(struct name *rb, const type *data, uint8_t count)           \
+    {                                                                                              \
+        const uint8_t head = rb->head;                                                             \
+        const uint8_t space = (size) - (uint8_t)(head - rb->tail);                                 \
+        if (count > space) {                                                                       \
+            count = space;                                                                         \
+        }                                                                                          \
+        for (uint8_t i = 0; i < count; i++) {                                                      \
+            rb->buffer[(uint8_t)(head + i) & ((size)-1)] = data[i];                                \
+        }                                                                                          \
+        RING_BUFFER_BARRIER();                                                                     \
+        rb->head = head + count;                                                                   \
+        return count;                                                                              \
+    }                                                                                              \
+                                                                                                   \
+    /* Gets up to count elements, returns how many */                                              \
+    static inline uint8_t name##_get_n(struct name *rb, type *data, uint8_t count)                 \
+    {                                                                                              \
+        const uint8_t tail = rb->tail;                                                             \
+        const uint8_t used = (uint8_t)(rb->head - tail);                                           \
+        if (count > used) {                                                                        \
+            count = used;                                                                          \
+        }                                                                                          \
+        RING_BUFFER_BARRIER();                                                                     \
+        for (uint8_t i = 0; i < count; i++) {                                                      \
+            data[i] = rb->buffer[(uint8_t)(tail + i) & ((size)-1)];                                \
+        }                                                                                          \
+        RING_BUFFER_BARRIER();                                                                     \
+        rb->tail = tail + count;                                                                   \
+        return count;                                                                              \
+    }                                                                                              \
+                                                                                                   \
+    /* Producer side span: points span at the free slots after the head that are contiguous        \
+     * in memory and returns how many there are. Fill them in place, then publish them with        \
+     * name_commit_put (a second span may be available after the wraparound). */                   \
+    static inline uint8_t name##_reserve_span(struct name *rb, type **span)                        \
+    {                                                                                              \
+        const uint8_t idx = rb->head & ((size)-1);                                                 \
+        const uint8_t space = (size) - name##_count(rb);                                           \
+        const uint8_t contiguous = (size) - idx;                                                   \
+        *span = &rb->buffer[idx];                                                                  \
+        return space < contiguous ? space : contiguous;                                            \
+    }                                                                                              \
+                                                                                                   \
+    static inline void name##_commit_put(struct name *rb, uint8_t count)                           \
+    {                                                                                              \
+        ASSERT(count <= (size) - name##_count(rb));                                                \
+        RING_BUFFER_BARRIER();                                                                     \
+        rb->head += count;                                                                         \
+    }                                                                                              \
+                                                                                                   \
+    /* Consumer side span: points span at the oldest elements that are contiguous in memory        \
+     * and returns how many there are. Remove them with name_commit_get once consumed. */          \
+    static inline uint8_t name##_peek_span(const struct name *rb, const type **span)               \
+    {                                                                                              \
+        const uint8_t idx = rb->tail & ((size)-1);                                                 \
+        const uint8_t used = name##_count(rb);                                                     \
+        const uint8_t contiguous = (size) - idx;                                                   \
+        RING_BUFFER_BARRIER();                                                                     \
+        *span = &rb->buffer[idx];                                                                  \
+        return used < contiguous ? used : contiguous;                                              \
+    }                                                                                              \
+                                                                                                   \
+    static inline void name##_commit_get(struct name *rb, uint8_t count)                           \
+    {                                                                                              \
+        ASSERT(count <= name##_count(rb));                                                         \
+        RING_BUFFER_BARRIER();                                                                     \
+        rb->tail += count;                                                                         \
+    }
 
 #endif // RING_BUFFER_H
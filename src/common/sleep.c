@@ -1,8 +0,0 @@
-#include "common/sleep.h"
-#include "common/defines.h"
-
-void sleep_ms(uint32_t ms)
-{
-    // Do nothing
-    UNUSED(ms);
-}
@@ -1,10 +0,0 @@
-#ifndef SLEEP_H
-#define SLEEP_H
-
-#include <stdint.h>
-
-// Empty implementation to avoid compilation errors (sleep only used on HOST simulation for now)
-
-void sleep_ms(uint32_t ms);
-
-#endif // SLEEP_H
@@ -2,7 +2,13 @@
 #include "common/trace.h"
 #include "common/assert_handler.h"
 #include "drivers/uart.h"
+#if defined(HOST)
+#include <stdio.h>
+#elif !defined(TRACE_TOKENIZED)
 #include "external/printf/printf.h"
+#endif
+#include <assert.h>
+#include <stdarg.h>
 #include <stdbool.h>
 
 static bool initialized = false;
@@ -13,6 +19,67 @@ void trace_init(void)
     initialized = true;
 }
 
+#if defined(TRACE_TOKENIZED)
+static_assert(TRACE_FRAME_SIZE <= TRACE_SIZE_TRUNCATED, "Size must fit next to the flag");
+
+// The size byte only holds the truncated flag until the frame is written
+#define TRACE_FRAME_SIZE_IDX (1u)
+
+uint8_t trace_begin(uint8_t *frame, uint16_t token)
+{
+    frame[0] = TRACE_SYNC;
+    frame[TRACE_FRAME_SIZE_IDX] = 0;
+    return trace_put_16(frame, TRACE_FRAME_SIZE_IDX + 1, token);
+}
+
+uint8_t trace_put_16(uint8_t *frame, uint8_t size, uint16_t value)
+{
+    if (size + sizeof(value) > TRACE_FRAME_SIZE) {
+        frame[TRACE_FRAME_SIZE_IDX] = TRACE_SIZE_TRUNCATED;
+        return size;
+    }
+    frame[size++] = value & 0xFF;
+    frame[size++] = value >> 8;
+    return size;
+}
+
+uint8_t trace_put_32(uint8_t *frame, uint8_t size, uint32_t value)
+{
+    if (size + sizeof(value) > TRACE_FRAME_SIZE) {
+        frame[TRACE_FRAME_SIZE_IDX] = TRACE_SIZE_TRUNCATED;
+        return size;
+    }
+    frame[size++] = value & 0xFF;
+    frame[size++] = (value >> 8) & 0xFF;
+    frame[size++] = (value >> 16) & 0xFF;
+    frame[size++] = value >> 24;
+    return size;
+}
+
+// Truncated to what fits in the frame
+uint8_t trace_put_str(uint8_t *frame, uint8_t size, const char *string)
+{
+    if (size >= TRACE_FRAME_SIZE) {
+        frame[TRACE_FRAME_SIZE_IDX] = TRACE_SIZE_TRUNCATED;
+        return size;
+    }
+    while (*string && size < TRACE_FRAME_SIZE - 1) {
+        frame[size++] = *string++;
+    }
+    if (*string) {
+        frame[TRACE_FRAME_SIZE_IDX] = TRACE_SIZE_TRUNCATED;
+    }
+    frame[size++] = '\0';
+    return size;
+}
+
+void trace_write(uint8_t *frame, uint8_t size)
+{
+    ASSERT(initialized);
+    frame[TRACE_FRAME_SIZE_IDX] |= size - (TRACE_FRAME_SIZE_IDX + 1);
+    uart_write(frame, size);
+}
+#else
 void trace(const char *format, ...)
 {
     ASSERT(initialized);
@@ -21,5 +88,6 @@ void trace(const char *format, ...)
     vprintf(format, args);
     va_end(args);
 }
+#endif
 
 #endif // DISABLE_TRACE
@@ -1,6 +1,76 @@
 #ifndef TRACE_H
 #define TRACE_H
 
+/* Prints debug traces over UART. By default the traces are formatted on target with printf,
+ * which costs thousands of cycles per call, so on target they are either compiled out
+ * (DISABLE_TRACE) or tokenized (TRACE_TOKENIZED).
+ *
+ * Tokenized, the format string is placed in a section that is kept in the ELF but not
+ * loaded to the target, and only a frame with the 16-bit address of the string (the token)
+ * and the raw arguments is sent. tools/trace_decode.py looks up the format strings in the
+ * ELF and prints the traces. Frame: [sync][size (of the rest)][token (LE)][arguments], where
+ * each argument is 2 bytes (int and smaller), 4 bytes (long) or a string (NUL-terminated).
+ *
+ * Arguments that don't fit in the frame are left out (strings are cut short), and the size
+ * has TRACE_SIZE_TRUNCATED set so the decoder can mark the trace. The sync byte lets the
+ * decoder find the next frame after bytes are lost or mixed in, e.g. dropped with
+ * UART_TX_POLICY_DROP_OLDEST or the plain text of an assert. */
+
+#if defined(TRACE_TOKENIZED) && !defined(DISABLE_TRACE)
+#include <stdint.h>
+
+// Fits the longest trace, the cycle stats (name and 7 longs)
+#define TRACE_FRAME_SIZE (48u)
+#define TRACE_SYNC (0xA5u)
+#define TRACE_SIZE_TRUNCATED (0x80u)
+
+/* GCC appends the flags of the section ("a", allocated) after the name, so end the name
+ * with the flags of a non-allocated section and comment out the rest (';' in msp430 as). */
+#define TRACE_FMT_SECTION ".trace_fmt,\"\",@progbits;"
+
+#define TRACE_STR_(x) #x
+#define TRACE_STR(x) TRACE_STR_(x)
+#define TRACE_CAT_(a, b) a##b
+#define TRACE_CAT(a, b) TRACE_CAT_(a, b)
+
+// Number of arguments (0 to 8)
+#define TRACE_NARGS(...) TRACE_NARGS_(_, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define TRACE_NARGS_(_, _1, _2, _3, _4, _5, _6, _7, _8, n, ...) n
+
+#define TRACE_ARG(frame, size, arg)                                                                \
+    size = _Generic((arg), long: trace_put_32, unsigned long: trace_put_32,                        \
+                    char *: trace_put_str, const char *: trace_put_str,                            \
+                    default: trace_put_16)(frame, size, arg)
+#define TRACE_ARGS_0(f, s)
+#define TRACE_ARGS_1(f, s, a) TRACE_ARG(f, s, a);
+#define TRACE_ARGS_2(f, s, a, ...) TRACE_ARG(f, s, a); TRACE_ARGS_1(f, s, __VA_ARGS__)
+#define TRACE_ARGS_3(f, s, a, ...) TRACE_ARG(f, s, a); TRACE_ARGS_2(f, s, __VA_ARGS__)
+#define TRACE_ARGS_4(f, s, a, ...) TRACE_ARG(f, s, a); TRACE_ARGS_3(f, s, __VA_ARGS__)
+#define TRACE_ARGS_5(f, s, a, ...) TRACE_ARG(f, s, a); TRACE_ARGS_4(f, s, __VA_ARGS__)
+#define TRACE_ARGS_6(f, s, a, ...) TRACE_ARG(f, s, a); TRACE_ARGS_5(f, s, __VA_ARGS__)
+#define TRACE_ARGS_7(f, s, a, ...) TRACE_ARG(f, s, a); TRACE_ARGS_6(f, s, __VA_ARGS__)
+#define TRACE_ARGS_8(f, s, a, ...) TRACE_ARG(f, s, a); TRACE_ARGS_7(f, s, __VA_ARGS__)
+
+#define TRACE(fmt, ...)                                                                            \
+    do {                                                                                           \
+        static const char trace_fmt[] __attribute__((section(TRACE_FMT_SECTION), used)) =          \
+            __FILE__ ":" TRACE_STR(__LINE__) ": " fmt "\n";                                        \
+        uint8_t trace_frame[TRACE_FRAME_SIZE];                                                     \
+        uint8_t trace_size = trace_begin(trace_frame, (uint16_t)(uintptr_t)trace_fmt);             \
+        TRACE_CAT(TRACE_ARGS_, TRACE_NARGS(__VA_ARGS__))(trace_frame, trace_size, ##__VA_ARGS__)   \
+        trace_write(trace_frame, trace_size);                                                      \
+    } while (0)
+
+void trace_init(void);
+// Puts the sync byte and the token first in the frame and returns the size
+uint8_t trace_begin(uint8_t *frame, uint16_t token);
+// Appends an argument to the frame and returns the new size
+uint8_t trace_put_16(uint8_t *frame, uint8_t size, uint16_t value);
+uint8_t trace_put_32(uint8_t *frame, uint8_t size, uint32_t value);
+uint8_t trace_put_str(uint8_t *frame, uint8_t size, const char *string);
+void trace_write(uint8_t *frame, uint8_t size);
+
+#else
 #define TRACE(fmt, ...) trace("%s:%d: " fmt "\n", __FILE__, __LINE__, ##__VA_ARGS__)
 
 #ifndef DISABLE_TRACE
@@ -10,5 +80,6 @@ void trace(const char *format, ...);
 #define trace_init() ;
 #define trace(fmt, ...) ;
 #endif
+#endif // TRACE_TOKENIZED
 
 #endif // TRACE_H
@@ -1,21 +1,58 @@
 #include "drivers/adc.h"
 #include "drivers/io.h"
+#include "drivers/cycles.h"
+#include "drivers/wakeup.h"
 #include "common/defines.h"
 #include "common/assert_handler.h"
 #include <msp430.h>
+#include <assert.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 /* Strategy:
  * Setup ADC to sample a sequence of channels including the channels
  * of interest. Interrupt after the sequence has been sampled and cache
  * the sampled values and start a new round. Let the caller retrieve
- * the latest values from the cache. Use DMA (DTC) and slow clock (ACLK)
- * to reduce CPU involvement. */
+ * the latest values from the cache. Use DMA (DTC) to reduce CPU involvement.
+ *
+ * The clock decides how old the cached values can be. From ACLK (slow), a sequence takes
+ * (16 + 13) / 1.5 kHz = ~20 ms per channel, so the line may be seen several loop iterations
+ * late. From SMCLK / 8 (fast), it takes (16 + 13) / 2 MHz = ~15 us per channel, so ~90 us
+ * for the six channels (A0-A5) on the nsumo, at the cost of ~11 k interrupts/s. The sample
+ * and hold time (16 cycles, 8 us) is still long enough for the QRE1113 output.
+ *
+ * Oversampling and filtering are done in the interrupt, since the sequence is restarted
+ * from there anyway (CONSEQ_1). The sum of 2^n sequences has n fractional bits, which are
+ * scaled to FILTER_FRACTION_BITS, so the filter keeps the extra resolution (10 + 4 bits fit
+ * in int16_t). After k filter updates (2^n sequences each), a step has reached
+ * 1 - (1 - 2^-shift)^k of its height, so it crosses a threshold at fraction f of its height
+ * (strictly, see line.c) on the first update past ln(1 - f) / ln(1 - 2^-shift). A step in
+ * the middle of a round only counts partly in that round's update, so the latency is that
+ * many full updates after the round the step starts in, at most. For the line sensors
+ * (n = 1, shift = 2, ~90 us per sequence), with the threshold at a quarter of the contrast
+ * (see line.c), the formula gives exactly 1, so it takes 2 full updates (25 % isn't past
+ * the threshold, 44 % is), plus the rest of the round, i.e. ~5 sequences or ~0.45 ms. */
+#define FILTER_FRACTION_BITS (4u)
+static_assert(FILTER_FRACTION_BITS >= ADC_OVERSAMPLING_LOG2_MAX, "Sum must fit");
+
 static volatile adc_channel_values_t adc_dtc_block;
 static volatile adc_channel_values_t adc_dtc_block_cache;
-static const io_e *adc_pins;
-static uint8_t adc_pin_cnt;
 static uint8_t dtc_channel_cnt;
+static volatile uint32_t sequence_cnt = 0;
+static adc_sequence_isr_t sequence_isr = NULL;
+static volatile uint16_t isr_cycles_max = 0;
+static uint8_t oversampling_log2 = 0;
+static uint8_t oversampling_cnt = 0;
+static uint8_t filter_shift = 0;
+static bool filter_started = false;
+static uint16_t sums[ADC_CHANNEL_COUNT];
+static int16_t filtered[ADC_CHANNEL_COUNT]; // FILTER_FRACTION_BITS fractional bits
+
+// Clock source and division of each clock option
+static const uint16_t adc_clocks[] = {
+    [ADC_CLOCK_SLOW] = ADC10SSEL_1 + ADC10DIV_7, // ACLK / 8
+    [ADC_CLOCK_FAST] = ADC10SSEL_3 + ADC10DIV_7, // SMCLK / 8
+};
 
 static inline void adc_enable_and_start_conversion(void)
 {
@@ -23,10 +60,15 @@ static inline void adc_enable_and_start_conversion(void)
 }
 
 static bool initialized = false;
-void adc_init(void)
+void adc_init(const struct adc_options *options)
 {
     ASSERT(!initialized);
-    adc_pins = io_adc_pins(&adc_pin_cnt);
+    ASSERT(options->oversampling_log2 <= ADC_OVERSAMPLING_LOG2_MAX);
+    ASSERT(options->filter_shift <= ADC_FILTER_SHIFT_MAX);
+    oversampling_log2 = options->oversampling_log2;
+    filter_shift = options->filter_shift;
+    uint8_t adc_pin_cnt;
+    const io_e *adc_pins = io_adc_pins(&adc_pin_cnt);
 
     uint8_t adc10ae0 = 0;
     uint8_t last_idx = 0;
@@ -41,15 +83,16 @@ void adc_init(void)
     const uint16_t inch = last_idx << 12;
 
     /* inch: Select channels (last channel when CONSEQ_1)
-     * ADC10DIV_7: Clock division (higher means slower)
+     * ADC10DIVx: Clock division (higher means slower)
      * CONSEQ_1: Sequence of channels
      * SHS_0: ADC10SC bit starts conversion
-     * ADC10SSEL_1: ACLK as clock source (Slow) */
-    ADC10CTL1 = inch + ADC10DIV_7 + CONSEQ_1 + SHS_0 + ADC10SSEL_1;
+     * ADC10SSELx: Clock source */
+    ADC10CTL1 = inch + CONSEQ_1 + SHS_0 + adc_clocks[options->clock];
+    sequence_isr = options->sequence_isr;
 
     /* ADC10ON: Enable
      * SREF_0: Voltage reference (VCC and VSS)
-     * ADC10SHT_3: 64 * ADC10CLK sample and hold time (better readings?)
+     * ADC10SHT_2: 16 * ADC10CLK sample and hold time
      * MSC: Multiple sample conversion
      * ADC10IE: Enable interrupt */
     ADC10CTL0 = ADC10ON + SREF_0 + ADC10SHT_2 + MSC + ADC10IE;
@@ -70,24 +113,83 @@ void adc_init(void)
     initialized = true;
 }
 
+/* Interrupts are disabled while an interrupt runs, so this is also how long the other
+ * interrupts may be delayed by it (measured from the first to the last line, the interrupt
+ * entry and exit add ~10 cycles). */
+static void update_values(void)
+{
+    for (uint8_t i = 0; i < dtc_channel_cnt; i++) {
+        const int16_t value = (int16_t)(sums[i] << (FILTER_FRACTION_BITS - oversampling_log2));
+        sums[i] = 0;
+        if (filter_started) {
+            filtered[i] += (int16_t)(value - filtered[i]) >> filter_shift;
+        } else {
+            // Start from the first value, not from 0 (which would look like the line)
+            filtered[i] = value;
+        }
+        // Rounded
+        adc_dtc_block_cache[i] =
+            (uint16_t)(filtered[i] + (1 << (FILTER_FRACTION_BITS - 1))) >> FILTER_FRACTION_BITS;
+    }
+    filter_started = true;
+}
+
 INTERRUPT_FUNCTION(ADC10_VECTOR) isr_adc10(void)
 {
+    const uint16_t start_cycles = cycles_get_16();
     for (uint8_t i = 0; i < dtc_channel_cnt; i++) {
         // DTC writes the channel samples in opposite order
-        adc_dtc_block_cache[i] = adc_dtc_block[dtc_channel_cnt - 1 - i];
+        sums[i] += adc_dtc_block[dtc_channel_cnt - 1 - i];
     }
+    sequence_cnt++;
+    // Start the next sequence first, the rest may take a while
     adc_enable_and_start_conversion();
+    oversampling_cnt++;
+    if (oversampling_cnt == (1u << oversampling_log2)) {
+        oversampling_cnt = 0;
+        update_values();
+        if (sequence_isr) {
+            sequence_isr(adc_dtc_block_cache);
+        }
+    }
+    const uint16_t cycles = cycles_get_16() - start_cycles;
+    if (cycles > isr_cycles_max) {
+        isr_cycles_max = cycles;
+    }
+    WAKEUP_ON_EXIT();
 }
 
+// Read until the count is the same twice, since it may be incremented in between the halves
+uint32_t adc_get_sequence_count(void)
+{
+    uint32_t count;
+    do {
+        count = sequence_cnt;
+    } while (count != sequence_cnt);
+    return count;
+}
+
+/* Copies the cache without disabling any interrupts, and copies it again if a new sequence
+ * was cached in the meantime. The interrupt can't be interrupted by this function, so if
+ * the count is the same before and after, the values are all from the same sequence. A
+ * sequence takes much longer than the copy, so it's copied at most twice. */
 void adc_get_channel_values(adc_channel_values_t values)
 {
-    /* For reason unclear to me, it's not enough to disable local ADC interrupt
-     * here as then ADC stops working after a while, so as a workaround disable
-     * interrupts globally. */
-    _disable_interrupts();
-    for (uint8_t i = 0; i < adc_pin_cnt; i++) {
-        const uint8_t channel_idx = io_to_adc_idx(adc_pins[i]);
-        values[channel_idx] = adc_dtc_block_cache[channel_idx];
-    }
-    _enable_interrupts();
+    uint32_t count;
+    do {
+        count = adc_get_sequence_count();
+        for (uint8_t i = 0; i < dtc_channel_cnt; i++) {
+            values[i] = adc_dtc_block_cache[i];
+        }
+    } while (count != adc_get_sequence_count());
+}
+
+uint16_t adc_get_isr_cycles_max(void)
+{
+    return isr_cycles_max;
+}
+
+void adc_reset_isr_cycles_max(void)
+{
+    isr_cycles_max = 0;
 }
@@ -8,7 +8,39 @@
 #define ADC_CHANNEL_COUNT (8u)
 typedef uint16_t adc_channel_values_t[ADC_CHANNEL_COUNT];
 
-void adc_init(void);
+typedef enum
+{
+    // ACLK / 8 (~1.5 kHz), ~20 ms per channel, for when CPU time matters more than latency
+    ADC_CLOCK_SLOW,
+    // SMCLK / 8 (2 MHz), ~15 us per channel, so the values are at most ~0.1 ms old
+    ADC_CLOCK_FAST,
+} adc_clock_e;
+
+// Called from the ADC interrupt with the values of each new sequence (indexed by channel)
+typedef void (*adc_sequence_isr_t)(const volatile uint16_t *values);
+
+#define ADC_OVERSAMPLING_LOG2_MAX (4u)
+#define ADC_FILTER_SHIFT_MAX (4u)
+
+/* The values can be oversampled (averaged over 2^oversampling_log2 sequences) and then
+ * filtered (y += (x - y) / 2^filter_shift), both 0 to disable. The filter is updated once
+ * per 2^oversampling_log2 sequences, and a step has reached 1 - (1 - 2^-filter_shift)^k
+ * of its height after k updates, e.g. 25 % after 1 and 44 % after 2 for filter_shift 2
+ * (see adc.c for the latency this adds). */
+struct adc_options
+{
+    adc_clock_e clock;
+    uint8_t oversampling_log2; // 0 to ADC_OVERSAMPLING_LOG2_MAX
+    uint8_t filter_shift; // 0 to ADC_FILTER_SHIFT_MAX
+    adc_sequence_isr_t sequence_isr; // Optional (NULL), called when the values are updated
+};
+
+void adc_init(const struct adc_options *options);
 void adc_get_channel_values(adc_channel_values_t values);
+// Number of sampled sequences (all channels) since init, to measure the sample rate
+uint32_t adc_get_sequence_count(void);
+// Longest time the ADC interrupt has run (i.e. kept the other interrupts waiting)
+uint16_t adc_get_isr_cycles_max(void);
+void adc_reset_isr_cycles_max(void);
 
 #endif // ADC_H
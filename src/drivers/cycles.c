@@ -0,0 +1,69 @@
+#include "drivers/cycles.h"
+#include "drivers/millis.h"
+#include "drivers/wakeup.h"
+#include "common/assert_handler.h"
+#include "common/defines.h"
+#include <msp430.h>
+#include <stdbool.h>
+
+/* Timer_A1 runs continuously from SMCLK (undivided), so it counts CPU cycles (MCLK = SMCLK).
+ * The 16-bit counter overflows every ~4 ms, and the overflow interrupt extends it to 48 bits.
+ * The compare registers are used by other drivers, CCR0 by timeout.c and CCR1 by millis.c.
+ * CCR1 shares the interrupt vector with the overflow, so its handler is called from here. */
+
+static volatile uint32_t overflow_cnt = 0;
+
+INTERRUPT_FUNCTION(TIMER1_A1_VECTOR) isr_timer1_a1(void)
+{
+    // Reading TA1IV clears the flag (of the highest priority, the others interrupt again)
+    const uint16_t vector = TA1IV;
+    if (vector == TA1IV_TACCR1) {
+        millis_isr_tick();
+    } else if (vector == TA1IV_TAIFG) {
+        overflow_cnt++;
+    }
+    WAKEUP_ON_EXIT();
+}
+
+static bool initialized = false;
+void cycles_init(void)
+{
+    ASSERT(!initialized);
+    /* TASSEL_2: SMCLK
+     * ID_0: No input divider
+     * MC_2: Continuous mode (count to 0xFFFF)
+     * TAIE: Overflow interrupt */
+    TA1CTL = TASSEL_2 + ID_0 + MC_2 + TACLR + TAIE;
+    initialized = true;
+}
+
+/* Doesn't disable interrupts. Read the overflow count again to detect if an overflow was
+ * handled in between, and check the flag for an overflow not handled yet (interrupts
+ * disabled by the caller). */
+void cycles_get_extended(uint32_t *high, uint16_t *low)
+{
+    uint32_t overflows;
+    uint16_t counter;
+    do {
+        overflows = overflow_cnt;
+        counter = TA1R;
+    } while (overflows != overflow_cnt);
+    if ((TA1CTL & TAIFG) && counter < 0x8000u) {
+        overflows++;
+    }
+    *high = overflows;
+    *low = counter;
+}
+
+uint32_t cycles_get(void)
+{
+    uint32_t high;
+    uint16_t low;
+    cycles_get_extended(&high, &low);
+    return (high << 16) | low;
+}
+
+uint16_t cycles_get_16(void)
+{
+    return TA1R;
+}
@@ -0,0 +1,16 @@
+#ifndef CYCLES_H
+#define CYCLES_H
+
+#include <stdint.h>
+
+/* Free-running CPU cycle counter (16 MHz), for measuring how long code takes to run. Wraps
+ * around after ~268 s, which is fine as long as only differences are used. */
+
+void cycles_init(void);
+uint32_t cycles_get(void);
+// The counter extended to 48 bits, for clocks that must wrap around later (see millis.c)
+void cycles_get_extended(uint32_t *high, uint16_t *low);
+// Only the lower 16 bits, cheaper, for durations up to ~4 ms (e.g. in an interrupt)
+uint16_t cycles_get_16(void);
+
+#endif // CYCLES_H
@@ -0,0 +1,64 @@
+#include "drivers/flash.h"
+#include "common/assert_handler.h"
+#include "common/defines.h"
+#include <msp430.h>
+#include <stdbool.h>
+
+/* The flash controller erases and writes the flash while the CPU is held, so it works from
+ * code that runs from flash, but the interrupts are disabled in the meantime since the
+ * vectors can't be read. The timing generator must run at 257-476 kHz. */
+
+#define FLASH_CLOCK_DIVIDER (40u) // 16 MHz / 40 = 400 kHz
+#define FLASH_INFO_SEGMENT_D_ADDR (0x1000u)
+
+static inline uint16_t *segment_address(flash_info_segment_e segment)
+{
+    ASSERT(segment < FLASH_INFO_SEGMENT_COUNT);
+    // Segment D has the lowest address, B the highest (A is right after B)
+    return (uint16_t *)(uintptr_t)(FLASH_INFO_SEGMENT_D_ADDR + segment * FLASH_INFO_SEGMENT_SIZE);
+}
+
+const void *flash_info_read(flash_info_segment_e segment)
+{
+    return segment_address(segment);
+}
+
+void flash_info_erase(flash_info_segment_e segment)
+{
+    uint16_t *address = segment_address(segment);
+    const uint16_t interrupt_state = __get_interrupt_state();
+    __disable_interrupt();
+    FCTL3 = FWKEY; // Unlock (LOCKA stays set, so segment A can't be erased by mistake)
+    FCTL1 = FWKEY + ERASE;
+    *address = 0; // Dummy write to start the erase of the segment
+    FCTL1 = FWKEY;
+    FCTL3 = FWKEY + LOCK;
+    __set_interrupt_state(interrupt_state);
+}
+
+void flash_info_write(flash_info_segment_e segment, const void *data, uint8_t size)
+{
+    ASSERT(size <= FLASH_INFO_SEGMENT_SIZE && !IS_ODD(size));
+    uint16_t *address = segment_address(segment);
+    const uint16_t *words = data;
+    const uint16_t interrupt_state = __get_interrupt_state();
+    __disable_interrupt();
+    FCTL3 = FWKEY;
+    FCTL1 = FWKEY + WRT;
+    for (uint8_t i = 0; i < size / 2; i++) {
+        address[i] = words[i];
+    }
+    FCTL1 = FWKEY;
+    FCTL3 = FWKEY + LOCK;
+    __set_interrupt_state(interrupt_state);
+}
+
+static bool initialized = false;
+void flash_init(void)
+{
+    ASSERT(!initialized);
+    /* FSSEL_2: SMCLK
+     * FNx: Divide by FNx + 1 */
+    FCTL2 = FWKEY + FSSEL_2 + (FLASH_CLOCK_DIVIDER - 1);
+    initialized = true;
+}
@@ -0,0 +1,31 @@
+#ifndef FLASH_H
+#define FLASH_H
+
+#include <stdint.h>
+
+/* Reads and writes the information flash, which is separate from the program flash, so
+ * it's kept when the program is flashed again. Segment A holds the factory calibration of
+ * the clocks and is never touched, which leaves segments B-D (64 bytes each). A segment must
+ * be erased (all bytes 0xFF) before it's written, and each erase wears the flash a bit (at
+ * least 10k cycles), so only write when something changed. */
+
+#define FLASH_INFO_SEGMENT_SIZE (64u)
+
+typedef enum
+{
+    FLASH_INFO_SEGMENT_D,
+    FLASH_INFO_SEGMENT_C,
+    FLASH_INFO_SEGMENT_B,
+    FLASH_INFO_SEGMENT_COUNT
+} flash_info_segment_e;
+
+void flash_init(void);
+const void *flash_info_read(flash_info_segment_e segment);
+/* Blocks for ~12 ms (4819 cycles of the 400 kHz flash clock, see flash.c) with the
+ * interrupts disabled, which is by far the longest they are disabled, so don't erase while
+ * the robot must react (e.g. during a match) */
+void flash_info_erase(flash_info_segment_e segment);
+// Writes from the start of an erased segment (blocks for ~100 us per word)
+void flash_info_write(flash_info_segment_e segment, const void *data, uint8_t size);
+
+#endif // FLASH_H
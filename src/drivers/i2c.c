@@ -1,13 +1,19 @@
 #include "drivers/i2c.h"
 #include "drivers/io.h"
+#include "drivers/usci.h"
+#include "drivers/cycles.h"
+#include "drivers/timeout.h"
 #include "common/assert_handler.h"
 #include "common/defines.h"
 #include <msp430.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #define DEFAULT_SLAVE_ADDRESS (0x29)
 #define RETRY_COUNT (UINT16_MAX)
 
+static uint8_t slave_address = DEFAULT_SLAVE_ADDRESS;
+
 static inline void i2c_set_tx_byte(uint8_t byte)
 {
     UCB0TXBUF = byte;
@@ -114,6 +120,22 @@ i2c_result_e i2c_stop_transfer(void)
     return (UCB0STAT & UCNACKIFG) ? I2C_RESULT_ERROR_STOP : I2C_RESULT_OK;
 }
 
+// The stop condition is sent after the current byte, and the next start must wait for it
+static void i2c_wait_stop_sent(void)
+{
+    uint16_t retries = RETRY_COUNT;
+    while ((UCB0CTL1 & UCTXSTP) && --retries) { }
+}
+
+/* The queued transactions use the same hardware, let them finish first. They change the
+ * slave address, so set it every time. */
+static void i2c_blocking_prepare(void)
+{
+    while (!i2c_idle()) { }
+    i2c_wait_stop_sent();
+    UCB0I2CSA = slave_address;
+}
+
 i2c_result_e i2c_write(const uint8_t *addr, uint8_t addr_size, const uint8_t *data,
                        uint8_t data_size)
 {
@@ -121,6 +143,7 @@ i2c_result_e i2c_write(const uint8_t *addr, uint8_t addr_size, const uint8_t *da
     ASSERT(addr_size > 0);
     ASSERT(data);
     ASSERT(data_size > 0);
+    i2c_blocking_prepare();
 
     i2c_result_e result = i2c_start_tx_transfer(addr, addr_size);
     if (result) {
@@ -146,6 +169,7 @@ i2c_result_e i2c_read(const uint8_t *addr, uint8_t addr_size, uint8_t *data, uin
     ASSERT(addr_size > 0);
     ASSERT(data);
     ASSERT(data_size > 0);
+    i2c_blocking_prepare();
 
     i2c_result_e result = i2c_start_rx_transfer(addr, addr_size);
     if (result) {
@@ -195,9 +219,482 @@ i2c_result_e i2c_write_addr8_data8(uint8_t addr, uint8_t data)
     return i2c_write(&addr, 1, &data, 1);
 }
 
+i2c_result_e i2c_write_addr8_data16(uint8_t addr, uint16_t data)
+{
+    const uint8_t bytes[] = { data >> 8, data & 0xFF };
+    return i2c_write(&addr, 1, bytes, sizeof(bytes));
+}
+
 void i2c_set_slave_address(uint8_t addr)
 {
-    UCB0I2CSA = addr;
+    slave_address = addr;
+}
+
+/* Non-blocking transactions
+ *
+ * The queue is a linked list of the caller's transactions, so it takes no memory of its own,
+ * and the head is the ongoing one. Each transaction goes through:
+ *     ADDR: Send start (write) and the register address bytes on TXIFG
+ *     TX:   Send the data bytes on TXIFG, then stop
+ *     RX:   Repeated start (read), receive on RXIFG, stop is set while receiving the last
+ *           byte
+ * A NACK (status interrupt) aborts the transaction with a stop.
+ *
+ * Two things have no interrupt in master mode: the stop condition being sent (the next
+ * start must wait for it) and the start condition of a single byte read being sent (the
+ * stop must be set while receiving the only byte). Instead of waiting for them in the
+ * interrupt, which would keep the other interrupts masked for up to a byte time, they are
+ * polled from a timeout (see timeout.h). */
+typedef enum
+{
+    I2C_PHASE_ADDR,
+    I2C_PHASE_TX,
+    I2C_PHASE_RX,
+} i2c_phase_e;
+
+// Volatile since i2c_idle is polled while the interrupts move the queue forward
+static struct i2c_transaction *volatile queue_head = NULL;
+static struct i2c_transaction *queue_tail = NULL;
+static i2c_phase_e phase = I2C_PHASE_ADDR;
+static uint8_t byte_idx = 0;
+
+/* The polls are timed to when the condition is expected to be sent, so most waits take one
+ * or two polls (interrupts) instead of polling every bit time. At 100 kHz, a stop is sent
+ * ~10 us after the last byte received and ~100 us after the last byte sent, and the start and
+ * slave address of a read take 10 bit times (~100 us). The stop of a single byte read must
+ * be set within the next byte time (~90 us), so that one is polled more often once due. */
+#define BUS_POLL_STOP_us (50u)
+#define BUS_POLL_START_FIRST_us (100u)
+#define BUS_POLL_START_us (20u)
+#define BUS_POLL_MAX (20u) // ~0.5-1 ms, many byte times
+
+typedef enum
+{
+    BUS_WAIT_STOP_SENT,
+    BUS_WAIT_START_SENT,
+} bus_wait_e;
+
+static struct timeout bus_timeout;
+static bus_wait_e bus_wait = BUS_WAIT_STOP_SENT;
+static uint8_t bus_polls = 0;
+static volatile uint16_t bus_poll_cnt = 0; // All polls, for the script stats
+
+static volatile uint16_t isr_cycles_max = 0;
+
+/* Measured from the first to the last line of the handler (the interrupt entry and exit add
+ * ~10 cycles), including the completion callback, which may start the next transaction */
+static inline void update_isr_cycles_max(uint16_t start_cycles)
+{
+    const uint16_t cycles = cycles_get_16() - start_cycles;
+    if (cycles > isr_cycles_max) {
+        isr_cycles_max = cycles;
+    }
+}
+
+// NACK is only enabled here, the blocking functions check it by polling
+static inline void i2c_enable_interrupts(void)
+{
+    UCB0I2CIE |= UCNACKIE;
+    IE2 |= UCB0TXIE + UCB0RXIE;
+}
+
+static inline void i2c_disable_interrupts(void)
+{
+    IE2 &= ~(UCB0TXIE + UCB0RXIE);
+    UCB0I2CIE &= ~UCNACKIE;
+}
+
+static void isr_bus_poll_measured(void);
+
+static void bus_poll_next(void)
+{
+    uint16_t poll_us = BUS_POLL_STOP_us;
+    switch (bus_wait) {
+    case BUS_WAIT_STOP_SENT:
+        break;
+    case BUS_WAIT_START_SENT:
+        poll_us = bus_polls ? BUS_POLL_START_us : BUS_POLL_START_FIRST_us;
+        break;
+    }
+    timeout_start(&bus_timeout, poll_us, isr_bus_poll_measured);
+}
+
+static void bus_poll_start(bus_wait_e wait)
+{
+    bus_wait = wait;
+    bus_polls = 0;
+    bus_poll_next();
+}
+
+static void i2c_transaction_begin(void)
+{
+    UCB0I2CSA = queue_head->slave_addr;
+    phase = I2C_PHASE_ADDR;
+    byte_idx = 0;
+    // TXIFG is set once the start condition has been sent
+    UCB0CTL1 |= UCTR + UCTXSTT;
+    i2c_enable_interrupts();
+}
+
+// Starts the head of the queue, once the stop of the previous transaction has been sent
+static void i2c_transaction_start(void)
+{
+    if (UCB0CTL1 & UCTXSTP) {
+        i2c_disable_interrupts();
+        bus_poll_start(BUS_WAIT_STOP_SENT);
+        return;
+    }
+    i2c_transaction_begin();
+}
+
+// Carries on anyway after BUS_POLL_MAX, a stuck bus fails the transaction with a NACK
+static void isr_bus_poll(void)
+{
+    bus_polls++;
+    bus_poll_cnt++;
+    const bool waiting = bus_polls < BUS_POLL_MAX;
+    switch (bus_wait) {
+    case BUS_WAIT_STOP_SENT:
+        if ((UCB0CTL1 & UCTXSTP) && waiting) {
+            bus_poll_next();
+            return;
+        }
+        i2c_transaction_begin();
+        break;
+    case BUS_WAIT_START_SENT:
+        if ((UCB0CTL1 & UCTXSTT) && waiting) {
+            bus_poll_next();
+            return;
+        }
+        UCB0CTL1 |= UCTXSTP;
+        break;
+    }
+}
+
+static void isr_bus_poll_measured(void)
+{
+    const uint16_t start_cycles = cycles_get_16();
+    isr_bus_poll();
+    update_isr_cycles_max(start_cycles);
+}
+
+static void i2c_transaction_done(i2c_result_e result)
+{
+    /* A NACK may end a single byte read while the start is still polled, which would
+     * otherwise set the stop later on an idle bus or in the next transaction */
+    timeout_stop(&bus_timeout);
+    struct i2c_transaction *transaction = queue_head;
+    queue_head = transaction->next;
+    if (queue_head == NULL) {
+        queue_tail = NULL;
+    }
+    struct i2c_transaction *next = queue_head;
+    transaction->next = NULL;
+    transaction->result = result;
+    if (transaction->callback) {
+        // May submit another transaction, which starts right away if the queue is empty
+        transaction->callback(transaction);
+    }
+    if (next) {
+        i2c_transaction_start();
+    } else if (queue_head == NULL) {
+        i2c_disable_interrupts();
+    }
+}
+
+static void isr_tx_rx(void)
+{
+    struct i2c_transaction *transaction = queue_head;
+    if (IFG2 & UCB0RXIFG) {
+        ASSERT_INTERRUPT(phase == I2C_PHASE_RX);
+        // Receive from most to least significant byte
+        transaction->rx_data[transaction->rx_size - 1 - byte_idx] = UCB0RXBUF;
+        byte_idx++;
+        if (byte_idx == transaction->rx_size) {
+            if (transaction->rx_size == 1 && timeout_running(&bus_timeout)) {
+                // The poll was held back by other interrupts, stop right away
+                timeout_stop(&bus_timeout);
+                UCB0CTL1 |= UCTXSTP;
+            }
+            i2c_transaction_done(I2C_RESULT_OK);
+        } else if (byte_idx == transaction->rx_size - 1) {
+            // Must stop while receiving the last byte
+            UCB0CTL1 |= UCTXSTP;
+        }
+        return;
+    }
+
+    switch (phase) {
+    case I2C_PHASE_ADDR:
+        if (byte_idx < transaction->addr_size) {
+            UCB0TXBUF = transaction->addr[byte_idx++];
+            return;
+        }
+        byte_idx = 0;
+        if (transaction->rx_size) {
+            phase = I2C_PHASE_RX;
+            IFG2 &= ~UCB0TXIFG;
+            // Repeated start (and slave address) as receiver after the last address byte
+            UCB0CTL1 &= ~UCTR;
+            UCB0CTL1 |= UCTXSTT;
+            if (transaction->rx_size == 1) {
+                // The stop must be set while receiving the only byte, once the start is sent
+                bus_poll_start(BUS_WAIT_START_SENT);
+            }
+            return;
+        }
+        phase = I2C_PHASE_TX;
+        // fall through
+    case I2C_PHASE_TX:
+        if (byte_idx < transaction->tx_size) {
+            UCB0TXBUF = transaction->tx_data[byte_idx++];
+            return;
+        }
+        // Last byte is in the shift register, stop after it
+        UCB0CTL1 |= UCTXSTP;
+        IFG2 &= ~UCB0TXIFG;
+        i2c_transaction_done(I2C_RESULT_OK);
+        break;
+    case I2C_PHASE_RX:
+        ASSERT_INTERRUPT(0);
+        break;
+    }
+}
+
+static void isr_status(void)
+{
+    if (UCB0STAT & UCNACKIFG) {
+        UCB0CTL1 |= UCTXSTP;
+        UCB0STAT &= ~UCNACKIFG;
+        IFG2 &= ~UCB0TXIFG;
+        switch (phase) {
+        case I2C_PHASE_ADDR:
+            i2c_transaction_done(I2C_RESULT_ERROR_START);
+            break;
+        case I2C_PHASE_TX:
+            i2c_transaction_done(I2C_RESULT_ERROR_TX);
+            break;
+        case I2C_PHASE_RX:
+            i2c_transaction_done(I2C_RESULT_ERROR_RX);
+            break;
+        }
+    }
+}
+
+void i2c_isr_tx_rx(void)
+{
+    const uint16_t start_cycles = cycles_get_16();
+    isr_tx_rx();
+    update_isr_cycles_max(start_cycles);
+}
+
+void i2c_isr_status(void)
+{
+    const uint16_t start_cycles = cycles_get_16();
+    isr_status();
+    update_isr_cycles_max(start_cycles);
+}
+
+uint16_t i2c_get_isr_cycles_max(void)
+{
+    return isr_cycles_max;
+}
+
+void i2c_reset_isr_cycles_max(void)
+{
+    isr_cycles_max = 0;
+}
+
+void i2c_submit(struct i2c_transaction *transaction)
+{
+    ASSERT(transaction->addr);
+    ASSERT(transaction->addr_size > 0);
+    ASSERT(transaction->tx_size == 0 || transaction->tx_data);
+    ASSERT(transaction->rx_size == 0 || transaction->rx_data);
+    transaction->result = I2C_RESULT_PENDING;
+    transaction->next = NULL;
+
+    // Both the USCI and the bus poll (timer) interrupts move the queue forward
+    const uint16_t interrupt_state = __get_interrupt_state();
+    __disable_interrupt();
+    if (queue_tail) {
+        queue_tail->next = transaction;
+        queue_tail = transaction;
+    } else {
+        queue_head = transaction;
+        queue_tail = transaction;
+        i2c_transaction_start();
+    }
+    __set_interrupt_state(interrupt_state);
+}
+
+i2c_result_e i2c_poll(const struct i2c_transaction *transaction)
+{
+    return transaction->result;
+}
+
+bool i2c_idle(void)
+{
+    // Reads of a pointer are atomic on MSP430
+    return queue_head == NULL;
+}
+
+/* Register scripts
+ *
+ * The script steps are submitted as transactions one at a time, and the completion callback
+ * (interrupt context) submits the next one. The register address and the data of writes
+ * point straight into the script code, so nothing is copied. */
+typedef enum
+{
+    SCRIPT_STATE_IDLE,
+    SCRIPT_STATE_RUNNING,
+    SCRIPT_STATE_DELAY,
+} script_state_e;
+
+static struct
+{
+    volatile script_state_e state;
+    volatile i2c_result_e result;
+    const struct i2c_script *script;
+    uint8_t *vars;
+    uint16_t pc; // Index of the current step in the code
+    bool polling; // Current step is a read until
+    uint8_t polls; // Reads of the current read until
+    uint8_t read_value;
+    uint32_t delay_end;
+    uint32_t start_cycles;
+    uint16_t start_bus_polls;
+    uint16_t bytes;
+    struct i2c_transaction transaction;
+} script_run;
+
+static void script_done(i2c_result_e result)
+{
+#ifndef DISABLE_TRACE
+    struct i2c_script_stats *stats = script_run.script->stats;
+    stats->runs++;
+    stats->bytes = script_run.bytes;
+    stats->cycles = cycles_get() - script_run.start_cycles;
+    stats->bus_polls = bus_poll_cnt - script_run.start_bus_polls;
+#endif
+    script_run.result = result;
+    script_run.state = SCRIPT_STATE_IDLE;
+}
+
+/* Must be the last thing a step does, since the completion interrupt can run before it
+ * returns when called from outside the interrupt */
+static void script_submit(const uint8_t *addr, const uint8_t *tx_data, uint8_t tx_size,
+                          uint8_t *rx_data, uint8_t rx_size)
+{
+    struct i2c_transaction *transaction = &script_run.transaction;
+    transaction->addr = addr;
+    transaction->tx_data = tx_data;
+    transaction->tx_size = tx_size;
+    transaction->rx_data = rx_data;
+    transaction->rx_size = rx_size;
+    // Slave address + register + data (+ slave address again for reads)
+    script_run.bytes += 2 + tx_size + (rx_size ? 1 + rx_size : 0);
+    i2c_submit(transaction);
+}
+
+// Submits the next step, or finishes the script
+static void script_step(void)
+{
+    const uint8_t *code = &script_run.script->code[script_run.pc];
+    switch ((i2c_script_op_e)code[0]) {
+    case I2C_SCRIPT_OP_END:
+        script_done(I2C_RESULT_OK);
+        break;
+    case I2C_SCRIPT_OP_WRITE:
+        script_run.pc += 3;
+        script_submit(&code[1], &code[2], 1, NULL, 0);
+        break;
+    case I2C_SCRIPT_OP_WRITE_BURST:
+        script_run.pc += 3 + code[2];
+        script_submit(&code[1], &code[3], code[2], NULL, 0);
+        break;
+    case I2C_SCRIPT_OP_WRITE_VAR:
+        script_run.pc += 3;
+        script_submit(&code[1], &script_run.vars[code[2]], 1, NULL, 0);
+        break;
+    case I2C_SCRIPT_OP_READ:
+        script_run.pc += 4;
+        script_submit(&code[1], NULL, 0, &script_run.vars[code[3]], code[2]);
+        break;
+    case I2C_SCRIPT_OP_READ_UNTIL_SET:
+    case I2C_SCRIPT_OP_READ_UNTIL_CLEAR:
+        // Stays on this step until the value matches (see script_transaction_done)
+        script_run.polling = true;
+        script_run.polls = 1;
+        script_submit(&code[1], NULL, 0, &script_run.read_value, 1);
+        break;
+    case I2C_SCRIPT_OP_DELAY:
+        script_run.delay_end = cycles_get() + (uint32_t)code[1] * CYCLES_PER_MS;
+        script_run.pc += 2;
+        script_run.state = SCRIPT_STATE_DELAY;
+        break;
+    }
+}
+
+static void script_transaction_done(struct i2c_transaction *transaction)
+{
+    if (transaction->result) {
+        script_done(transaction->result);
+        return;
+    }
+    if (script_run.polling) {
+        const uint8_t *code = &script_run.script->code[script_run.pc];
+        const bool set = (script_run.read_value & code[2]) != 0;
+        if (set != (code[0] == I2C_SCRIPT_OP_READ_UNTIL_SET)) {
+            if (script_run.polls == I2C_SCRIPT_POLL_MAX) {
+                script_run.polling = false;
+                script_done(I2C_RESULT_ERROR_TIMEOUT);
+                return;
+            }
+            script_run.polls++;
+            script_submit(&code[1], NULL, 0, &script_run.read_value, 1);
+            return;
+        }
+        script_run.polling = false;
+        script_run.pc += 3;
+    }
+    script_step();
+}
+
+void i2c_script_start(const struct i2c_script *script, uint8_t slave_addr, uint8_t *vars)
+{
+    ASSERT(script_run.state == SCRIPT_STATE_IDLE);
+    script_run.state = SCRIPT_STATE_RUNNING;
+    script_run.result = I2C_RESULT_PENDING;
+    script_run.script = script;
+    script_run.vars = vars;
+    script_run.pc = 0;
+    script_run.polling = false;
+    script_run.bytes = 0;
+    script_run.start_cycles = cycles_get();
+    script_run.start_bus_polls = bus_poll_cnt;
+    script_run.transaction.slave_addr = slave_addr;
+    script_run.transaction.addr_size = 1;
+    script_run.transaction.callback = script_transaction_done;
+    script_step();
+}
+
+i2c_result_e i2c_script_poll(void)
+{
+    if (script_run.state == SCRIPT_STATE_DELAY
+        && (int32_t)(cycles_get() - script_run.delay_end) >= 0) {
+        script_run.state = SCRIPT_STATE_RUNNING;
+        script_step();
+    }
+    return script_run.result;
+}
+
+i2c_result_e i2c_script_run(const struct i2c_script *script, uint8_t *vars)
+{
+    i2c_script_start(script, slave_address, vars);
+    i2c_result_e result;
+    while ((result = i2c_script_poll()) == I2C_RESULT_PENDING) { }
+    return result;
 }
 
 static bool initialized = false;
@@ -1,9 +1,20 @@
 #ifndef I2C_H
 #define I2C_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
-// Polling-based I2C master driver
+/* I2C master driver with two APIs:
+ * - Blocking (i2c_read/i2c_write...): Polls until the transfer is done. Simple, but stalls
+ *   the caller for the duration of the transfer (~100 us per byte at 100 kHz).
+ * - Non-blocking (i2c_submit/i2c_poll): Queues a transaction, which is then run entirely
+ *   from interrupts (USCI, and a timeout for the bus conditions), one after the other. The
+ *   caller continues right away and either polls for the result or gets a callback (in
+ *   interrupt context) when it's done.
+ *
+ * The blocking functions wait for the queued transactions to finish first, so they can be
+ * mixed. Transactions must not be submitted from interrupts other than the completion
+ * callback. */
 
 typedef enum
 {
@@ -13,11 +24,116 @@ typedef enum
     I2C_RESULT_ERROR_RX,
     I2C_RESULT_ERROR_STOP,
     I2C_RESULT_ERROR_TIMEOUT,
+    I2C_RESULT_PENDING, // Transaction is queued or ongoing
 } i2c_result_e;
 
+struct i2c_transaction;
+typedef void (*i2c_callback_t)(struct i2c_transaction *transaction);
+
+/* Writes addr followed by tx_data if rx_size is 0, otherwise writes addr and reads rx_data
+ * (repeated start). Same byte order as the blocking functions. The transaction and the
+ * buffers are owned by the caller and must stay valid until the transaction is done. */
+struct i2c_transaction
+{
+    uint8_t slave_addr;
+    const uint8_t *addr;
+    uint8_t addr_size;
+    const uint8_t *tx_data;
+    uint8_t tx_size;
+    uint8_t *rx_data;
+    uint8_t rx_size;
+    i2c_callback_t callback; // Optional, called from interrupt context
+    // Set by the driver
+    volatile i2c_result_e result;
+    struct i2c_transaction *next;
+};
+
 void i2c_init(void);
+// Slave address of the blocking functions
 void i2c_set_slave_address(uint8_t addr);
 
+/* Register scripts
+ *
+ * A sequence of register operations compiled into a byte array, e.g.
+ *     I2C_SCRIPT(start, I2C_SCRIPT_WRITE(0x80, 0x01), I2C_SCRIPT_WRITE_VAR(0x91, 0),
+ *                I2C_SCRIPT_READ_UNTIL_CLEAR(0x00, 0x01));
+ * The steps run back-to-back on the transaction queue (each completion submits the next
+ * step from the interrupt), so the CPU is free meanwhile, except for delays, which are
+ * resumed by i2c_script_poll. A burst write is a single transaction to consecutive
+ * registers (the device must auto-increment the register address), so group writes to
+ * consecutive registers to save bus bytes. Registers are 8-bit, and only one script runs
+ * at a time.
+ *
+ * vars holds the run-time values of a script (e.g. a calibration value or a read result),
+ * indexed by the var_idx of the steps. */
+typedef enum
+{
+    I2C_SCRIPT_OP_END,
+    I2C_SCRIPT_OP_WRITE,
+    I2C_SCRIPT_OP_WRITE_BURST,
+    I2C_SCRIPT_OP_WRITE_VAR,
+    I2C_SCRIPT_OP_READ,
+    I2C_SCRIPT_OP_READ_UNTIL_SET,
+    I2C_SCRIPT_OP_READ_UNTIL_CLEAR,
+    I2C_SCRIPT_OP_DELAY,
+} i2c_script_op_e;
+
+#define I2C_SCRIPT_WRITE(reg, value) I2C_SCRIPT_OP_WRITE, (reg), (value)
+#define I2C_SCRIPT_WRITE_BURST(reg, ...)                                                           \
+    I2C_SCRIPT_OP_WRITE_BURST, (reg), sizeof((const uint8_t[]) { __VA_ARGS__ }), __VA_ARGS__
+#define I2C_SCRIPT_WRITE_VAR(reg, var_idx) I2C_SCRIPT_OP_WRITE_VAR, (reg), (var_idx)
+// Same byte order as i2c_read
+#define I2C_SCRIPT_READ(reg, size, var_idx) I2C_SCRIPT_OP_READ, (reg), (size), (var_idx)
+/* Reads the register again until any of the mask bits are set (or all cleared). Gives up
+ * with I2C_RESULT_ERROR_TIMEOUT after I2C_SCRIPT_POLL_MAX reads (~100 ms at 100 kHz). */
+#define I2C_SCRIPT_POLL_MAX (250u)
+#define I2C_SCRIPT_READ_UNTIL_SET(reg, mask) I2C_SCRIPT_OP_READ_UNTIL_SET, (reg), (mask)
+#define I2C_SCRIPT_READ_UNTIL_CLEAR(reg, mask) I2C_SCRIPT_OP_READ_UNTIL_CLEAR, (reg), (mask)
+#define I2C_SCRIPT_DELAY_ms(ms) I2C_SCRIPT_OP_DELAY, (ms)
+
+/* Bus bytes (including slave address bytes), cycles and bus polls (timer interrupts waiting
+ * for a start or stop condition) of the last run */
+struct i2c_script_stats
+{
+#ifndef DISABLE_TRACE
+    uint16_t runs;
+    uint16_t bytes;
+    uint32_t cycles;
+    uint16_t bus_polls;
+#endif
+};
+
+struct i2c_script
+{
+    const uint8_t *code;
+    struct i2c_script_stats *stats;
+};
+
+#define I2C_SCRIPT(name, ...)                                                                      \
+    static const uint8_t name##_code[] = { __VA_ARGS__, I2C_SCRIPT_OP_END };                       \
+    static struct i2c_script_stats name##_stats;                                                   \
+    static const struct i2c_script name = { .code = name##_code, .stats = &name##_stats }
+
+// Starts a script (no other script may be running)
+void i2c_script_start(const struct i2c_script *script, uint8_t slave_addr, uint8_t *vars);
+// Returns I2C_RESULT_PENDING until the script is done, must be polled to get past delays
+i2c_result_e i2c_script_poll(void);
+// Runs a script to the end with the slave address of the blocking functions
+i2c_result_e i2c_script_run(const struct i2c_script *script, uint8_t *vars);
+
+// Queues the transaction, it must not already be queued
+void i2c_submit(struct i2c_transaction *transaction);
+// Returns I2C_RESULT_PENDING until the transaction is done
+i2c_result_e i2c_poll(const struct i2c_transaction *transaction);
+// True if no transaction is queued or ongoing
+bool i2c_idle(void);
+/* Longest time an I2C interrupt has run (i.e. kept the other interrupts waiting), the USCI
+ * interrupts and the bus polls of the non-blocking transactions. Known gap: no worst case
+ * has been measured yet (the simulator has no I2C), read it with the console "stats" on the
+ * robot while the range sensors are running. */
+uint16_t i2c_get_isr_cycles_max(void);
+void i2c_reset_isr_cycles_max(void);
+
 // These functions send data in order from most to least significant byte
 i2c_result_e i2c_write(const uint8_t *addr, uint8_t addr_size, const uint8_t *data,
                        uint8_t data_size);
@@ -28,5 +144,6 @@ i2c_result_e i2c_read_addr8_data8(uint8_t addr, uint8_t *data);
 i2c_result_e i2c_read_addr8_data16(uint8_t addr, uint16_t *data);
 i2c_result_e i2c_read_addr8_data32(uint8_t addr, uint32_t *data);
 i2c_result_e i2c_write_addr8_data8(uint8_t addr, uint8_t data);
+i2c_result_e i2c_write_addr8_data16(uint8_t addr, uint16_t data);
 
 #endif // I2C_H
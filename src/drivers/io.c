@@ -1,4 +1,5 @@
 #include "drivers/io.h"
+#include "drivers/wakeup.h"
 #include "common/defines.h"
 #include "common/assert_handler.h"
 
@@ -398,6 +399,7 @@ INTERRUPT_FUNCTION(PORT1_VECTOR) isr_port_1(void)
     for (io_generic_e io = IO_10; io <= IO_17; io++) {
         io_isr(io);
     }
+    WAKEUP_ON_EXIT();
 }
 
 INTERRUPT_FUNCTION(PORT2_VECTOR) isr_port_2(void)
@@ -405,4 +407,5 @@ INTERRUPT_FUNCTION(PORT2_VECTOR) isr_port_2(void)
     for (io_generic_e io = IO_20; io <= IO_27; io++) {
         io_isr(io);
     }
+    WAKEUP_ON_EXIT();
 }
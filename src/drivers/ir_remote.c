@@ -1,21 +1,20 @@
 #include "drivers/ir_remote.h"
 #include "drivers/io.h"
+#include "drivers/millis.h"
+#include "drivers/timeout.h"
+#include "drivers/wakeup.h"
 #include "common/ring_buffer.h"
 #include "common/defines.h"
-#include <msp430.h>
-#include <assert.h>
 #include <stdint.h>
 
 #ifndef DISABLE_IR_REMOTE
 
-#define TICKS_PER_ms (SMCLK / TIMER_INPUT_DIVIDER_3 / 1000u)
-#define TIMER_INTERRUPT_ms (1u)
-#define TIMER_INTERRUPT_TICKS (TICKS_PER_ms * TIMER_INTERRUPT_ms)
-static_assert(TIMER_INTERRUPT_TICKS <= 0xFFFF, "Ticks too large");
-#define TIMER_TIMEOUT_ms (150u)
+#define TIMEOUT_us (150000u)
 
-#define IR_CMD_BUFFER_ELEM_CNT (10u)
-STATIC_RING_BUFFER(ir_cmd_buffer, IR_CMD_BUFFER_ELEM_CNT, uint8_t);
+#define IR_CMD_BUFFER_ELEM_CNT (8u)
+// Filled by the pin interrupt and emptied by ir_remote_get_cmd without masking each other
+DEFINE_RING_BUFFER(cmd_buffer, ir_cmd_e, IR_CMD_BUFFER_ELEM_CNT)
+static struct cmd_buffer ir_cmd_buffer;
 
 static union {
     struct
@@ -31,49 +30,31 @@ static union {
     uint32_t raw;
 } ir_message;
 
-static uint8_t timer_ms = 0;
 static uint16_t pulse_count = 0;
+static uint32_t pulse_time_us = 0;
+// Restarted on every pulse, a message is over if it expires
+static struct timeout message_timeout;
 
-static void ir_timer_init(void)
-{
-    /* Configure timer to trigger interrupt after TIMER_INTERRUPT_TICKS
-     * TASSEL_2: SMCLK
-     * ID_3: Input divider 8 */
-    TA1CTL = TASSEL_2 + ID_3;
-    TA1CCR0 = TIMER_INTERRUPT_TICKS;
-    TA1CCTL0 = CCIE;
-}
-
-static void ir_timer_start(void)
-{
-    // MC_1: Count to CCR0
-    TA1CTL = (TA1CTL & ~TIMER_MC_MASK) | MC_1 | TACLR;
-    timer_ms = 0;
-}
+// The limits are in whole milliseconds, compared in microseconds (no division in the ISR)
+#define US_PER_MS (1000ul)
 
-static void ir_timer_stop(void)
-{
-    // MC_0: Stop counter
-    TA1CTL = (TA1CTL & ~TIMER_MC_MASK) | MC_0;
-}
-
-static inline bool is_valid_pulse(uint16_t pulse, uint8_t ms)
+static inline bool is_valid_pulse(uint16_t pulse, uint32_t us)
 {
     // Roughly sanity check if pulse arrived within expected time
     if (pulse == 1) {
-        return ms == 0;
+        return us < 1 * US_PER_MS;
     } else if (pulse == 2) {
-        return ms < 10;
+        return us < 10 * US_PER_MS;
     } else if (3 <= pulse && pulse <= 34) {
-        return ms < 5;
+        return us < 5 * US_PER_MS;
     } else if (pulse == 35) {
-        return ms < 50;
+        return us < 50 * US_PER_MS;
     } else if (pulse == 36) {
-        return ms < 5;
+        return us < 5 * US_PER_MS;
     } else if (pulse >= 37 && IS_ODD(pulse)) {
-        return ms < 110;
+        return us < 110 * US_PER_MS;
     } else if (pulse >= 37) { // Even
-        return ms < 5;
+        return us < 5 * US_PER_MS;
     } else {
         return false;
     }
@@ -89,49 +70,46 @@ static inline bool is_message_pulse(uint16_t pulse)
     return pulse == 34 || (pulse > 36 && IS_ODD(pulse));
 }
 
+static void isr_message_timeout(void)
+{
+    pulse_count = 0;
+    ir_message.raw = 0;
+}
+
 static void isr_pulse(void)
 {
-    ir_timer_stop();
+    const uint32_t now_us = micros();
+    // Since the previous pulse (0 for the first one), more than the timeout if it's pending
+    // behind this interrupt
+    const uint32_t elapsed_us = pulse_count ? now_us - pulse_time_us : 0;
+    pulse_time_us = now_us;
     pulse_count++;
 
-    if (!is_valid_pulse(pulse_count, timer_ms)) {
+    if (!is_valid_pulse(pulse_count, elapsed_us)) {
         // Assume start of new message
         pulse_count = 1;
         ir_message.raw = 0;
     } else if (is_bit_pulse(pulse_count)) {
         ir_message.raw <<= 1;
-        ir_message.raw += (timer_ms >= 2) ? 1 : 0;
+        ir_message.raw += (elapsed_us >= 2 * US_PER_MS) ? 1 : 0;
     }
 
     if (is_message_pulse(pulse_count)) {
-        ring_buffer_put(&ir_cmd_buffer, &ir_message.decoded.cmd);
+        // Drop the command if full, the oldest ones are only removed by the reader
+        const ir_cmd_e cmd = ir_message.decoded.cmd;
+        cmd_buffer_put(&ir_cmd_buffer, &cmd);
+        wakeup_post(WAKEUP_IR);
     }
 
-    ir_timer_start();
-}
-
-INTERRUPT_FUNCTION(TIMER1_A0_VECTOR) isr_timer_a0(void)
-{
-    if (timer_ms < TIMER_TIMEOUT_ms) {
-        timer_ms++;
-    } else {
-        ir_timer_stop();
-        pulse_count = 0;
-        ir_message.raw = 0;
-        timer_ms = 0;
-    }
+    timeout_start(&message_timeout, TIMEOUT_us, isr_message_timeout);
 }
 #endif // DISABLE_IR_REMOTE
 
 ir_cmd_e ir_remote_get_cmd(void)
 {
 #ifndef DISABLE_IR_REMOTE
-    io_disable_interrupt(IO_IR_REMOTE);
     ir_cmd_e cmd = IR_CMD_NONE;
-    if (!ring_buffer_empty(&ir_cmd_buffer)) {
-        ring_buffer_get(&ir_cmd_buffer, &cmd);
-    }
-    io_enable_interrupt(IO_IR_REMOTE);
+    cmd_buffer_get(&ir_cmd_buffer, &cmd);
     return cmd;
 #else
     return IR_CMD_NONE;
@@ -143,6 +121,5 @@ void ir_remote_init(void)
 #ifndef DISABLE_IR_REMOTE
     io_configure_interrupt(IO_IR_REMOTE, IO_TRIGGER_RISING, isr_pulse);
     io_enable_interrupt(IO_IR_REMOTE);
-    ir_timer_init();
 #endif
 }
@@ -1,11 +1,11 @@
 #include "drivers/mcu_init.h"
 #include "drivers/io.h"
+#include "drivers/cycles.h"
+#include "drivers/millis.h"
+#include "drivers/timeout.h"
 #include "common/assert_handler.h"
 #include <msp430.h>
 
-// 16 MHz / 32768 = ~2000 Hz
-#define WDT_MDLY_0_5_16MHZ (WDTPW + WDTTMSEL + WDTCNTCL + WDTIS0)
-
 static inline void init_clocks()
 {
     /* There are some variations between individual units, so TI calibrates
@@ -30,22 +30,21 @@ static inline void init_clocks()
     BCSCTL3 = LFXT1S_2;
 }
 
-static inline void watchdog_setup(void)
+static inline void watchdog_stop(void)
 {
-    // Stop watchdog
+    // Started again before the main loop (see watchdog.h)
     WDTCTL = WDTPW + WDTHOLD;
-
-    // Re-purpose watchdog to count milliseconds instead (see millis.c)
-    WDTCTL = WDT_MDLY_0_5_16MHZ;
-    IE1 |= WDTIE;
 }
 
 void mcu_init(void)
 {
-    // Must stop and configure watchdog before anything else
-    watchdog_setup();
+    // Must stop watchdog before anything else
+    watchdog_stop();
     init_clocks();
     io_init();
+    cycles_init();
+    millis_init();
+    timeout_init();
     // Enables globally
     _enable_interrupts();
 }
@@ -1,20 +1,49 @@
 #include "drivers/millis.h"
+#include "drivers/cycles.h"
+#include "drivers/wakeup.h"
+#include "common/assert_handler.h"
 #include "common/defines.h"
 #include <msp430.h>
+#include <assert.h>
+#include <stdbool.h>
 
-static volatile uint32_t watchdog_interrupt_cnt = 0;
+static_assert(SMCLK == CYCLES_16MHZ, "micros() assumes 16 cycles per microsecond");
+static_assert(CYCLES_PER_MS <= 0xFFFF, "Must fit the compare register");
 
-INTERRUPT_FUNCTION(WDT_VECTOR) isr_watchdog(void)
+static volatile uint32_t ms_cnt = 0;
+
+// The compare register is moved ahead instead of restarting the (free-running) counter
+void millis_isr_tick(void)
 {
-    watchdog_interrupt_cnt++;
+    TA1CCR1 += CYCLES_PER_MS;
+    ms_cnt++;
+    wakeup_post(WAKEUP_TICK);
 }
 
-uint32_t millis()
+// Read until the count is the same twice, since it may be incremented in between the halves
+uint32_t millis(void)
 {
-    // Disable interrupts while retrieving the counter
-    IE1 &= ~WDTIE;
-    // Divide by two because the watchdog timer triggers every 0.5 ms
-    const uint32_t ms = watchdog_interrupt_cnt / 2;
-    IE1 |= WDTIE;
+    uint32_t ms;
+    do {
+        ms = ms_cnt;
+    } while (ms != ms_cnt);
     return ms;
 }
+
+uint32_t micros(void)
+{
+    uint32_t high;
+    uint16_t low;
+    cycles_get_extended(&high, &low);
+    // Divide the 48-bit cycle count by 16 and keep the lower 32 bits
+    return (high << 12) | (low >> 4);
+}
+
+static bool initialized = false;
+void millis_init(void)
+{
+    ASSERT(!initialized);
+    TA1CCR1 = TA1R + CYCLES_PER_MS;
+    TA1CCTL1 = CCIE;
+    initialized = true;
+}
@@ -3,7 +3,16 @@
 
 #include <stdint.h>
 
-// Milliseconds passed since boot
+/* Time passed since boot, derived from the cycle counter (see cycles.c), so reading it
+ * doesn't disable interrupts. The milliseconds are counted by a compare interrupt every
+ * millisecond, which also wakes up the main loop (see wakeup.h). */
+
+void millis_init(void);
 uint32_t millis(void);
+// Wraps around after ~71 minutes
+uint32_t micros(void);
+
+// Called from the Timer_A1 interrupt in cycles.c, which shares the vector
+void millis_isr_tick(void);
 
 #endif // MILLIS_H
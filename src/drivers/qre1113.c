@@ -1,14 +1,71 @@
 #include "drivers/qre1113.h"
 #include "drivers/adc.h"
 #include "drivers/io.h"
+#include "drivers/wakeup.h"
 #include "common/assert_handler.h"
 #include <stdbool.h>
+#include <stddef.h>
+
+static qre1113_line_isr_t line_isr = NULL;
+static volatile struct qre1113_voltages thresholds = { 0 };
+static uint8_t sensors_prev = 0;
+// Looked up once, so the interrupt doesn't have to
+static uint8_t adc_idx_front_left;
+#if defined(NSUMO)
+static uint8_t adc_idx_front_right;
+static uint8_t adc_idx_back_left;
+static uint8_t adc_idx_back_right;
+#endif
+
+static void isr_adc_sequence(const volatile uint16_t *values)
+{
+    if (!line_isr) {
+        return;
+    }
+    uint8_t sensors = 0;
+    if (values[adc_idx_front_left] < thresholds.front_left) {
+        sensors |= QRE1113_FRONT_LEFT;
+    }
+#if defined(NSUMO)
+    if (values[adc_idx_front_right] < thresholds.front_right) {
+        sensors |= QRE1113_FRONT_RIGHT;
+    }
+    if (values[adc_idx_back_left] < thresholds.back_left) {
+        sensors |= QRE1113_BACK_LEFT;
+    }
+    if (values[adc_idx_back_right] < thresholds.back_right) {
+        sensors |= QRE1113_BACK_RIGHT;
+    }
+#endif
+    if (sensors && !sensors_prev) {
+        line_isr(sensors);
+    }
+    // Also when the line disappears, so the loop sees it right away
+    if (sensors != sensors_prev) {
+        wakeup_post(WAKEUP_LINE);
+    }
+    sensors_prev = sensors;
+}
 
 static bool initialized = false;
 void qre1113_init(void)
 {
     ASSERT(!initialized);
-    adc_init();
+    adc_idx_front_left = io_to_adc_idx(IO_LINE_DETECT_FRONT_LEFT);
+#if defined(NSUMO)
+    adc_idx_front_right = io_to_adc_idx(IO_LINE_DETECT_FRONT_RIGHT);
+    adc_idx_back_left = io_to_adc_idx(IO_LINE_DETECT_BACK_LEFT);
+    adc_idx_back_right = io_to_adc_idx(IO_LINE_DETECT_BACK_RIGHT);
+#endif
+    /* The line must be seen as early as possible, but noise forces the thresholds further
+     * from the edge, so oversample and filter a little (up to ~0.45 ms added latency, see adc.c) */
+    const struct adc_options options = {
+        .clock = ADC_CLOCK_FAST,
+        .oversampling_log2 = 1,
+        .filter_shift = 2,
+        .sequence_isr = isr_adc_sequence,
+    };
+    adc_init(&options);
     initialized = true;
 }
 
@@ -16,10 +73,24 @@ void qre1113_get_voltages(struct qre1113_voltages *voltages)
 {
     adc_channel_values_t values;
     adc_get_channel_values(values);
-    voltages->front_left = values[io_to_adc_idx(IO_LINE_DETECT_FRONT_LEFT)];
+    voltages->front_left = values[adc_idx_front_left];
 #if defined(NSUMO)
-    voltages->front_right = values[io_to_adc_idx(IO_LINE_DETECT_FRONT_RIGHT)];
-    voltages->back_left = values[io_to_adc_idx(IO_LINE_DETECT_BACK_LEFT)];
-    voltages->back_right = values[io_to_adc_idx(IO_LINE_DETECT_BACK_RIGHT)];
+    voltages->front_right = values[adc_idx_front_right];
+    voltages->back_left = values[adc_idx_back_left];
+    voltages->back_right = values[adc_idx_back_right];
 #endif
 }
+
+void qre1113_set_line_isr(qre1113_line_isr_t isr)
+{
+    line_isr = isr;
+}
+
+// Each threshold is written in one instruction, so no need to disable the interrupt
+void qre1113_set_thresholds(const struct qre1113_voltages *new_thresholds)
+{
+    thresholds.front_left = new_thresholds->front_left;
+    thresholds.front_right = new_thresholds->front_right;
+    thresholds.back_left = new_thresholds->back_left;
+    thresholds.back_right = new_thresholds->back_right;
+}
@@ -13,7 +13,20 @@ struct qre1113_voltages
     uint16_t back_right;
 };
 
+// Sensors below their threshold (bitmask)
+#define QRE1113_FRONT_LEFT (1u << 0)
+#define QRE1113_FRONT_RIGHT (1u << 1)
+#define QRE1113_BACK_LEFT (1u << 2)
+#define QRE1113_BACK_RIGHT (1u << 3)
+
+typedef void (*qre1113_line_isr_t)(uint8_t sensors);
+
 void qre1113_init(void);
 void qre1113_get_voltages(struct qre1113_voltages *voltages);
+/* Compares every new sample against the thresholds (lower is line) in the ADC interrupt, and
+ * calls isr (in interrupt context) with the sensors below their threshold when it goes from
+ * none to some (an edge). Keep isr short, it runs on every ADC update (~0.2 ms). */
+void qre1113_set_line_isr(qre1113_line_isr_t isr);
+void qre1113_set_thresholds(const struct qre1113_voltages *thresholds);
 
 #endif // QRE1113_H
@@ -2,6 +2,7 @@
 #include "drivers/pwm.h"
 #include "drivers/io.h"
 #include "common/assert_handler.h"
+#include <msp430.h>
 #include <assert.h>
 
 struct cc_pins
@@ -45,6 +46,42 @@ void tb6612fng_set_pwm(tb6612fng_e tb, uint8_t duty_cycle)
     pwm_set_duty_cycle((pwm_e)tb, duty_cycle);
 }
 
+// Set from interrupt context (a single instruction, so no need to disable interrupts)
+static volatile bool emergency_posted = false;
+
+static void tb6612fng_write_motors(tb6612fng_mode_e mode_left, uint8_t duty_cycle_left,
+                                   tb6612fng_mode_e mode_right, uint8_t duty_cycle_right)
+{
+    tb6612fng_set_mode(TB6612FNG_LEFT, mode_left);
+    tb6612fng_set_mode(TB6612FNG_RIGHT, mode_right);
+    tb6612fng_set_pwm(TB6612FNG_LEFT, duty_cycle_left);
+    tb6612fng_set_pwm(TB6612FNG_RIGHT, duty_cycle_right);
+}
+
+bool tb6612fng_set_motors(tb6612fng_mode_e mode_left, uint8_t duty_cycle_left,
+                          tb6612fng_mode_e mode_right, uint8_t duty_cycle_right)
+{
+    const uint16_t interrupt_state = __get_interrupt_state();
+    __disable_interrupt();
+    const bool set = !emergency_posted;
+    if (set) {
+        tb6612fng_write_motors(mode_left, duty_cycle_left, mode_right, duty_cycle_right);
+    }
+    __set_interrupt_state(interrupt_state);
+    return set;
+}
+
+void tb6612fng_post_emergency(tb6612fng_mode_e mode, uint8_t duty_cycle)
+{
+    emergency_posted = true;
+    tb6612fng_write_motors(mode, duty_cycle, mode, duty_cycle);
+}
+
+void tb6612fng_clear_emergency(void)
+{
+    emergency_posted = false;
+}
+
 static void tb6612fng_assert_io_cfg(void)
 {
     static const struct io_config cc_io_config = {
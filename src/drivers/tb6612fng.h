@@ -4,6 +4,7 @@
 // Driver for motor driver TB6612FNG
 
 #include <stdint.h>
+#include <stdbool.h>
 
 typedef enum
 {
@@ -21,5 +22,15 @@ typedef enum
 void tb6612fng_init(void);
 void tb6612fng_set_mode(tb6612fng_e tb, tb6612fng_mode_e mode);
 void tb6612fng_set_pwm(tb6612fng_e tb, uint8_t duty_cycle);
+/* Sets both motors with the interrupts disabled (a few microseconds), so an emergency
+ * command from interrupt context can't end up mixed with it. Returns false (and sets
+ * nothing) while an emergency command is posted. */
+bool tb6612fng_set_motors(tb6612fng_mode_e mode_left, uint8_t duty_cycle_left,
+                          tb6612fng_mode_e mode_right, uint8_t duty_cycle_right);
+/* Interrupt context, sets both motors right away and posts the command, so the main loop
+ * doesn't override it before it has seen why (see tb6612fng_clear_emergency) */
+void tb6612fng_post_emergency(tb6612fng_mode_e mode, uint8_t duty_cycle);
+// Lets tb6612fng_set_motors through again
+void tb6612fng_clear_emergency(void);
 
 #endif
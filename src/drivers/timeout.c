@@ -0,0 +1,117 @@
+#include "drivers/timeout.h"
+#include "drivers/millis.h"
+#include "drivers/wakeup.h"
+#include "common/assert_handler.h"
+#include "common/defines.h"
+#include <msp430.h>
+#include <stddef.h>
+
+#define TIMEOUT_DURATION_MAX_us (0x7FFFFFFFul)
+
+// Sorted by deadline, only modified with interrupts disabled
+static struct timeout *timeouts = NULL;
+
+static inline bool is_due(const struct timeout *timeout)
+{
+    return (int32_t)(timeout->deadline_us - micros()) <= 0;
+}
+
+static void remove_timeout(struct timeout *timeout)
+{
+    for (struct timeout **link = &timeouts; *link != NULL; link = &(*link)->next) {
+        if (*link == timeout) {
+            *link = timeout->next;
+            break;
+        }
+    }
+    timeout->running = false;
+}
+
+/* Expires the timeouts that are due, and sets the compare register to the next deadline.
+ * Interrupts must be disabled. */
+static void update(void)
+{
+    while (timeouts != NULL) {
+        struct timeout *first = timeouts;
+        if (!is_due(first)) {
+            // Cycles = microseconds * 16, the counter wraps at 16 bits
+            TA1CCR0 = (uint16_t)(first->deadline_us << 4);
+            // Clears a stale flag as well
+            TA1CCTL0 = CCIE;
+            // The counter may have passed the deadline while setting the compare register
+            if (!is_due(first)) {
+                return;
+            }
+        }
+        timeouts = first->next;
+        first->running = false;
+        first->expired = true;
+        if (first->callback) {
+            // May start it again, which is why it's removed first
+            first->callback();
+        }
+    }
+    TA1CCTL0 = 0;
+}
+
+INTERRUPT_FUNCTION(TIMER1_A0_VECTOR) isr_timer1_a0(void)
+{
+    // The flag is cleared automatically (single source vector)
+    update();
+    WAKEUP_ON_EXIT();
+}
+
+void timeout_start(struct timeout *timeout, uint32_t duration_us, timeout_callback_t callback)
+{
+    ASSERT(duration_us <= TIMEOUT_DURATION_MAX_us);
+    const uint16_t interrupt_state = __get_interrupt_state();
+    __disable_interrupt();
+    if (timeout->running) {
+        remove_timeout(timeout);
+    }
+    timeout->deadline_us = micros() + duration_us;
+    timeout->callback = callback;
+    timeout->expired = false;
+    timeout->running = true;
+    struct timeout **link = &timeouts;
+    while (*link != NULL && (int32_t)((*link)->deadline_us - timeout->deadline_us) <= 0) {
+        link = &(*link)->next;
+    }
+    timeout->next = *link;
+    *link = timeout;
+    // Only the first deadline is in the compare register
+    if (timeouts == timeout) {
+        update();
+    }
+    __set_interrupt_state(interrupt_state);
+}
+
+void timeout_stop(struct timeout *timeout)
+{
+    const uint16_t interrupt_state = __get_interrupt_state();
+    __disable_interrupt();
+    if (timeout->running) {
+        // If it was the first, the compare interrupt is spurious, but harmless
+        remove_timeout(timeout);
+    }
+    timeout->expired = false;
+    __set_interrupt_state(interrupt_state);
+}
+
+bool timeout_expired(const struct timeout *timeout)
+{
+    return timeout->expired;
+}
+
+bool timeout_running(const struct timeout *timeout)
+{
+    return timeout->running;
+}
+
+static bool initialized = false;
+void timeout_init(void)
+{
+    ASSERT(!initialized);
+    TA1CCTL0 = 0;
+    initialized = true;
+}
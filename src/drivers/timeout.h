@@ -0,0 +1,35 @@
+#ifndef TIMEOUT_H
+#define TIMEOUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Timeouts that expire from a compare interrupt (Timer_A1 CCR0) instead of being polled. Any
+ * number of timeouts can run at the same time, they are kept in a list sorted by deadline,
+ * and the compare register is set to the earliest one. The optional callback is called from
+ * the interrupt when the timeout expires, so it must be short. Timeouts without a callback
+ * can be polled with timeout_expired instead.
+ *
+ * The deadlines are in microseconds (see micros), so a timeout can be up to ~35 minutes. The
+ * compare register only holds the lower 16 bits of the deadline (in cycles), so a deadline
+ * further away than ~4 ms interrupts once every ~4 ms until it's reached. */
+
+typedef void (*timeout_callback_t)(void);
+
+struct timeout
+{
+    struct timeout *next;
+    uint32_t deadline_us;
+    timeout_callback_t callback;
+    volatile bool running;
+    volatile bool expired;
+};
+
+void timeout_init(void);
+// Restarts the timeout if already running. Callback may be NULL.
+void timeout_start(struct timeout *timeout, uint32_t duration_us, timeout_callback_t callback);
+void timeout_stop(struct timeout *timeout);
+bool timeout_expired(const struct timeout *timeout);
+bool timeout_running(const struct timeout *timeout);
+
+#endif // TIMEOUT_H
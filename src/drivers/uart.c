@@ -1,5 +1,8 @@
 #include "drivers/uart.h"
+#include "drivers/usci.h"
+#include "drivers/wakeup.h"
 #include "common/ring_buffer.h"
+#include "common/trace.h"
 #include "common/assert_handler.h"
 #include "common/defines.h"
 #include <msp430.h>
@@ -7,37 +10,52 @@
 #include <stdint.h>
 #include <stddef.h>
 
-#define UART_BUFFER_SIZE (16u)
-STATIC_RING_BUFFER(tx_buffer, UART_BUFFER_SIZE, uint8_t);
+// Filled by _putchar and emptied by the TX interrupt without masking each other
+DEFINE_RING_BUFFER(uart_buffer, uint8_t, UART_TX_BUFFER_SIZE)
+static struct uart_buffer tx_buffer;
+#if !defined(DISABLE_TRACE) && defined(TRACE_TOKENIZED)
+static_assert(UART_TX_BUFFER_SIZE >= TRACE_FRAME_SIZE, "Must fit a tokenized trace frame");
+#endif
+
+static inline void add_saturated(uint16_t *counter, uint16_t value)
+{
+    *counter = (*counter > UINT16_MAX - value) ? UINT16_MAX : *counter + value;
+}
+
+static uart_tx_policy_e tx_policy = UART_TX_POLICY_DROP_NEWEST;
+// Filled by the RX interrupt and emptied by uart_read
+DEFINE_RING_BUFFER(uart_rx_buffer, uint8_t, UART_RX_BUFFER_SIZE)
+static struct uart_rx_buffer rx_buffer;
+static struct uart_stats stats;
 
 /* Calculate the integer and fractional part of the divisor
  * N = (Clock source / Desired baudrate)
  * for Low-Frequency Baud Rate Mode.
  *
- * These are used to configure the desired baudrate.
- *
- * For information on the corresponding transmission error
- * for common values, please refer to the table provided in
- * the family user guide (SLAU144K). */
+ * The divisor is calculated in 1/8 steps (rounded to nearest), the integer part goes to
+ * the prescaler and the fractional part to the second modulation stage (UCBRS). This gives
+ * the same values as the table in the family user guide (SLAU144K), which also lists the
+ * resulting worst-case bit error, e.g. 115200 (138, 7), 230400 (69, 4), 460800 (34, 6),
+ * 921600 (17, 3) and 1000000 (16, 0). */
 #define BRCLK (SMCLK)
-#define UART_BAUD_RATE (115200u)
-static_assert(UART_BAUD_RATE < (BRCLK / 3.0f),
-              "Baudrate must be smaller than 1/3 of input clock in Low-Frequency Mode");
-#define UART_DIVISOR ((float)BRCLK / UART_BAUD_RATE)
-static_assert(UART_DIVISOR < 0xFFFFu, "Sanity check divisor fits in 16-bit");
-#define UART_DIVISOR_INT_16BIT ((uint16_t)UART_DIVISOR)
+/* Low-frequency mode works down to N = 3, but the bit error grows as N shrinks, since each
+ * bit is off by up to a whole BRCLK period, so stay within the table of the user guide */
+static_assert(UART_BAUD_RATE <= BRCLK / 16, "Max BRCLK / 16 (the top of the user guide table)");
+#define UART_DIVISOR_x8 ((8ul * BRCLK + UART_BAUD_RATE / 2) / UART_BAUD_RATE)
+static_assert(UART_DIVISOR_x8 / 8 <= 0xFFFFu, "Sanity check divisor fits in 16-bit");
+// The average baud rate error from the rounding, the receiver tolerates a few percent
+#define UART_BAUD_ERROR_PPM                                                                        \
+    ((UART_DIVISOR_x8 * UART_BAUD_RATE > 8ul * BRCLK                                               \
+          ? UART_DIVISOR_x8 * UART_BAUD_RATE - 8ul * BRCLK                                         \
+          : 8ul * BRCLK - UART_DIVISOR_x8 * UART_BAUD_RATE)                                        \
+     / (8ul * BRCLK / 1000000ul))
+static_assert(UART_BAUD_ERROR_PPM <= 5000, "Baud rate not reachable within 0.5 % from SMCLK");
+#define UART_DIVISOR_INT_16BIT ((uint16_t)(UART_DIVISOR_x8 >> 3))
 #define UART_DIVISOR_INT_LOW_BYTE (UART_DIVISOR_INT_16BIT & 0xFF)
 #define UART_DIVISOR_INT_HIGH_BYTE (UART_DIVISOR_INT_16BIT >> 8)
-#define UART_DIVISOR_FRACTIONAL (UART_DIVISOR - UART_DIVISOR_INT_16BIT)
-#define UART_UCBRS ((uint8_t)(8 * UART_DIVISOR_FRACTIONAL))
+#define UART_UCBRS ((uint8_t)(UART_DIVISOR_x8 & 0x7))
 #define UART_UCBRF (0)
 #define UART_UC0S16 (0)
-static_assert(UART_UCBRS < 8, "Sanity check second modulation stage value fits in 3-bit");
-
-static inline void uart_tx_clear_interrupt(void)
-{
-    IFG2 &= ~UCA0TXIFG;
-}
 
 static inline void uart_tx_enable_interrupt(void)
 {
@@ -49,27 +67,27 @@ static inline void uart_tx_disable_interrupt(void)
     UC0IE &= ~UCA0TXIE;
 }
 
-static void uart_tx_start(void)
+static inline void uart_rx_enable_interrupt(void)
 {
-    if (!ring_buffer_empty(&tx_buffer)) {
-        uint8_t c = 0;
-        ring_buffer_peek_tail(&tx_buffer, &c);
-        UCA0TXBUF = c;
-    }
+    UC0IE |= UCA0RXIE;
 }
 
-INTERRUPT_FUNCTION(USCIAB0TX_VECTOR) isr_uart_tx()
+static inline void uart_rx_disable_interrupt(void)
 {
-    ASSERT_INTERRUPT(!ring_buffer_empty(&tx_buffer));
-
-    // Remove the transmitted data byte from the buffer
-    ring_buffer_get(&tx_buffer, NULL);
-
-    // Clear interrupt here to avoid accidently clearing interrupt for next transmission
-    uart_tx_clear_interrupt();
+    UC0IE &= ~UCA0RXIE;
+}
 
-    if (!ring_buffer_empty(&tx_buffer)) {
-        uart_tx_start();
+/* The TX interrupt flag is set whenever the TX buffer register is empty (and cleared by
+ * writing to it), so the interrupt is only enabled while there is data to send. The ISR
+ * disables it when the buffer runs empty, and uart_write enables it after each put,
+ * which is a single (atomic) instruction, so a byte can't get stuck in the buffer. */
+void uart_isr_tx(void)
+{
+    uint8_t c = 0;
+    if (uart_buffer_get(&tx_buffer, &c)) {
+        UCA0TXBUF = c;
+    } else {
+        uart_tx_disable_interrupt();
     }
 }
 
@@ -98,40 +116,109 @@ static void uart_configure(void)
     UCA0CTL1 &= ~UCSWRST;
 }
 
+void uart_isr_rx(void)
+{
+    // Reading the RX buffer register clears the interrupt flag
+    const uint8_t c = UCA0RXBUF;
+    if (!uart_rx_buffer_put(&rx_buffer, &c)) {
+        add_saturated(&stats.rx_dropped, 1);
+    }
+    wakeup_post(WAKEUP_UART);
+}
+
+uint8_t uart_read(uint8_t *data, uint8_t size)
+{
+    return uart_rx_buffer_get_n(&rx_buffer, data, size);
+}
+
 static bool initialized = false;
 void uart_init(void)
 {
-    ASSERT(!initialized);
+    if (initialized) {
+        return;
+    }
     uart_configure();
-    // Interrupt triggers when TX buffer is empty, which it is after boot, so clear it here.
-    uart_tx_clear_interrupt();
-    uart_tx_enable_interrupt();
+    uart_rx_enable_interrupt();
     initialized = true;
 }
 
-// mpaland/printf needs this to be named _putchar
-void _putchar(char c)
+void uart_set_tx_policy(uart_tx_policy_e policy)
 {
-    // Some terminals expect carriage return (\r) before line-feed (\n) for proper new line.
-    if (c == '\n') {
-        _putchar('\r');
-    }
+    tx_policy = policy;
+}
 
-    // Poll if full
-    while (ring_buffer_full(&tx_buffer)) { }
+void uart_get_stats(struct uart_stats *stats_out)
+{
+    *stats_out = stats;
+}
 
+void uart_reset_stats(void)
+{
+    stats.tx_dropped = 0;
+    stats.tx_blocked = 0;
+    stats.rx_dropped = 0;
+}
+
+/* Removes the oldest bytes from the consumer side, so the TX interrupt must be masked,
+ * but only for this (when the buffer is full) */
+static void uart_drop_oldest(uint8_t count)
+{
     uart_tx_disable_interrupt();
-    const bool tx_ongoing = !ring_buffer_empty(&tx_buffer);
-    ring_buffer_put(&tx_buffer, &c);
-    if (!tx_ongoing) {
-        uart_tx_start();
+    for (uint8_t i = 0; i < count; i++) {
+        uart_buffer_get(&tx_buffer, NULL);
     }
     uart_tx_enable_interrupt();
+    add_saturated(&stats.tx_dropped, count);
+}
+
+void uart_write(const uint8_t *data, uint16_t size)
+{
+    if (size > UART_TX_BUFFER_SIZE && tx_policy != UART_TX_POLICY_BLOCK) {
+        add_saturated(&stats.tx_dropped, size);
+        return;
+    }
+    const uint8_t space = UART_TX_BUFFER_SIZE - uart_buffer_count(&tx_buffer);
+    if (size > space) {
+        switch (tx_policy) {
+        case UART_TX_POLICY_BLOCK:
+            add_saturated(&stats.tx_blocked, 1);
+            break;
+        case UART_TX_POLICY_DROP_NEWEST:
+            add_saturated(&stats.tx_dropped, size);
+            return;
+        case UART_TX_POLICY_DROP_OLDEST:
+            uart_drop_oldest(size - space);
+            break;
+        }
+    }
+    while (size) {
+        // Poll if full (only with UART_TX_POLICY_BLOCK)
+        const uint8_t chunk = size < UINT8_MAX ? size : UINT8_MAX;
+        const uint8_t count = uart_buffer_put_n(&tx_buffer, data, chunk);
+        if (count) {
+            uart_tx_enable_interrupt();
+        }
+        data += count;
+        size -= count;
+    }
+}
+
+// mpaland/printf needs this to be named _putchar
+void _putchar(char c)
+{
+    // Some terminals expect carriage return (\r) before line-feed (\n) for proper new line.
+    if (c == '\n') {
+        const uint8_t newline[] = { '\r', '\n' };
+        uart_write(newline, sizeof(newline));
+    } else {
+        uart_write((const uint8_t *)&c, 1);
+    }
 }
 
 void uart_init_assert(void)
 {
     uart_tx_disable_interrupt();
+    uart_rx_disable_interrupt();
     uart_configure();
 }
 
@@ -1,8 +1,47 @@
 #ifndef UART_H
 #define UART_H
 
+#include <stdint.h>
+
+/* Transmits from a buffer (interrupt driven), so writing only blocks if the buffer is full
+ * and the policy is UART_TX_POLICY_BLOCK. Configured at compile time (override with -D):
+ * UART_BAUD_RATE: up to 1000000 (SMCLK / 16), checked against the divisor error in uart.c
+ * UART_TX_BUFFER_SIZE: power of two, at least one tokenized trace frame (see trace.h) */
+#ifndef UART_BAUD_RATE
+#define UART_BAUD_RATE (115200u)
+#endif
+#ifndef UART_TX_BUFFER_SIZE
+#define UART_TX_BUFFER_SIZE (64u)
+#endif
+#define UART_RX_BUFFER_SIZE (16u)
+
+typedef enum
+{
+    // Wait for space, never loses data (e.g. input record), but may stall the caller
+    UART_TX_POLICY_BLOCK,
+    // Drop what doesn't fit (whole writes, so binary frames stay intact) (default)
+    UART_TX_POLICY_DROP_NEWEST,
+    // Drop the oldest buffered bytes to make room, keeps the latest text traces
+    UART_TX_POLICY_DROP_OLDEST,
+} uart_tx_policy_e;
+
+struct uart_stats
+{
+    uint16_t tx_dropped; // Bytes dropped (saturates)
+    uint16_t tx_blocked; // Writes that had to wait for space (saturates)
+    uint16_t rx_dropped; // Bytes received while the RX buffer was full (saturates)
+};
+
+// Shared by trace, input record and the console, only the first call initializes
 void uart_init(void);
+void uart_set_tx_policy(uart_tx_policy_e policy);
+void uart_get_stats(struct uart_stats *stats);
+void uart_reset_stats(void);
+// Reads up to size received bytes (buffered by the RX interrupt), returns how many
+uint8_t uart_read(uint8_t *data, uint8_t size);
 void _putchar(char c);
+// Raw bytes, unlike _putchar, which inserts carriage return before line-feed
+void uart_write(const uint8_t *data, uint16_t size);
 
 // These functions should ONLY be called by assert_handler!
 void uart_init_assert(void);
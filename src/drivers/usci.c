@@ -0,0 +1,27 @@
+#include "drivers/usci.h"
+#include "drivers/wakeup.h"
+#include "common/defines.h"
+#include <msp430.h>
+
+// Only dispatch flags with the interrupt enabled, the flags are also polled
+
+INTERRUPT_FUNCTION(USCIAB0TX_VECTOR) isr_usciab0_tx(void)
+{
+    if ((IFG2 & UCA0TXIFG) && (UC0IE & UCA0TXIE)) {
+        uart_isr_tx();
+    }
+    if ((IFG2 & (UCB0TXIFG + UCB0RXIFG)) && (IE2 & (UCB0TXIE + UCB0RXIE))) {
+        i2c_isr_tx_rx();
+    }
+}
+
+INTERRUPT_FUNCTION(USCIAB0RX_VECTOR) isr_usciab0_rx(void)
+{
+    if ((IFG2 & UCA0RXIFG) && (UC0IE & UCA0RXIE)) {
+        uart_isr_rx();
+    }
+    if ((UCB0STAT & UCNACKIFG) && (UCB0I2CIE & UCNACKIE)) {
+        i2c_isr_status();
+    }
+    WAKEUP_ON_EXIT();
+}
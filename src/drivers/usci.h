@@ -0,0 +1,15 @@
+#ifndef USCI_H
+#define USCI_H
+
+/* USCI_A0 (UART) and USCI_B0 (I2C) share the same two interrupt vectors, so the ISRs live in
+ * usci.c and call these handlers of the drivers depending on which flag is set. */
+
+// USCIAB0TX_VECTOR
+void uart_isr_tx(void);
+void i2c_isr_tx_rx(void);
+
+// USCIAB0RX_VECTOR
+void uart_isr_rx(void);
+void i2c_isr_status(void);
+
+#endif // USCI_H
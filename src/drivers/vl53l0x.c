@@ -1,8 +1,14 @@
 #include "drivers/vl53l0x.h"
 #include "drivers/i2c.h"
 #include "drivers/io.h"
+#include "drivers/millis.h"
+#include "drivers/wakeup.h"
 #include "common/defines.h"
 #include "common/assert_handler.h"
+#include "common/trace.h"
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
 
 #define REG_IDENTIFICATION_MODEL_ID (0xC0)
 #define REG_VHV_CONFIG_PAD_SCL_SDA_EXTSUP_HV (0x89)
@@ -20,12 +26,63 @@
 #define REG_GLOBAL_CONFIG_SPAD_ENABLES_REF_0 (0xB0)
 #define REG_RESULT_RANGE_STATUS (0x14)
 #define REG_SLAVE_DEVICE_ADDRESS (0x8A)
+#define REG_SYSTEM_INTERMEASUREMENT_PERIOD (0x04)
+#define REG_OSC_CALIBRATE_VAL (0xF8)
+#define REG_MSRC_CONFIG_TIMEOUT_MACROP (0x46)
+#define REG_PRE_RANGE_CONFIG_VCSEL_PERIOD (0x50)
+#define REG_PRE_RANGE_CONFIG_TIMEOUT_MACROP_HI (0x51)
+#define REG_PRE_RANGE_CONFIG_VALID_PHASE_LOW (0x56)
+#define REG_PRE_RANGE_CONFIG_VALID_PHASE_HIGH (0x57)
+#define REG_FINAL_RANGE_CONFIG_VCSEL_PERIOD (0x70)
+#define REG_FINAL_RANGE_CONFIG_TIMEOUT_MACROP_HI (0x71)
+#define REG_FINAL_RANGE_CONFIG_VALID_PHASE_LOW (0x47)
+#define REG_FINAL_RANGE_CONFIG_VALID_PHASE_HIGH (0x48)
+#define REG_GLOBAL_CONFIG_VCSEL_WIDTH (0x32)
+#define REG_ALGO_PHASECAL_CONFIG_TIMEOUT (0x30)
+#define REG_ALGO_PHASECAL_LIM (0x30) // On page 0x01 (0xFF)
+
+static_assert(REG_DYNAMIC_SPAD_REF_EN_START_OFFSET == REG_DYNAMIC_SPAD_NUM_REQUESTED_REF_SPAD + 1,
+              "Written in a burst");
 
 #define RANGE_SEQUENCE_STEP_TCC (0x10) // Target CentreCheck
 #define RANGE_SEQUENCE_STEP_MSRC (0x04) // Minimum Signal Rate Check
 #define RANGE_SEQUENCE_STEP_DSS (0x28) // Dynamic SPAD selection
 #define RANGE_SEQUENCE_STEP_PRE_RANGE (0x40)
 #define RANGE_SEQUENCE_STEP_FINAL_RANGE (0x80)
+#define RANGE_SEQUENCE_STEPS_ENABLED                                                               \
+    (RANGE_SEQUENCE_STEP_DSS + RANGE_SEQUENCE_STEP_PRE_RANGE + RANGE_SEQUENCE_STEP_FINAL_RANGE)
+
+#define SYSRANGE_MODE_SINGLESHOT (0x01)
+#define SYSRANGE_MODE_BACKTOBACK (0x02)
+#define SYSRANGE_MODE_TIMED (0x04)
+
+/* The sensors without an interrupt pin are polled, which takes ~0.4 ms on the 100 kHz bus,
+ * so don't poll them until their measurement is about to finish (just under the timing
+ * budget) */
+#define MEASUREMENT_POLL_MARGIN_ms (3u)
+#define POLL_DELAY_ms(budget_us) ((uint8_t)((budget_us) / 1000) - MEASUREMENT_POLL_MARGIN_ms)
+
+// How many measurement periods to wait for the first interrupt of the front sensor
+#define FRONT_READY_TIMEOUT_PERIODS (2u)
+
+/* Time spent on each step of a measurement, the final range step gets what's left of the
+ * timing budget (from the ST API) */
+#define TIMING_BUDGET_MIN_us (20000ul)
+#define TIMING_BUDGET_DEFAULT_us (33000ul)
+#define TIMING_OVERHEAD_START_us (1910u)
+#define TIMING_OVERHEAD_END_us (960u)
+#define TIMING_OVERHEAD_MSRC_us (660u)
+#define TIMING_OVERHEAD_TCC_us (590u)
+#define TIMING_OVERHEAD_DSS_us (690u)
+#define TIMING_OVERHEAD_PRE_RANGE_us (660u)
+#define TIMING_OVERHEAD_FINAL_RANGE_us (550u)
+
+// The VCSEL (laser) period is stored as (period / 2 - 1) in PCLKs
+#define VCSEL_PERIOD_DECODE(reg) (((reg) + 1u) << 1)
+#define VCSEL_PERIOD_ENCODE(pclks) (((pclks) >> 1) - 1u)
+
+// The signal rate limit register is fixed point 9.7 in MCPS (mega counts per second)
+#define SIGNAL_RATE_LIMIT_MCPS(mcps) ((uint16_t)((mcps) * (1 << 7)))
 
 #define VL53L0X_EXPECTED_DEVICE_ID (0xEE)
 #define VL53L0X_DEFAULT_ADDRESS (0x29)
@@ -56,25 +113,12 @@ typedef enum
     VL53L0X_CALIBRATION_TYPE_PHASE
 } vl53l0x_calibration_type_e;
 
-typedef enum
-{
-    STATUS_MULTIPLE_NOT_STARTED,
-    STATUS_MULTIPLE_MEASURING,
-    STATUS_MULTIPLE_DONE
-} status_multiple_e;
-
 struct vl53l0x_cfg
 {
     uint8_t addr;
     io_e xshut_io;
 };
 
-struct i2c_8reg
-{
-    uint8_t addr;
-    uint8_t data;
-};
-
 static const struct vl53l0x_cfg vl53l0x_cfgs[] = {
     [VL53L0X_IDX_FRONT] = { .addr = 0x30, .xshut_io = IO_XSHUT_FRONT },
 #if defined(NSUMO)
@@ -85,9 +129,48 @@ static const struct vl53l0x_cfg vl53l0x_cfgs[] = {
 #endif
 };
 
+// The sensors measured by vl53l0x_read_range_multiple
+static const vl53l0x_idx_e measured_idxs[] = {
+    VL53L0X_IDX_FRONT,
+#if defined(NSUMO)
+    VL53L0X_IDX_FRONT_LEFT,
+    VL53L0X_IDX_FRONT_RIGHT,
+#endif
+#if 0 // Skip left and right, since they are are mounted badly
+    VL53L0X_IDX_LEFT,
+    VL53L0X_IDX_RIGHT,
+#endif
+};
+
+struct vl53l0x_profile_cfg
+{
+    uint32_t timing_budget_us;
+    uint16_t signal_rate_limit;
+    uint8_t pre_range_vcsel_period;
+    uint8_t final_range_vcsel_period;
+};
+
+// What vl53l0x_init leaves (the default tuning settings)
+#define PROFILE_CFG_DEFAULT { TIMING_BUDGET_DEFAULT_us, SIGNAL_RATE_LIMIT_MCPS(0.25), 14, 10 }
+
+// Based on the profiles of the ST API
+static const struct vl53l0x_profile_cfg profile_cfgs[] = {
+    [VL53L0X_PROFILE_DEFAULT] = PROFILE_CFG_DEFAULT,
+    [VL53L0X_PROFILE_HIGH_SPEED] = { 20000, SIGNAL_RATE_LIMIT_MCPS(0.25), 14, 10 },
+    [VL53L0X_PROFILE_LONG_RANGE] = { 33000, SIGNAL_RATE_LIMIT_MCPS(0.1), 18, 14 },
+};
+
 static uint8_t stop_variable = 0;
-// Reads/Writes to this can be considered atomic on MSP430
-static volatile status_multiple_e status_multiple = STATUS_MULTIPLE_NOT_STARTED;
+/* The sensors are configured the same, so the configuration is kept once for all of them,
+ * but while measuring, a sensor is only reconfigured after its next read (cfg_stale) */
+static struct vl53l0x_profile_cfg cfg = PROFILE_CFG_DEFAULT;
+static uint8_t cfg_stale = 0; // A bit per sensor (vl53l0x_idx_e)
+static uint8_t poll_delay_ms[VL53L0X_IDX_COUNT];
+static vl53l0x_ranging_e ranging = VL53L0X_RANGING_SINGLE;
+static uint16_t period_ms_timed = 0;
+static bool measuring = false;
+// Set by the interrupt of the front sensor (reads/writes are atomic on MSP430)
+static volatile bool front_ready = false;
 static bool initialized = false;
 
 /* We can read the model id to confirm that the device is booted.
@@ -102,14 +185,9 @@ static vl53l0x_result_e device_is_booted(void)
                                                      : VL53L0X_RESULT_ERROR_BOOT;
 }
 
-static vl53l0x_result_e vl53l0x_write_8regs(const struct i2c_8reg *regs, uint8_t cnt)
+static vl53l0x_result_e vl53l0x_run_script(const struct i2c_script *script, uint8_t *vars)
 {
-    for (uint8_t i = 0; i < cnt; i++) {
-        if (i2c_write_addr8_data8(regs[i].addr, regs[i].data)) {
-            return VL53L0X_RESULT_ERROR_I2C;
-        }
-    }
-    return VL53L0X_RESULT_OK;
+    return i2c_script_run(script, vars) ? VL53L0X_RESULT_ERROR_I2C : VL53L0X_RESULT_OK;
 }
 
 // One time device initialization
@@ -125,49 +203,22 @@ static vl53l0x_result_e vl53l0x_data_init(void)
         return VL53L0X_RESULT_ERROR_I2C;
     }
 
-    // Set I2C standard mode
-    if (i2c_write_addr8_data8(0x88, 0x00)) {
-        return VL53L0X_RESULT_ERROR_I2C;
-    }
-
-    // Set various registers (same as ST reference code)
-    const struct i2c_8reg data_regs1[] = { { 0x80, 0x01 }, { 0xFF, 0x01 }, { 0x00, 0x00 } };
-    vl53l0x_result_e result = vl53l0x_write_8regs(data_regs1, ARRAY_SIZE(data_regs1));
-    if (result) {
-        return result;
-    }
-
-    // TODO: It may be unnecessary to retrieve the stop variable for each sensor
-    if (i2c_read_addr8_data8(0x91, &stop_variable)) {
-        return VL53L0X_RESULT_ERROR_I2C;
-    }
-
-    // Set various registers (same as ST reference code)
-    const struct i2c_8reg data_regs2[] = { { 0x00, 0x01 }, { 0xFF, 0x00 }, { 0x80, 0x00 } };
-    result = vl53l0x_write_8regs(data_regs2, ARRAY_SIZE(data_regs2));
-
-    return result;
+    /* Set I2C standard mode, and various registers (same as ST reference code)
+     * TODO: It may be unnecessary to retrieve the stop variable for each sensor */
+    I2C_SCRIPT(data_init_script, I2C_SCRIPT_WRITE(0x88, 0x00), I2C_SCRIPT_WRITE(0x80, 0x01),
+               I2C_SCRIPT_WRITE(0xFF, 0x01), I2C_SCRIPT_WRITE(0x00, 0x00),
+               I2C_SCRIPT_READ(0x91, 1, 0), I2C_SCRIPT_WRITE(0x00, 0x01),
+               I2C_SCRIPT_WRITE(0xFF, 0x00), I2C_SCRIPT_WRITE(0x80, 0x00));
+    return vl53l0x_run_script(&data_init_script, &stop_variable);
 }
 
 /* Wait for strobe value to be set. This is used when we read values
  * from NVM (non volatile memory). */
 static vl53l0x_result_e vl53l0x_read_strobe(void)
 {
-    uint8_t strobe = 0;
-    if (i2c_write_addr8_data8(0x83, 0x00)) {
-        return VL53L0X_RESULT_ERROR_I2C;
-    }
-    i2c_result_e result = I2C_RESULT_OK;
-    do {
-        result = i2c_read_addr8_data8(0x83, &strobe);
-    } while (result == I2C_RESULT_OK && (strobe == 0));
-    if (result) {
-        return VL53L0X_RESULT_ERROR_I2C;
-    }
-    if (i2c_write_addr8_data8(0x83, 0x01)) {
-        return VL53L0X_RESULT_ERROR_I2C;
-    }
-    return VL53L0X_RESULT_OK;
+    I2C_SCRIPT(strobe_script, I2C_SCRIPT_WRITE(0x83, 0x00), I2C_SCRIPT_READ_UNTIL_SET(0x83, 0xFF),
+               I2C_SCRIPT_WRITE(0x83, 0x01));
+    return vl53l0x_run_script(&strobe_script, NULL);
 }
 
 /**
@@ -189,12 +240,14 @@ static vl53l0x_result_e vl53l0x_get_spad_info_from_nvm(uint8_t *spad_count, uint
     uint8_t tmp_data8 = 0;
     uint32_t tmp_data32 = 0;
 
-    const struct i2c_8reg nvm_setup_regs[] = { { 0x80, 0x01 }, { 0xFF, 0x01 }, { 0x00, 0x00 },
-                                               { 0xFF, 0x06 }, { 0xFF, 0x07 }, { 0x81, 0x01 },
-                                               { 0x80, 0x01 } };
+    I2C_SCRIPT(nvm_setup_script1, I2C_SCRIPT_WRITE(0x80, 0x01), I2C_SCRIPT_WRITE(0xFF, 0x01),
+               I2C_SCRIPT_WRITE(0x00, 0x00), I2C_SCRIPT_WRITE(0xFF, 0x06));
+    // Get the SPAD count and type (0x94)
+    I2C_SCRIPT(nvm_setup_script2, I2C_SCRIPT_WRITE(0xFF, 0x07), I2C_SCRIPT_WRITE(0x81, 0x01),
+               I2C_SCRIPT_WRITE(0x80, 0x01), I2C_SCRIPT_WRITE(0x94, 0x6b));
 
     // Setup to read from NVM
-    vl53l0x_result_e result = vl53l0x_write_8regs(nvm_setup_regs, 4);
+    vl53l0x_result_e result = vl53l0x_run_script(&nvm_setup_script1, NULL);
     if (result) {
         return result;
     }
@@ -204,15 +257,10 @@ static vl53l0x_result_e vl53l0x_get_spad_info_from_nvm(uint8_t *spad_count, uint
     if (i2c_write_addr8_data8(0x83, tmp_data8 | 0x04)) {
         return VL53L0X_RESULT_ERROR_I2C;
     }
-    result = vl53l0x_write_8regs(nvm_setup_regs + 4, ARRAY_SIZE(nvm_setup_regs) - 4);
+    result = vl53l0x_run_script(&nvm_setup_script2, NULL);
     if (result) {
         return result;
     }
-
-    // Get the SPAD count and type
-    if (i2c_write_addr8_data8(0x94, 0x6b)) {
-        return VL53L0X_RESULT_ERROR_I2C;
-    }
     result = vl53l0x_read_strobe();
     if (result) {
         return result;
@@ -255,11 +303,12 @@ static vl53l0x_result_e vl53l0x_get_spad_info_from_nvm(uint8_t *spad_count, uint
     good_spad_map[5] = (uint8_t)((tmp_data32 >> 16) & 0xFF);
 
 #endif
-    const struct i2c_8reg nvm_restore_regs[] = { { 0x81, 0x00 }, { 0xFF, 0x06 }, { 0xFF, 0x01 },
-                                                 { 0x00, 0x01 }, { 0xFF, 0x00 }, { 0x80, 0x00 } };
+    I2C_SCRIPT(nvm_restore_script1, I2C_SCRIPT_WRITE(0x81, 0x00), I2C_SCRIPT_WRITE(0xFF, 0x06));
+    I2C_SCRIPT(nvm_restore_script2, I2C_SCRIPT_WRITE(0xFF, 0x01), I2C_SCRIPT_WRITE(0x00, 0x01),
+               I2C_SCRIPT_WRITE(0xFF, 0x00), I2C_SCRIPT_WRITE(0x80, 0x00));
 
     // Restore after reading from NVM
-    result = vl53l0x_write_8regs(nvm_restore_regs, 2);
+    result = vl53l0x_run_script(&nvm_restore_script1, NULL);
     if (result) {
         return result;
     }
@@ -269,7 +318,7 @@ static vl53l0x_result_e vl53l0x_get_spad_info_from_nvm(uint8_t *spad_count, uint
     if (i2c_write_addr8_data8(0x83, tmp_data8 & 0xfb)) {
         return VL53L0X_RESULT_ERROR_I2C;
     }
-    result = vl53l0x_write_8regs(nvm_restore_regs + 2, ARRAY_SIZE(nvm_restore_regs) - 2);
+    result = vl53l0x_run_script(&nvm_restore_script2, NULL);
     if (result) {
         return result;
     }
@@ -301,13 +350,11 @@ static vl53l0x_result_e vl53l0x_set_spads_from_nvm(void)
         return result;
     }
 
-    const struct i2c_8reg spad_regs[] = { { 0xFF, 0x01 },
-                                          { REG_DYNAMIC_SPAD_REF_EN_START_OFFSET, 0x00 },
-                                          { REG_DYNAMIC_SPAD_NUM_REQUESTED_REF_SPAD, 0x2C },
-                                          { 0xFF, 0x00 },
-                                          { REG_GLOBAL_CONFIG_REF_EN_START_SELECT,
-                                            SPAD_START_SELECT } };
-    result = vl53l0x_write_8regs(spad_regs, ARRAY_SIZE(spad_regs));
+    I2C_SCRIPT(spad_script, I2C_SCRIPT_WRITE(0xFF, 0x01),
+               I2C_SCRIPT_WRITE_BURST(REG_DYNAMIC_SPAD_NUM_REQUESTED_REF_SPAD, 0x2C, 0x00),
+               I2C_SCRIPT_WRITE(0xFF, 0x00),
+               I2C_SCRIPT_WRITE(REG_GLOBAL_CONFIG_REF_EN_START_SELECT, SPAD_START_SELECT));
+    result = vl53l0x_run_script(&spad_script, NULL);
     if (result) {
         return result;
     }
@@ -357,25 +404,38 @@ static vl53l0x_result_e vl53l0x_set_spads_from_nvm(void)
 // Load tuning settings (same as default tuning settings provided by ST api code)
 static vl53l0x_result_e vl53l0x_load_default_tuning_settings(void)
 {
-    const struct i2c_8reg default_tuning_regs[] = {
-        { 0xFF, 0x01 }, { 0x00, 0x00 }, { 0xFF, 0x00 }, { 0x09, 0x00 }, { 0x10, 0x00 },
-        { 0x11, 0x00 }, { 0x24, 0x01 }, { 0x25, 0xFF }, { 0x75, 0x00 }, { 0xFF, 0x01 },
-        { 0x4E, 0x2C }, { 0x48, 0x00 }, { 0x30, 0x20 }, { 0xFF, 0x00 }, { 0x30, 0x09 },
-        { 0x54, 0x00 }, { 0x31, 0x04 }, { 0x32, 0x03 }, { 0x40, 0x83 }, { 0x46, 0x25 },
-        { 0x60, 0x00 }, { 0x27, 0x00 }, { 0x50, 0x06 }, { 0x51, 0x00 }, { 0x52, 0x96 },
-        { 0x56, 0x08 }, { 0x57, 0x30 }, { 0x61, 0x00 }, { 0x62, 0x00 }, { 0x64, 0x00 },
-        { 0x65, 0x00 }, { 0x66, 0xA0 }, { 0xFF, 0x01 }, { 0x22, 0x32 }, { 0x47, 0x14 },
-        { 0x49, 0xFF }, { 0x4A, 0x00 }, { 0xFF, 0x00 }, { 0x7A, 0x0A }, { 0x7B, 0x00 },
-        { 0x78, 0x21 }, { 0xFF, 0x01 }, { 0x23, 0x34 }, { 0x42, 0x00 }, { 0x44, 0xFF },
-        { 0x45, 0x26 }, { 0x46, 0x05 }, { 0x40, 0x40 }, { 0x0E, 0x06 }, { 0x20, 0x1A },
-        { 0x43, 0x40 }, { 0xFF, 0x00 }, { 0x34, 0x03 }, { 0x35, 0x44 }, { 0xFF, 0x01 },
-        { 0x31, 0x04 }, { 0x4B, 0x09 }, { 0x4C, 0x05 }, { 0x4D, 0x04 }, { 0xFF, 0x00 },
-        { 0x44, 0x00 }, { 0x45, 0x20 }, { 0x47, 0x08 }, { 0x48, 0x28 }, { 0x67, 0x00 },
-        { 0x70, 0x04 }, { 0x71, 0x01 }, { 0x72, 0xFE }, { 0x76, 0x00 }, { 0x77, 0x00 },
-        { 0xFF, 0x01 }, { 0x0D, 0x01 }, { 0xFF, 0x00 }, { 0x80, 0x01 }, { 0x01, 0xF8 },
-        { 0xFF, 0x01 }, { 0x8E, 0x01 }, { 0x00, 0x01 }, { 0xFF, 0x00 }, { 0x80, 0x00 }
-    };
-    return vl53l0x_write_8regs(default_tuning_regs, ARRAY_SIZE(default_tuning_regs));
+    // Consecutive registers (within the same 0xFF page) are written in bursts
+    I2C_SCRIPT(default_tuning_script, I2C_SCRIPT_WRITE(0xFF, 0x01), I2C_SCRIPT_WRITE(0x00, 0x00),
+               I2C_SCRIPT_WRITE(0xFF, 0x00), I2C_SCRIPT_WRITE(0x09, 0x00),
+               I2C_SCRIPT_WRITE_BURST(0x10, 0x00, 0x00), I2C_SCRIPT_WRITE_BURST(0x24, 0x01, 0xFF),
+               I2C_SCRIPT_WRITE(0x75, 0x00), I2C_SCRIPT_WRITE(0xFF, 0x01),
+               I2C_SCRIPT_WRITE(0x4E, 0x2C), I2C_SCRIPT_WRITE(0x48, 0x00),
+               I2C_SCRIPT_WRITE(0x30, 0x20), I2C_SCRIPT_WRITE(0xFF, 0x00),
+               I2C_SCRIPT_WRITE(0x30, 0x09), I2C_SCRIPT_WRITE(0x54, 0x00),
+               I2C_SCRIPT_WRITE_BURST(0x31, 0x04, 0x03), I2C_SCRIPT_WRITE(0x40, 0x83),
+               I2C_SCRIPT_WRITE(0x46, 0x25), I2C_SCRIPT_WRITE(0x60, 0x00),
+               I2C_SCRIPT_WRITE(0x27, 0x00), I2C_SCRIPT_WRITE_BURST(0x50, 0x06, 0x00, 0x96),
+               I2C_SCRIPT_WRITE_BURST(0x56, 0x08, 0x30), I2C_SCRIPT_WRITE_BURST(0x61, 0x00, 0x00),
+               I2C_SCRIPT_WRITE_BURST(0x64, 0x00, 0x00, 0xA0), I2C_SCRIPT_WRITE(0xFF, 0x01),
+               I2C_SCRIPT_WRITE(0x22, 0x32), I2C_SCRIPT_WRITE(0x47, 0x14),
+               I2C_SCRIPT_WRITE_BURST(0x49, 0xFF, 0x00), I2C_SCRIPT_WRITE(0xFF, 0x00),
+               I2C_SCRIPT_WRITE_BURST(0x7A, 0x0A, 0x00), I2C_SCRIPT_WRITE(0x78, 0x21),
+               I2C_SCRIPT_WRITE(0xFF, 0x01), I2C_SCRIPT_WRITE(0x23, 0x34),
+               I2C_SCRIPT_WRITE(0x42, 0x00), I2C_SCRIPT_WRITE_BURST(0x44, 0xFF, 0x26, 0x05),
+               I2C_SCRIPT_WRITE(0x40, 0x40), I2C_SCRIPT_WRITE(0x0E, 0x06),
+               I2C_SCRIPT_WRITE(0x20, 0x1A), I2C_SCRIPT_WRITE(0x43, 0x40),
+               I2C_SCRIPT_WRITE(0xFF, 0x00), I2C_SCRIPT_WRITE_BURST(0x34, 0x03, 0x44),
+               I2C_SCRIPT_WRITE(0xFF, 0x01), I2C_SCRIPT_WRITE(0x31, 0x04),
+               I2C_SCRIPT_WRITE_BURST(0x4B, 0x09, 0x05, 0x04), I2C_SCRIPT_WRITE(0xFF, 0x00),
+               I2C_SCRIPT_WRITE_BURST(0x44, 0x00, 0x20), I2C_SCRIPT_WRITE_BURST(0x47, 0x08, 0x28),
+               I2C_SCRIPT_WRITE(0x67, 0x00), I2C_SCRIPT_WRITE_BURST(0x70, 0x04, 0x01, 0xFE),
+               I2C_SCRIPT_WRITE_BURST(0x76, 0x00, 0x00), I2C_SCRIPT_WRITE(0xFF, 0x01),
+               I2C_SCRIPT_WRITE(0x0D, 0x01), I2C_SCRIPT_WRITE(0xFF, 0x00),
+               I2C_SCRIPT_WRITE(0x80, 0x01), I2C_SCRIPT_WRITE(0x01, 0xF8),
+               I2C_SCRIPT_WRITE(0xFF, 0x01), I2C_SCRIPT_WRITE(0x8E, 0x01),
+               I2C_SCRIPT_WRITE(0x00, 0x01), I2C_SCRIPT_WRITE(0xFF, 0x00),
+               I2C_SCRIPT_WRITE(0x80, 0x00));
+    return vl53l0x_run_script(&default_tuning_script, NULL);
 }
 
 static vl53l0x_result_e vl53l0x_configure_interrupt(void)
@@ -403,7 +463,8 @@ static vl53l0x_result_e vl53l0x_configure_interrupt(void)
 
 static void front_measurement_done_isr()
 {
-    status_multiple = STATUS_MULTIPLE_DONE;
+    front_ready = true;
+    wakeup_post(WAKEUP_RANGE);
 }
 
 static void vl53l0x_configure_front_sensor_interrupt(void)
@@ -450,49 +511,32 @@ static vl53l0x_result_e vl53l0x_static_init(void)
         return result;
     }
 
-    result = vl53l0x_set_sequence_steps_enabled(
-        RANGE_SEQUENCE_STEP_DSS + RANGE_SEQUENCE_STEP_PRE_RANGE + RANGE_SEQUENCE_STEP_FINAL_RANGE);
+    result = vl53l0x_set_sequence_steps_enabled(RANGE_SEQUENCE_STEPS_ENABLED);
     return result;
 }
 
 static vl53l0x_result_e
 vl53l0x_perform_single_ref_calibration(vl53l0x_calibration_type_e calib_type)
 {
-    uint8_t sysrange_start = 0;
-    uint8_t sequence_config = 0;
+    // Start, wait for interrupt, clear interrupt, stop
+    I2C_SCRIPT(ref_calibration_script, I2C_SCRIPT_WRITE_VAR(REG_SYSTEM_SEQUENCE_CONFIG, 0),
+               I2C_SCRIPT_WRITE_VAR(REG_SYSRANGE_START, 1),
+               I2C_SCRIPT_READ_UNTIL_SET(REG_RESULT_INTERRUPT_STATUS, 0x07),
+               I2C_SCRIPT_WRITE(REG_SYSTEM_INTERRUPT_CLEAR, 0x01),
+               I2C_SCRIPT_WRITE(REG_SYSRANGE_START, 0x00));
+    // sequence config, sysrange start
+    uint8_t vars[2] = { 0 };
     switch (calib_type) {
     case VL53L0X_CALIBRATION_TYPE_VHV:
-        sequence_config = 0x01;
-        sysrange_start = 0x01 | 0x40;
+        vars[0] = 0x01;
+        vars[1] = 0x01 | 0x40;
         break;
     case VL53L0X_CALIBRATION_TYPE_PHASE:
-        sequence_config = 0x02;
-        sysrange_start = 0x01 | 0x00;
+        vars[0] = 0x02;
+        vars[1] = 0x01 | 0x00;
         break;
     }
-    if (i2c_write_addr8_data8(REG_SYSTEM_SEQUENCE_CONFIG, sequence_config)) {
-        return VL53L0X_RESULT_ERROR_I2C;
-    }
-    if (i2c_write_addr8_data8(REG_SYSRANGE_START, sysrange_start)) {
-        return VL53L0X_RESULT_ERROR_I2C;
-    }
-    // Wait for interrupt
-    uint8_t interrupt_status = 0;
-    i2c_result_e i2c_result = I2C_RESULT_OK;
-    do {
-        i2c_result = i2c_read_addr8_data8(REG_RESULT_INTERRUPT_STATUS, &interrupt_status);
-    } while (i2c_result == I2C_RESULT_OK && ((interrupt_status & 0x07) == 0));
-    if (i2c_result) {
-        return VL53L0X_RESULT_ERROR_I2C;
-    }
-    if (i2c_write_addr8_data8(REG_SYSTEM_INTERRUPT_CLEAR, 0x01)) {
-        return VL53L0X_RESULT_ERROR_I2C;
-    }
-
-    if (i2c_write_addr8_data8(REG_SYSRANGE_START, 0x00)) {
-        return VL53L0X_RESULT_ERROR_I2C;
-    }
-    return VL53L0X_RESULT_OK;
+    return vl53l0x_run_script(&ref_calibration_script, vars);
 }
 
 /* Temperature calibration needs to be run again if the temperature changes by
@@ -508,11 +552,222 @@ static vl53l0x_result_e vl53l0x_perform_ref_calibration(void)
         return result;
     }
     // Restore sequence steps enabled
-    result = vl53l0x_set_sequence_steps_enabled(
-        RANGE_SEQUENCE_STEP_DSS + RANGE_SEQUENCE_STEP_PRE_RANGE + RANGE_SEQUENCE_STEP_FINAL_RANGE);
+    result = vl53l0x_set_sequence_steps_enabled(RANGE_SEQUENCE_STEPS_ENABLED);
     return result;
 }
 
+// Timeouts of the steps of a measurement, see vl53l0x_cfg_to_vars
+struct sequence_timeouts
+{
+    uint8_t steps; // RANGE_SEQUENCE_STEP_*
+    uint8_t pre_range_vcsel_period;
+    uint8_t final_range_vcsel_period;
+    uint32_t pre_range_mclks;
+    uint32_t msrc_dss_tcc_us;
+    uint32_t pre_range_us;
+    uint32_t final_range_us;
+};
+
+// Timeouts are stored as (LSB * 2 ^ MSB + 1) in MCLKs (macro periods)
+static uint32_t timeout_decode(uint16_t reg)
+{
+    return ((uint32_t)(reg & 0xFF) << (reg >> 8)) + 1;
+}
+
+static uint16_t timeout_encode(uint32_t mclks)
+{
+    uint32_t lsb = mclks - 1;
+    uint16_t msb = 0;
+    while (lsb & 0xFFFFFF00) {
+        lsb >>= 1;
+        msb++;
+    }
+    return (msb << 8) | (lsb & 0xFF);
+}
+
+static uint32_t macro_period_ns(uint8_t vcsel_period)
+{
+    return ((2304ul * vcsel_period * 1655ul) + 500) / 1000;
+}
+
+static uint32_t timeout_mclks_to_us(uint32_t mclks, uint8_t vcsel_period)
+{
+    const uint32_t period_ns = macro_period_ns(vcsel_period);
+    return ((mclks * period_ns) + (period_ns / 2)) / 1000;
+}
+
+static uint32_t timeout_us_to_mclks(uint32_t us, uint8_t vcsel_period)
+{
+    const uint32_t period_ns = macro_period_ns(vcsel_period);
+    return ((us * 1000) + (period_ns / 2)) / period_ns;
+}
+
+static vl53l0x_result_e vl53l0x_get_sequence_timeouts(struct sequence_timeouts *timeouts)
+{
+    /* vars: sequence config, pre range vcsel period, msrc timeout, pre range timeout (2),
+     * final range vcsel period, final range timeout (2) */
+    I2C_SCRIPT(get_timeouts_script, I2C_SCRIPT_READ(REG_SYSTEM_SEQUENCE_CONFIG, 1, 0),
+               I2C_SCRIPT_READ(REG_PRE_RANGE_CONFIG_VCSEL_PERIOD, 1, 1),
+               I2C_SCRIPT_READ(REG_MSRC_CONFIG_TIMEOUT_MACROP, 1, 2),
+               I2C_SCRIPT_READ(REG_PRE_RANGE_CONFIG_TIMEOUT_MACROP_HI, 2, 3),
+               I2C_SCRIPT_READ(REG_FINAL_RANGE_CONFIG_VCSEL_PERIOD, 1, 5),
+               I2C_SCRIPT_READ(REG_FINAL_RANGE_CONFIG_TIMEOUT_MACROP_HI, 2, 6));
+    uint8_t vars[8] = { 0 };
+    const vl53l0x_result_e result = vl53l0x_run_script(&get_timeouts_script, vars);
+    if (result) {
+        return result;
+    }
+    timeouts->steps = vars[0];
+    timeouts->pre_range_vcsel_period = VCSEL_PERIOD_DECODE(vars[1]);
+    timeouts->msrc_dss_tcc_us =
+        timeout_mclks_to_us(vars[2] + 1u, timeouts->pre_range_vcsel_period);
+    timeouts->pre_range_mclks = timeout_decode(vars[3] | (vars[4] << 8));
+    timeouts->pre_range_us =
+        timeout_mclks_to_us(timeouts->pre_range_mclks, timeouts->pre_range_vcsel_period);
+    timeouts->final_range_vcsel_period = VCSEL_PERIOD_DECODE(vars[5]);
+    uint32_t final_range_mclks = timeout_decode(vars[6] | (vars[7] << 8));
+    // The final range timeout includes the pre range timeout
+    if (timeouts->steps & RANGE_SEQUENCE_STEP_PRE_RANGE) {
+        final_range_mclks -= timeouts->pre_range_mclks;
+    }
+    timeouts->final_range_us =
+        timeout_mclks_to_us(final_range_mclks, timeouts->final_range_vcsel_period);
+    return VL53L0X_RESULT_OK;
+}
+
+// Read once at init, so the configurations can be computed without reading the sensors
+static struct sequence_timeouts default_timeouts;
+
+// The run-time values of apply_cfg_script
+enum {
+    CFG_VAR_SIGNAL_RATE_HI,
+    CFG_VAR_SIGNAL_RATE_LO,
+    CFG_VAR_PRE_RANGE_VALID_PHASE_HIGH,
+    CFG_VAR_PRE_RANGE_VCSEL_PERIOD,
+    CFG_VAR_PRE_RANGE_TIMEOUT_HI,
+    CFG_VAR_PRE_RANGE_TIMEOUT_LO,
+    CFG_VAR_MSRC_TIMEOUT,
+    CFG_VAR_FINAL_RANGE_VALID_PHASE_HIGH,
+    CFG_VAR_VCSEL_WIDTH,
+    CFG_VAR_PHASECAL_TIMEOUT,
+    CFG_VAR_PHASECAL_LIM,
+    CFG_VAR_FINAL_RANGE_VCSEL_PERIOD,
+    CFG_VAR_FINAL_RANGE_TIMEOUT_HI,
+    CFG_VAR_FINAL_RANGE_TIMEOUT_LO,
+    CFG_VAR_COUNT
+};
+
+/* Writes a configuration (see vl53l0x_cfg_to_vars) and redoes the phase calibration (one
+ * short measurement), which depends on the VCSEL periods. The 16-bit registers are written
+ * a byte at a time (high byte first). The sensor must not be measuring. */
+I2C_SCRIPT(apply_cfg_script,
+           I2C_SCRIPT_WRITE_VAR(REG_FINAL_RANGE_CONFIG_MIN_COUNT_RATE_RTN_LIMIT,
+                                CFG_VAR_SIGNAL_RATE_HI),
+           I2C_SCRIPT_WRITE_VAR(REG_FINAL_RANGE_CONFIG_MIN_COUNT_RATE_RTN_LIMIT + 1,
+                                CFG_VAR_SIGNAL_RATE_LO),
+           I2C_SCRIPT_WRITE_VAR(REG_PRE_RANGE_CONFIG_VALID_PHASE_HIGH,
+                                CFG_VAR_PRE_RANGE_VALID_PHASE_HIGH),
+           I2C_SCRIPT_WRITE(REG_PRE_RANGE_CONFIG_VALID_PHASE_LOW, 0x08),
+           I2C_SCRIPT_WRITE_VAR(REG_PRE_RANGE_CONFIG_VCSEL_PERIOD, CFG_VAR_PRE_RANGE_VCSEL_PERIOD),
+           I2C_SCRIPT_WRITE_VAR(REG_PRE_RANGE_CONFIG_TIMEOUT_MACROP_HI,
+                                CFG_VAR_PRE_RANGE_TIMEOUT_HI),
+           I2C_SCRIPT_WRITE_VAR(REG_PRE_RANGE_CONFIG_TIMEOUT_MACROP_HI + 1,
+                                CFG_VAR_PRE_RANGE_TIMEOUT_LO),
+           I2C_SCRIPT_WRITE_VAR(REG_MSRC_CONFIG_TIMEOUT_MACROP, CFG_VAR_MSRC_TIMEOUT),
+           I2C_SCRIPT_WRITE_VAR(REG_FINAL_RANGE_CONFIG_VALID_PHASE_HIGH,
+                                CFG_VAR_FINAL_RANGE_VALID_PHASE_HIGH),
+           I2C_SCRIPT_WRITE(REG_FINAL_RANGE_CONFIG_VALID_PHASE_LOW, 0x08),
+           I2C_SCRIPT_WRITE_VAR(REG_GLOBAL_CONFIG_VCSEL_WIDTH, CFG_VAR_VCSEL_WIDTH),
+           I2C_SCRIPT_WRITE_VAR(REG_ALGO_PHASECAL_CONFIG_TIMEOUT, CFG_VAR_PHASECAL_TIMEOUT),
+           I2C_SCRIPT_WRITE(0xFF, 0x01),
+           I2C_SCRIPT_WRITE_VAR(REG_ALGO_PHASECAL_LIM, CFG_VAR_PHASECAL_LIM),
+           I2C_SCRIPT_WRITE(0xFF, 0x00),
+           I2C_SCRIPT_WRITE_VAR(REG_FINAL_RANGE_CONFIG_VCSEL_PERIOD,
+                                CFG_VAR_FINAL_RANGE_VCSEL_PERIOD),
+           I2C_SCRIPT_WRITE_VAR(REG_FINAL_RANGE_CONFIG_TIMEOUT_MACROP_HI,
+                                CFG_VAR_FINAL_RANGE_TIMEOUT_HI),
+           I2C_SCRIPT_WRITE_VAR(REG_FINAL_RANGE_CONFIG_TIMEOUT_MACROP_HI + 1,
+                                CFG_VAR_FINAL_RANGE_TIMEOUT_LO),
+           // Phase calibration, see vl53l0x_perform_single_ref_calibration
+           I2C_SCRIPT_WRITE(REG_SYSTEM_SEQUENCE_CONFIG, 0x02),
+           I2C_SCRIPT_WRITE(REG_SYSRANGE_START, 0x01),
+           I2C_SCRIPT_READ_UNTIL_SET(REG_RESULT_INTERRUPT_STATUS, 0x07),
+           I2C_SCRIPT_WRITE(REG_SYSTEM_INTERRUPT_CLEAR, 0x01),
+           I2C_SCRIPT_WRITE(REG_SYSRANGE_START, 0x00),
+           I2C_SCRIPT_WRITE(REG_SYSTEM_SEQUENCE_CONFIG, RANGE_SEQUENCE_STEPS_ENABLED));
+
+/* Computes the registers of a configuration like the ST API does: the step timeouts are
+ * kept in microseconds and converted to the VCSEL periods, and the final range step gets
+ * what's left of the timing budget after the other steps. Computed from the timeouts at
+ * init rather than read back from the sensor, so it doesn't touch the bus. */
+static vl53l0x_result_e vl53l0x_cfg_to_vars(const struct vl53l0x_profile_cfg *new_cfg,
+                                            uint8_t vars[CFG_VAR_COUNT])
+{
+    const uint8_t pre_period = new_cfg->pre_range_vcsel_period;
+    const uint8_t final_period = new_cfg->final_range_vcsel_period;
+    ASSERT(pre_period >= 12 && pre_period <= 18 && !(pre_period & 1));
+    ASSERT(final_period >= 8 && final_period <= 14 && !(final_period & 1));
+    const struct sequence_timeouts *timeouts = &default_timeouts;
+
+    const uint16_t pre_range_reg =
+        timeout_encode(timeout_us_to_mclks(timeouts->pre_range_us, pre_period));
+    const uint32_t pre_range_mclks = timeout_decode(pre_range_reg);
+    const uint32_t msrc_mclks = timeout_us_to_mclks(timeouts->msrc_dss_tcc_us, pre_period);
+    const uint8_t msrc_reg = msrc_mclks > 256 ? 255 : msrc_mclks - 1;
+
+    // What the steps take with the converted (rounded) timeouts
+    const uint32_t msrc_dss_tcc_us = timeout_mclks_to_us(msrc_reg + 1u, pre_period);
+    uint32_t used_us = TIMING_OVERHEAD_START_us + TIMING_OVERHEAD_END_us;
+    if (timeouts->steps & RANGE_SEQUENCE_STEP_TCC) {
+        used_us += msrc_dss_tcc_us + TIMING_OVERHEAD_TCC_us;
+    }
+    if (timeouts->steps & RANGE_SEQUENCE_STEP_DSS) {
+        used_us += 2 * (msrc_dss_tcc_us + TIMING_OVERHEAD_DSS_us);
+    } else if (timeouts->steps & RANGE_SEQUENCE_STEP_MSRC) {
+        used_us += msrc_dss_tcc_us + TIMING_OVERHEAD_MSRC_us;
+    }
+    if (timeouts->steps & RANGE_SEQUENCE_STEP_PRE_RANGE) {
+        used_us += timeout_mclks_to_us(pre_range_mclks, pre_period) + TIMING_OVERHEAD_PRE_RANGE_us;
+    }
+    // The final range step is always enabled (see vl53l0x_static_init)
+    used_us += TIMING_OVERHEAD_FINAL_RANGE_us;
+    if (used_us > new_cfg->timing_budget_us) {
+        return VL53L0X_RESULT_ERROR_TIMING_BUDGET;
+    }
+    uint32_t final_range_mclks =
+        timeout_us_to_mclks(new_cfg->timing_budget_us - used_us, final_period);
+    // The final range timeout includes the pre range timeout
+    if (timeouts->steps & RANGE_SEQUENCE_STEP_PRE_RANGE) {
+        final_range_mclks += pre_range_mclks;
+    }
+    const uint16_t final_range_reg = timeout_encode(final_range_mclks);
+
+    static const uint8_t pre_range_valid_phase_high[] = { 0x18, 0x30, 0x40, 0x50 };
+    // valid phase high, vcsel width, phasecal timeout, phasecal limit
+    static const uint8_t final_range_cfgs[][4] = {
+        { 0x10, 0x02, 0x0C, 0x30 },
+        { 0x28, 0x03, 0x09, 0x20 },
+        { 0x38, 0x03, 0x08, 0x20 },
+        { 0x48, 0x03, 0x07, 0x20 },
+    };
+    const uint8_t *final_range_cfg = final_range_cfgs[(final_period - 8) / 2];
+    vars[CFG_VAR_SIGNAL_RATE_HI] = new_cfg->signal_rate_limit >> 8;
+    vars[CFG_VAR_SIGNAL_RATE_LO] = new_cfg->signal_rate_limit & 0xFF;
+    vars[CFG_VAR_PRE_RANGE_VALID_PHASE_HIGH] = pre_range_valid_phase_high[(pre_period - 12) / 2];
+    vars[CFG_VAR_PRE_RANGE_VCSEL_PERIOD] = VCSEL_PERIOD_ENCODE(pre_period);
+    vars[CFG_VAR_PRE_RANGE_TIMEOUT_HI] = pre_range_reg >> 8;
+    vars[CFG_VAR_PRE_RANGE_TIMEOUT_LO] = pre_range_reg & 0xFF;
+    vars[CFG_VAR_MSRC_TIMEOUT] = msrc_reg;
+    vars[CFG_VAR_FINAL_RANGE_VALID_PHASE_HIGH] = final_range_cfg[0];
+    vars[CFG_VAR_VCSEL_WIDTH] = final_range_cfg[1];
+    vars[CFG_VAR_PHASECAL_TIMEOUT] = final_range_cfg[2];
+    vars[CFG_VAR_PHASECAL_LIM] = final_range_cfg[3];
+    vars[CFG_VAR_FINAL_RANGE_VCSEL_PERIOD] = VCSEL_PERIOD_ENCODE(final_period);
+    vars[CFG_VAR_FINAL_RANGE_TIMEOUT_HI] = final_range_reg >> 8;
+    vars[CFG_VAR_FINAL_RANGE_TIMEOUT_LO] = final_range_reg & 0xFF;
+    return VL53L0X_RESULT_OK;
+}
+
 static vl53l0x_result_e vl53l0x_configure_address(uint8_t addr)
 {
     // 7-bit address
@@ -630,108 +885,282 @@ static vl53l0x_result_e vl53l0x_init_config(vl53l0x_idx_e idx)
     return VL53L0X_RESULT_OK;
 }
 
+/* Run for every measurement on every sensor, so these are the scripts that limit the
+ * ranging rate (see vl53l0x_trace_script_stats) */
+I2C_SCRIPT(start_sysrange_script, I2C_SCRIPT_WRITE(0x80, 0x01), I2C_SCRIPT_WRITE(0xFF, 0x01),
+           I2C_SCRIPT_WRITE(0x00, 0x00), I2C_SCRIPT_WRITE_VAR(0x91, 0),
+           I2C_SCRIPT_WRITE(0x00, 0x01), I2C_SCRIPT_WRITE(0xFF, 0x00), I2C_SCRIPT_WRITE(0x80, 0x00),
+           I2C_SCRIPT_WRITE(REG_SYSRANGE_START, 0x01),
+           I2C_SCRIPT_READ_UNTIL_CLEAR(REG_SYSRANGE_START, 0x01));
+// Wait for the measurement, read it, and clear the interrupt
+I2C_SCRIPT(read_range_script, I2C_SCRIPT_READ_UNTIL_SET(REG_RESULT_INTERRUPT_STATUS, 0x07),
+           I2C_SCRIPT_READ(REG_RESULT_RANGE_STATUS + 10, 2, 0),
+           I2C_SCRIPT_WRITE(REG_SYSTEM_INTERRUPT_CLEAR, 0x01));
+
 static vl53l0x_result_e vl53l0x_start_sysrange(vl53l0x_idx_e idx)
 {
     i2c_set_slave_address(vl53l0x_cfgs[idx].addr);
-    const struct i2c_8reg sysrange_regs[] = { { 0x80, 0x01 }, { 0xFF, 0x01 }, { 0x00, 0x00 },
-                                              { 0x00, 0x01 }, { 0xFF, 0x00 }, { 0x80, 0x00 } };
-    vl53l0x_result_e result = vl53l0x_write_8regs(sysrange_regs, 3);
-    if (result) {
-        return result;
-    }
-    if (i2c_write_addr8_data8(0x91, stop_variable)) {
-        return VL53L0X_RESULT_ERROR_I2C;
-    }
-    result = vl53l0x_write_8regs(sysrange_regs + 3, ARRAY_SIZE(sysrange_regs) - 3);
+    return vl53l0x_run_script(&start_sysrange_script, &stop_variable);
+}
+
+static uint16_t vl53l0x_range_from_raw(uint16_t raw)
+{
+    // 8190 or 8191 may be returned when obstacle is out of range.
+    return (raw == 8190 || raw == 8191) ? VL53L0X_OUT_OF_RANGE : raw;
+}
+
+static vl53l0x_result_e vl53l0x_read_range(vl53l0x_idx_e idx, uint16_t *range)
+{
+    i2c_set_slave_address(vl53l0x_cfgs[idx].addr);
+    const vl53l0x_result_e result = vl53l0x_run_script(&read_range_script, (uint8_t *)range);
     if (result) {
         return result;
     }
+    *range = vl53l0x_range_from_raw(*range);
+    return VL53L0X_RESULT_OK;
+}
 
-    if (i2c_write_addr8_data8(REG_SYSRANGE_START, 0x01)) {
-        return VL53L0X_RESULT_ERROR_I2C;
-    }
+#ifndef DISABLE_TRACE
+static void trace_script_stats(const char *name, const struct i2c_script *script)
+{
+    const struct i2c_script_stats *stats = script->stats;
+    TRACE("%s: runs %u bytes %u cycles %lu bus polls %u", name, stats->runs, stats->bytes,
+          (unsigned long)stats->cycles, stats->bus_polls);
+}
 
-    uint8_t sysrange_start = 0;
-    i2c_result_e i2c_result = I2C_RESULT_OK;
-    do {
-        i2c_result = i2c_read_addr8_data8(REG_SYSRANGE_START, &sysrange_start);
-    } while (i2c_result == I2C_RESULT_OK && (sysrange_start & 0x01));
-    return i2c_result == I2C_RESULT_OK ? VL53L0X_RESULT_OK : VL53L0X_RESULT_ERROR_I2C;
+void vl53l0x_trace_script_stats(void)
+{
+    trace_script_stats("start", &start_sysrange_script);
+    trace_script_stats("read", &read_range_script);
 }
+#endif
 
-// Assumes I2C address is set already
-static vl53l0x_result_e vl53l0x_clear_sysrange_interrupt(void)
+vl53l0x_result_e vl53l0x_read_range_single(vl53l0x_idx_e idx, uint16_t *range)
 {
-    if (i2c_write_addr8_data8(REG_SYSTEM_INTERRUPT_CLEAR, 0x01)) {
-        return VL53L0X_RESULT_ERROR_I2C;
+    ASSERT(initialized);
+    ASSERT(ranging == VL53L0X_RANGING_SINGLE);
+    vl53l0x_result_e result = vl53l0x_start_sysrange(idx);
+    if (result) {
+        return result;
     }
-    return VL53L0X_RESULT_OK;
+    result = vl53l0x_read_range(idx, range);
+    return result;
 }
 
-// Assumes I2C address is set already
-static vl53l0x_result_e vl53l0x_pollwait_sysrange(void)
+/* Continuous ranging (same sequence as for a single measurement, but with another mode).
+ * vars: stop variable, mode */
+I2C_SCRIPT(start_continuous_script, I2C_SCRIPT_WRITE(0x80, 0x01), I2C_SCRIPT_WRITE(0xFF, 0x01),
+           I2C_SCRIPT_WRITE(0x00, 0x00), I2C_SCRIPT_WRITE_VAR(0x91, 0),
+           I2C_SCRIPT_WRITE(0x00, 0x01), I2C_SCRIPT_WRITE(0xFF, 0x00), I2C_SCRIPT_WRITE(0x80, 0x00),
+           I2C_SCRIPT_WRITE_VAR(REG_SYSRANGE_START, 1));
+/* Waits until the ongoing measurement has stopped (as the ST API's stop completed status,
+ * register 0x04 on page 0x01), so the sensor can be reconfigured right after */
+I2C_SCRIPT(stop_continuous_script, I2C_SCRIPT_WRITE(REG_SYSRANGE_START, SYSRANGE_MODE_SINGLESHOT),
+           I2C_SCRIPT_WRITE(0xFF, 0x01), I2C_SCRIPT_WRITE(0x00, 0x00), I2C_SCRIPT_WRITE(0x91, 0x00),
+           I2C_SCRIPT_WRITE(0x00, 0x01), I2C_SCRIPT_READ_UNTIL_CLEAR(0x04, 0xFF),
+           I2C_SCRIPT_WRITE(0xFF, 0x00), I2C_SCRIPT_WRITE(REG_SYSTEM_INTERRUPT_CLEAR, 0x01));
+// vars of start_continuous_script, kept for the background restarts (see vl53l0x_read_run)
+static uint8_t start_continuous_vars[2];
+
+static vl53l0x_result_e vl53l0x_start_continuous(vl53l0x_idx_e idx)
 {
-    i2c_result_e i2c_result = I2C_RESULT_OK;
-    uint8_t interrupt_status = 0;
-    do {
-        i2c_result = i2c_read_addr8_data8(REG_RESULT_INTERRUPT_STATUS, &interrupt_status);
-    } while (i2c_result == I2C_RESULT_OK && ((interrupt_status & 0x07) == 0));
-    return i2c_result == I2C_RESULT_OK ? VL53L0X_RESULT_OK : VL53L0X_RESULT_ERROR_I2C;
+    i2c_set_slave_address(vl53l0x_cfgs[idx].addr);
+    uint8_t mode = SYSRANGE_MODE_BACKTOBACK;
+    if (ranging == VL53L0X_RANGING_TIMED) {
+        // The period register is in internal oscillator ticks, if the sensor is calibrated
+        uint16_t osc_calibrate_val = 0;
+        if (i2c_read_addr8_data16(REG_OSC_CALIBRATE_VAL, &osc_calibrate_val)) {
+            return VL53L0X_RESULT_ERROR_I2C;
+        }
+        uint32_t period = period_ms_timed;
+        if (osc_calibrate_val != 0) {
+            period *= osc_calibrate_val;
+        }
+        const uint8_t addr = REG_SYSTEM_INTERMEASUREMENT_PERIOD;
+        const uint8_t period_bytes[] = { period >> 24, period >> 16, period >> 8, period };
+        if (i2c_write(&addr, 1, period_bytes, sizeof(period_bytes))) {
+            return VL53L0X_RESULT_ERROR_I2C;
+        }
+        mode = SYSRANGE_MODE_TIMED;
+    }
+    start_continuous_vars[0] = stop_variable;
+    start_continuous_vars[1] = mode;
+    return vl53l0x_run_script(&start_continuous_script, start_continuous_vars);
 }
 
-static bool vl53l0x_is_sysrange_done(vl53l0x_idx_e idx)
+static vl53l0x_result_e vl53l0x_stop_continuous(vl53l0x_idx_e idx)
 {
-#if defined(LAUNCHPAD)
-    if (idx != VL53L0X_IDX_FRONT) {
-        return true;
-    }
-#elif defined(NSUMO)
-    if (idx != VL53L0X_IDX_FRONT_LEFT && idx != VL53L0X_IDX_FRONT
-        && idx != VL53L0X_IDX_FRONT_RIGHT) {
-        return true;
-    }
-#endif
     i2c_set_slave_address(vl53l0x_cfgs[idx].addr);
-    uint8_t interrupt_status = 0;
-    const i2c_result_e i2c_result =
-        i2c_read_addr8_data8(REG_RESULT_INTERRUPT_STATUS, &interrupt_status);
-    return i2c_result == I2C_RESULT_OK && (interrupt_status & 0x07);
+    return vl53l0x_run_script(&stop_continuous_script, NULL);
 }
 
-static vl53l0x_result_e vl53l0x_read_range(vl53l0x_idx_e idx, uint16_t *range)
+static vl53l0x_ranges_t latest_ranges = {
+    { VL53L0X_OUT_OF_RANGE, 0, 0 }, { VL53L0X_OUT_OF_RANGE, 0, 0 },
+    { VL53L0X_OUT_OF_RANGE, 0, 0 }, { VL53L0X_OUT_OF_RANGE, 0, 0 },
+    { VL53L0X_OUT_OF_RANGE, 0, 0 },
+};
+// Lower 16 bits of millis, when to start polling a sensor without interrupt pin
+static uint16_t poll_time_ms[VL53L0X_IDX_COUNT];
+
+static void vl53l0x_delay_poll(vl53l0x_idx_e idx)
 {
-    i2c_set_slave_address(vl53l0x_cfgs[idx].addr);
+    poll_time_ms[idx] = (uint16_t)millis() + poll_delay_ms[idx];
+}
 
-    vl53l0x_result_e result = vl53l0x_pollwait_sysrange();
-    if (result) {
-        return result;
+/* The sensors without an interrupt pin are ready to be read once their measurement is about
+ * to finish, the read script then polls their status until it's done */
+static bool vl53l0x_is_measurement_ready(vl53l0x_idx_e idx)
+{
+    if (idx == VL53L0X_IDX_FRONT) {
+        return front_ready;
     }
+    return (int16_t)((uint16_t)millis() - poll_time_ms[idx]) >= 0;
+}
 
-    if (i2c_read_addr8_data16(REG_RESULT_RANGE_STATUS + 10, range)) {
-        return VL53L0X_RESULT_ERROR_I2C;
+typedef enum
+{
+    READ_PHASE_IDLE,
+    READ_PHASE_READ, // Reading the measurement of read_idx
+    READ_PHASE_STOP, // Stopping read_idx to reconfigure it (continuous ranging)
+    READ_PHASE_CONFIGURE, // Configuring read_idx with cfg (applying_vars)
+    READ_PHASE_START, // Starting the next measurement of read_idx (single ranging, or restart)
+} read_phase_e;
+
+// The script of vl53l0x_read_range_multiple that runs in the background (one at a time)
+static read_phase_e read_phase = READ_PHASE_IDLE;
+static vl53l0x_idx_e read_idx = VL53L0X_IDX_FRONT;
+static uint16_t read_raw_range = 0;
+// cfg as registers (see vl53l0x_cfg_to_vars), copied since cfg may change during the script
+static uint8_t cfg_vars[CFG_VAR_COUNT];
+static uint8_t applying_vars[CFG_VAR_COUNT];
+
+// (Re)starts the script of the current phase
+static void vl53l0x_read_run(void)
+{
+    const uint8_t addr = vl53l0x_cfgs[read_idx].addr;
+    switch (read_phase) {
+    case READ_PHASE_IDLE:
+        break;
+    case READ_PHASE_READ:
+        i2c_script_start(&read_range_script, addr, (uint8_t *)&read_raw_range);
+        break;
+    case READ_PHASE_STOP:
+        i2c_script_start(&stop_continuous_script, addr, NULL);
+        break;
+    case READ_PHASE_CONFIGURE:
+        i2c_script_start(&apply_cfg_script, addr, applying_vars);
+        break;
+    case READ_PHASE_START:
+        if (ranging == VL53L0X_RANGING_SINGLE) {
+            i2c_script_start(&start_sysrange_script, addr, &stop_variable);
+        } else {
+            // The inter-measurement period (timed ranging) is kept by the sensor
+            i2c_script_start(&start_continuous_script, addr, start_continuous_vars);
+        }
+        break;
     }
+}
 
-    if (i2c_write_addr8_data8(REG_SYSTEM_INTERRUPT_CLEAR, 0x01)) {
-        return VL53L0X_RESULT_ERROR_I2C;
+static void vl53l0x_read_next(read_phase_e phase)
+{
+    read_phase = phase;
+    if (phase == READ_PHASE_CONFIGURE) {
+        memcpy(applying_vars, cfg_vars, sizeof(applying_vars));
+        cfg_stale &= ~(1u << read_idx);
+        poll_delay_ms[read_idx] = POLL_DELAY_ms(cfg.timing_budget_us);
     }
+    vl53l0x_read_run();
+}
 
-    // 8190 or 8191 may be returned when obstacle is out of range.
-    if (*range == 8190 || *range == 8191) {
-        *range = VL53L0X_OUT_OF_RANGE;
+static void vl53l0x_read_start(vl53l0x_idx_e idx)
+{
+    if (idx == VL53L0X_IDX_FRONT) {
+        /* Reset before the interrupt of the sensor is cleared, or the edge of its next
+         * measurement may be lost when ranging continuously */
+        front_ready = false;
     }
+    read_idx = idx;
+    vl53l0x_read_next(READ_PHASE_READ);
+}
 
-    result = vl53l0x_clear_sysrange_interrupt();
-    return result;
+/* Moves the background script on if the current one is done, publishes the measurement once
+ * it has been read. Returns with read_phase still set if a script is running. */
+static vl53l0x_result_e vl53l0x_read_advance(bool *fresh_values)
+{
+    while (read_phase != READ_PHASE_IDLE) {
+        const i2c_result_e i2c_result = i2c_script_poll();
+        if (i2c_result == I2C_RESULT_PENDING) {
+            return VL53L0X_RESULT_OK;
+        }
+        if (i2c_result) {
+            /* Retry on the next call, the front sensor keeps its interrupt pending (no new
+             * edge) until it's read, and a sensor that was stopped or reconfigured only
+             * measures again once started */
+            switch (read_phase) {
+            case READ_PHASE_IDLE:
+                break;
+            case READ_PHASE_READ:
+                if (read_idx == VL53L0X_IDX_FRONT) {
+                    front_ready = true;
+                }
+                read_phase = READ_PHASE_IDLE;
+                break;
+            case READ_PHASE_STOP:
+            case READ_PHASE_CONFIGURE:
+            case READ_PHASE_START:
+                vl53l0x_read_run();
+                break;
+            }
+            return VL53L0X_RESULT_ERROR_I2C;
+        }
+        switch (read_phase) {
+        case READ_PHASE_IDLE:
+            break;
+        case READ_PHASE_READ: {
+            struct vl53l0x_range *range = &latest_ranges[read_idx];
+            range->range = vl53l0x_range_from_raw(read_raw_range);
+            range->time_ms = (uint16_t)millis();
+            range->seq++;
+            *fresh_values = true;
+            if (cfg_stale & (1u << read_idx)) {
+                // A single measurement has ended, a continuous one must be stopped
+                vl53l0x_read_next(ranging == VL53L0X_RANGING_SINGLE ? READ_PHASE_CONFIGURE
+                                                                    : READ_PHASE_STOP);
+                continue;
+            }
+            if (ranging == VL53L0X_RANGING_SINGLE) {
+                vl53l0x_read_next(READ_PHASE_START);
+                continue;
+            }
+            break;
+        }
+        case READ_PHASE_STOP:
+            vl53l0x_read_next(READ_PHASE_CONFIGURE);
+            continue;
+        case READ_PHASE_CONFIGURE:
+            if (read_idx == VL53L0X_IDX_FRONT) {
+                // Set by the measurement of the phase calibration
+                front_ready = false;
+            }
+            vl53l0x_read_next(READ_PHASE_START);
+            continue;
+        case READ_PHASE_START:
+            break;
+        }
+        vl53l0x_delay_poll(read_idx);
+        read_phase = READ_PHASE_IDLE;
+    }
+    return VL53L0X_RESULT_OK;
 }
 
-vl53l0x_result_e vl53l0x_read_range_single(vl53l0x_idx_e idx, uint16_t *range)
+// Waits for the background script, so the blocking functions can use the bus
+static vl53l0x_result_e vl53l0x_read_finish(void)
 {
-    ASSERT(initialized);
-    vl53l0x_result_e result = vl53l0x_start_sysrange(idx);
-    if (result) {
-        return result;
+    bool fresh_values = false;
+    vl53l0x_result_e result = VL53L0X_RESULT_OK;
+    while (!result && read_phase != READ_PHASE_IDLE) {
+        result = vl53l0x_read_advance(&fresh_values);
     }
-    result = vl53l0x_read_range(idx, range);
     return result;
 }
 
@@ -739,114 +1168,194 @@ vl53l0x_result_e vl53l0x_read_range_single(vl53l0x_idx_e idx, uint16_t *range)
 vl53l0x_result_e vl53l0x_start_measuring_multiple(void)
 {
     ASSERT(initialized);
-    if (status_multiple == STATUS_MULTIPLE_MEASURING) {
+    if (measuring) {
         return VL53L0X_RESULT_ERROR_MEASURE_ONGOING;
     }
-    status_multiple = STATUS_MULTIPLE_MEASURING;
-    vl53l0x_result_e result = vl53l0x_start_sysrange(VL53L0X_IDX_FRONT);
-    if (result) {
-        return result;
+    measuring = true;
+    for (uint8_t i = 0; i < ARRAY_SIZE(measured_idxs); i++) {
+        const vl53l0x_idx_e idx = measured_idxs[i];
+        const vl53l0x_result_e result = ranging == VL53L0X_RANGING_SINGLE
+            ? vl53l0x_start_sysrange(idx)
+            : vl53l0x_start_continuous(idx);
+        if (result) {
+            return result;
+        }
+        vl53l0x_delay_poll(idx);
     }
-#if defined(NSUMO)
-    result = vl53l0x_start_sysrange(VL53L0X_IDX_FRONT_LEFT);
-    if (result) {
-        return result;
+    return VL53L0X_RESULT_OK;
+}
+
+/* Configures the sensors left with an old configuration (blocking), the sensors must not be
+ * measuring. Sensors that aren't measured are only configured here. */
+static vl53l0x_result_e vl53l0x_configure_stale(void)
+{
+    for (uint8_t idx = 0; idx < ARRAY_SIZE(vl53l0x_cfgs); idx++) {
+        if (!(cfg_stale & (1u << idx))) {
+            continue;
+        }
+        i2c_set_slave_address(vl53l0x_cfgs[idx].addr);
+        const vl53l0x_result_e result = vl53l0x_run_script(&apply_cfg_script, cfg_vars);
+        if (result) {
+            return result;
+        }
+        if (idx == VL53L0X_IDX_FRONT) {
+            // Set by the measurement of the phase calibration
+            front_ready = false;
+        }
+        cfg_stale &= ~(1u << idx);
+        poll_delay_ms[idx] = POLL_DELAY_ms(cfg.timing_budget_us);
     }
-    result = vl53l0x_start_sysrange(VL53L0X_IDX_FRONT_RIGHT);
-    if (result) {
-        return result;
+    return VL53L0X_RESULT_OK;
+}
+
+// Stops measuring, so the sensors can be reconfigured
+static vl53l0x_result_e vl53l0x_stop_measuring_multiple(void)
+{
+    if (!measuring) {
+        return VL53L0X_RESULT_OK;
+    }
+    const vl53l0x_result_e read_result = vl53l0x_read_finish();
+    if (read_result) {
+        return read_result;
+    }
+    front_ready = false;
+    for (uint8_t i = 0; i < ARRAY_SIZE(measured_idxs); i++) {
+        const vl53l0x_idx_e idx = measured_idxs[i];
+        vl53l0x_result_e result = VL53L0X_RESULT_OK;
+        if (ranging == VL53L0X_RANGING_SINGLE) {
+            // Finish the ongoing measurement, so no interrupt is left pending
+            result = vl53l0x_read_range(idx, &latest_ranges[idx].range);
+        } else {
+            result = vl53l0x_stop_continuous(idx);
+        }
+        if (result) {
+            return result;
+        }
     }
-#endif
-#if 0 // Skip left and right, since they are are mounted badly
-    result = vl53l0x_start_sysrange(VL53L0X_IDX_LEFT);
+    measuring = false;
+    return vl53l0x_configure_stale();
+}
+
+vl53l0x_result_e vl53l0x_set_ranging(vl53l0x_ranging_e new_ranging, uint16_t period_ms)
+{
+    ASSERT(initialized);
+    ASSERT(new_ranging != VL53L0X_RANGING_TIMED || period_ms > 0);
+    const bool was_measuring = measuring;
+    const vl53l0x_result_e result = vl53l0x_stop_measuring_multiple();
     if (result) {
         return result;
     }
-    result = vl53l0x_start_sysrange(VL53L0X_IDX_RIGHT);
+    ranging = new_ranging;
+    period_ms_timed = period_ms;
+    return was_measuring ? vl53l0x_start_measuring_multiple() : VL53L0X_RESULT_OK;
+}
+
+/* Applies the configuration to all sensors. While measuring, this only requests it, and
+ * each sensor is reconfigured in the background after its next read (see
+ * vl53l0x_read_advance), so the caller isn't blocked for the ~10 ms per sensor it takes. */
+static vl53l0x_result_e vl53l0x_apply_cfg(const struct vl53l0x_profile_cfg *new_cfg)
+{
+    ASSERT(new_cfg->timing_budget_us >= TIMING_BUDGET_MIN_us);
+    if (new_cfg->timing_budget_us == cfg.timing_budget_us
+        && new_cfg->signal_rate_limit == cfg.signal_rate_limit
+        && new_cfg->pre_range_vcsel_period == cfg.pre_range_vcsel_period
+        && new_cfg->final_range_vcsel_period == cfg.final_range_vcsel_period) {
+        return VL53L0X_RESULT_OK;
+    }
+    uint8_t vars[CFG_VAR_COUNT];
+    const vl53l0x_result_e result = vl53l0x_cfg_to_vars(new_cfg, vars);
     if (result) {
         return result;
     }
-#endif
-    return VL53L0X_RESULT_OK;
+    memcpy(cfg_vars, vars, sizeof(cfg_vars));
+    cfg = *new_cfg;
+    cfg_stale = (1u << ARRAY_SIZE(vl53l0x_cfgs)) - 1;
+    return measuring ? VL53L0X_RESULT_OK : vl53l0x_configure_stale();
 }
 
-static vl53l0x_ranges_t latest_ranges = { VL53L0X_OUT_OF_RANGE, VL53L0X_OUT_OF_RANGE,
-                                          VL53L0X_OUT_OF_RANGE, VL53L0X_OUT_OF_RANGE,
-                                          VL53L0X_OUT_OF_RANGE };
+vl53l0x_result_e vl53l0x_set_timing_budget(uint32_t budget_us)
+{
+    ASSERT(initialized);
+    struct vl53l0x_profile_cfg new_cfg = cfg;
+    new_cfg.timing_budget_us = budget_us;
+    return vl53l0x_apply_cfg(&new_cfg);
+}
+
+vl53l0x_result_e vl53l0x_set_vcsel_period(vl53l0x_vcsel_period_e type, uint8_t period)
+{
+    ASSERT(initialized);
+    struct vl53l0x_profile_cfg new_cfg = cfg;
+    switch (type) {
+    case VL53L0X_VCSEL_PERIOD_PRE_RANGE:
+        new_cfg.pre_range_vcsel_period = period;
+        break;
+    case VL53L0X_VCSEL_PERIOD_FINAL_RANGE:
+        new_cfg.final_range_vcsel_period = period;
+        break;
+    }
+    return vl53l0x_apply_cfg(&new_cfg);
+}
+
+vl53l0x_result_e vl53l0x_set_profile(vl53l0x_profile_e profile)
+{
+    ASSERT(initialized);
+    return vl53l0x_apply_cfg(&profile_cfgs[profile]);
+}
 
 /*
- * The approach is as follow:
- * For multiple sensors and single interrupt line:
+ * The sensors are pipelined independently of each other:
  * 1. Start measure on all sensors
- * 2. If measurement ready
- *    - Read measurement of all sensors
- * 3. else
- *    - Return old values
- * 4. Update measurement ready on interrupt
+ * 2. For each sensor with a measurement ready (the front sensor has an interrupt pin, the
+ *    others are polled once their measurement is about to finish)
+ *    - Read the measurement (clears the interrupt) and publish it with a new sequence
+ *      number and timestamp
+ *    - Start measure on the sensor again, unless it's ranging continuously
+ * 3. Return the latest values of all sensors
+ * This way the front sensor, which matters most during an attack, is not held back by the
+ * slowest sensor.
+ *
+ * Step 2 runs as register scripts in the background (see i2c_script_start), one script at a
+ * time. Each call moves on to the next script if the previous one is done, so the caller
+ * isn't stalled by the bus, but must call this often (e.g. every tick) to keep the sensors
+ * busy. The front sensor is checked first, so it's read as soon as possible.
  */
 // TODO: Verify this works after bring up real robot
 vl53l0x_result_e vl53l0x_read_range_multiple(vl53l0x_ranges_t ranges, bool *fresh_values)
 {
     ASSERT(initialized);
-    vl53l0x_result_e result = VL53L0X_RESULT_OK;
-    if (status_multiple == STATUS_MULTIPLE_NOT_STARTED) {
-        result = vl53l0x_start_measuring_multiple();
-        if (result) {
-            return result;
-        }
-        // Block here the first time
-        while (status_multiple != STATUS_MULTIPLE_DONE) { }
-    }
-
-    if (status_multiple == STATUS_MULTIPLE_DONE
-        // We already know front is done because of its interrupt
-        //&& vl53l0x_is_sysrange_done(VL53L0X_IDX_FRONT)
-        && vl53l0x_is_sysrange_done(VL53L0X_IDX_LEFT) && vl53l0x_is_sysrange_done(VL53L0X_IDX_RIGHT)
-        && vl53l0x_is_sysrange_done(VL53L0X_IDX_FRONT_LEFT)
-        && vl53l0x_is_sysrange_done(VL53L0X_IDX_FRONT_RIGHT)) {
-
-        if (!vl53l0x_is_sysrange_done(VL53L0X_IDX_FRONT)) {
-            // Sanity check!
-            ASSERT(false);
-        }
-
-        result = vl53l0x_read_range(VL53L0X_IDX_FRONT, &latest_ranges[VL53L0X_IDX_FRONT]);
-        if (result) {
-            return result;
-        }
-#if defined(NSUMO)
-        result = vl53l0x_read_range(VL53L0X_IDX_FRONT_LEFT, &latest_ranges[VL53L0X_IDX_FRONT_LEFT]);
-        if (result) {
-            return result;
-        }
-        result =
-            vl53l0x_read_range(VL53L0X_IDX_FRONT_RIGHT, &latest_ranges[VL53L0X_IDX_FRONT_RIGHT]);
+    *fresh_values = false;
+    if (!measuring) {
+        const vl53l0x_result_e result = vl53l0x_start_measuring_multiple();
         if (result) {
             return result;
         }
-#endif
-#if 0 // Skip left and right, since they are are mounted badly
-        result = vl53l0x_read_range(VL53L0X_IDX_LEFT, &latest_ranges[VL53L0X_IDX_LEFT]);
-        if (result) {
-            return result;
+        // Block here the first time, but not forever if the sensor never interrupts
+        uint32_t period_ms = cfg.timing_budget_us / 1000;
+        if (ranging == VL53L0X_RANGING_TIMED && period_ms_timed > period_ms) {
+            period_ms = period_ms_timed;
         }
-        result = vl53l0x_read_range(VL53L0X_IDX_RIGHT, &latest_ranges[VL53L0X_IDX_RIGHT]);
-        if (result) {
-            return result;
+        const uint32_t wait_max_ms = FRONT_READY_TIMEOUT_PERIODS * period_ms;
+        const uint32_t wait_start_ms = millis();
+        while (!front_ready) {
+            if (millis() - wait_start_ms > wait_max_ms) {
+                return VL53L0X_RESULT_ERROR_TIMEOUT;
+            }
         }
-#endif
-        result = vl53l0x_start_measuring_multiple();
-        if (result) {
-            return result;
+    }
+
+    const vl53l0x_result_e result = vl53l0x_read_advance(fresh_values);
+    if (result) {
+        return result;
+    }
+    for (uint8_t i = 0; read_phase == READ_PHASE_IDLE && i < ARRAY_SIZE(measured_idxs); i++) {
+        if (vl53l0x_is_measurement_ready(measured_idxs[i])) {
+            vl53l0x_read_start(measured_idxs[i]);
         }
-        *fresh_values = true;
-    } else {
-        *fresh_values = false;
     }
     for (int i = 0; i < VL53L0X_IDX_COUNT; i++) {
         ranges[i] = latest_ranges[i];
     }
-    return result;
+    return VL53L0X_RESULT_OK;
 }
 
 vl53l0x_result_e vl53l0x_init(void)
@@ -866,6 +1375,11 @@ vl53l0x_result_e vl53l0x_init(void)
     if (result) {
         return result;
     }
+    // Configured the same as the front sensor
+    result = vl53l0x_get_sequence_timeouts(&default_timeouts);
+    if (result) {
+        return result;
+    }
 #if defined(NSUMO)
     result = vl53l0x_init_config(VL53L0X_IDX_LEFT);
     if (result) {
@@ -884,6 +1398,9 @@ vl53l0x_result_e vl53l0x_init(void)
         return result;
     }
 #endif
+    for (uint8_t idx = 0; idx < VL53L0X_IDX_COUNT; idx++) {
+        poll_delay_ms[idx] = POLL_DELAY_ms(cfg.timing_budget_us);
+    }
     initialized = true;
     return VL53L0X_RESULT_OK;
 }
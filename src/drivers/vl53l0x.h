@@ -23,9 +23,45 @@ typedef enum
     VL53L0X_RESULT_ERROR_BOOT,
     VL53L0X_RESULT_ERROR_SPAD,
     VL53L0X_RESULT_ERROR_MEASURE_ONGOING,
+    VL53L0X_RESULT_ERROR_TIMING_BUDGET,
+    VL53L0X_RESULT_ERROR_TIMEOUT,
 } vl53l0x_result_e;
 
-typedef uint16_t vl53l0x_ranges_t[VL53L0X_IDX_COUNT];
+typedef enum
+{
+    // Started again after every read (default)
+    VL53L0X_RANGING_SINGLE,
+    // Back-to-back measurements, as often as the timing budget allows
+    VL53L0X_RANGING_CONTINUOUS,
+    // Measurements at a fixed period (longer than the timing budget)
+    VL53L0X_RANGING_TIMED,
+} vl53l0x_ranging_e;
+
+typedef enum
+{
+    VL53L0X_VCSEL_PERIOD_PRE_RANGE,
+    VL53L0X_VCSEL_PERIOD_FINAL_RANGE,
+} vl53l0x_vcsel_period_e;
+
+typedef enum
+{
+    // ~33 ms per measurement
+    VL53L0X_PROFILE_DEFAULT,
+    // ~20 ms per measurement, at the cost of accuracy
+    VL53L0X_PROFILE_HIGH_SPEED,
+    // ~33 ms per measurement, longer VCSEL periods and lower signal rate limit to see
+    // further, at the cost of more noise (e.g. from ambient light)
+    VL53L0X_PROFILE_LONG_RANGE,
+} vl53l0x_profile_e;
+
+struct vl53l0x_range
+{
+    uint16_t range; // mm or VL53L0X_OUT_OF_RANGE
+    uint16_t time_ms; // Lower 16 bits of millis when the measurement was read
+    uint8_t seq; // Incremented for every new measurement of the sensor
+};
+
+typedef struct vl53l0x_range vl53l0x_ranges_t[VL53L0X_IDX_COUNT];
 
 /**
  * Initializes the sensors in the vl53l0x_idx_e enum.
@@ -45,17 +81,64 @@ vl53l0x_result_e vl53l0x_read_range_single(vl53l0x_idx_e idx, uint16_t *range);
 
 /**
  * Reads all sensors. This is faster than reading sensors individually because
- * we do the measures in parallel. It starts measuring if no measurement is ongoing
- * and will return cached values if the measuring is not finished.
- * @param ranges contains the measured ranges (or VL53L0X_OUT_OF_RANGE
- *        if out of range).
- * @param fresh_values is true if the values are from a new measurement and
- *        false if cached values.
+ * we do the measures in parallel. It starts measuring if no measurement is ongoing,
+ * and each sensor is read and started again as soon as its measurement is done,
+ * independently of the other sensors. The bus transfers run in the background, each call
+ * only moves them on, so call it often (e.g. every millisecond) to keep the sensors busy.
+ * @param ranges contains the latest measurement of each sensor, check the sequence
+ *        number or timestamp to see which ones are new.
+ * @param fresh_values is true if at least one of the sensors has a new measurement
+ *        and false if all values are cached.
  * @return see vl53l0x_result_e
- * @note Blocks until range measurement is done when called the first time (unless
- *       vl53l0x_start_measuring_multiple has been called)
- * @note Returns values from the last measurement if measuring is not finished
+ * @note Doesn't wait for the bus, but blocks until the front sensor is done when called
+ *       the first time (unless vl53l0x_start_measuring_multiple has been called),
+ *       VL53L0X_RESULT_ERROR_TIMEOUT if it takes longer than two measurements
  */
 vl53l0x_result_e vl53l0x_read_range_multiple(vl53l0x_ranges_t ranges, bool *fresh_values);
 
+/**
+ * Sets how the sensors read by vl53l0x_read_range_multiple range. In the continuous modes
+ * they measure on their own, so reading them only reads the results and clears the
+ * interrupts, instead of also starting the next measurement.
+ * @param period_ms time between measurements in VL53L0X_RANGING_TIMED (ignored otherwise)
+ * @return see vl53l0x_result_e
+ * @note Waits for the bus transfers of vl53l0x_read_range_multiple and an ongoing single
+ *       measurement to finish, and the next call to
+ *       vl53l0x_read_range_multiple blocks until the first measurement in the new mode
+ * @note vl53l0x_read_range_single is only allowed in VL53L0X_RANGING_SINGLE
+ */
+vl53l0x_result_e vl53l0x_set_ranging(vl53l0x_ranging_e ranging, uint16_t period_ms);
+
+/**
+ * Sets the time the sensors have for a measurement, the longer the more accurate.
+ * @param budget_us at least 20000 us
+ * @return VL53L0X_RESULT_ERROR_TIMING_BUDGET if too short for the enabled sequence steps
+ * @note Doesn't block while measuring, each sensor is then reconfigured in the background
+ *       after its next read (vl53l0x_read_range_multiple), and skips a measurement meanwhile.
+ *       Otherwise, blocks until all sensors are reconfigured. The same goes for the functions
+ *       below.
+ */
+vl53l0x_result_e vl53l0x_set_timing_budget(uint32_t budget_us);
+
+/**
+ * Sets the VCSEL (laser) pulse period, a longer period increases the range.
+ * @param period in PCLKs, 12 to 18 for the pre range and 8 to 14 for the final range (even)
+ * @note The whole configuration is written on any change, followed by the phase calibration
+ *       (one extra measurement), which depends on the period
+ */
+vl53l0x_result_e vl53l0x_set_vcsel_period(vl53l0x_vcsel_period_e type, uint8_t period);
+
+/**
+ * Sets the timing budget, VCSEL periods and signal rate limit of a profile, nothing is
+ * written if the profile is already set.
+ */
+vl53l0x_result_e vl53l0x_set_profile(vl53l0x_profile_e profile);
+
+#ifndef DISABLE_TRACE
+// Bus bytes and time of the last start and read of a measurement (see i2c_script_stats)
+void vl53l0x_trace_script_stats(void);
+#else
+#define vl53l0x_trace_script_stats() ;
+#endif
+
 #endif // VL53L0X_H
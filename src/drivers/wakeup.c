@@ -0,0 +1,29 @@
+#include "drivers/wakeup.h"
+#include <msp430.h>
+
+static volatile uint8_t events = 0;
+
+void wakeup_post(uint8_t new_events)
+{
+    events |= new_events;
+}
+
+bool wakeup_pending(void)
+{
+    return events != 0;
+}
+
+uint8_t wakeup_wait(void)
+{
+    __disable_interrupt();
+    while (!events) {
+        /* Enables the interrupts and sleeps in the same instruction, so an event posted right
+         * before can't be missed. Returns (with interrupts enabled) after WAKEUP_ON_EXIT. */
+        __bis_SR_register(LPM0_bits + GIE);
+        __disable_interrupt();
+    }
+    const uint8_t taken = events;
+    events = 0;
+    __enable_interrupt();
+    return taken;
+}
@@ -0,0 +1,37 @@
+#ifndef WAKEUP_H
+#define WAKEUP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Lets the main loop sleep in low power mode 0 (CPU off, clocks and peripherals on) until an
+ * interrupt posts a wakeup event, instead of spinning. The events tell the loop which inputs
+ * may have changed. The CPU is woken by clearing the sleep bits of the status register that
+ * the interrupt saved on the stack, so it must be done at the end of the interrupt function
+ * itself (WAKEUP_ON_EXIT), not in a callback called from it. */
+
+typedef enum
+{
+    WAKEUP_TICK = 1u << 0, // Every millisecond (timers, polled sensors)
+    WAKEUP_LINE = 1u << 1, // Line edge (ADC interrupt)
+    WAKEUP_RANGE = 1u << 2, // Front range sensor measurement done (GPIO interrupt)
+    WAKEUP_IR = 1u << 3, // Remote control command
+    WAKEUP_UART = 1u << 4, // Console input
+} wakeup_event_e;
+#define WAKEUP_ALL (WAKEUP_TICK | WAKEUP_LINE | WAKEUP_RANGE | WAKEUP_IR | WAKEUP_UART)
+
+#define WAKEUP_ON_EXIT()                                                                           \
+    do {                                                                                           \
+        if (wakeup_pending()) {                                                                    \
+            __bic_SR_register_on_exit(LPM0_bits);                                                  \
+        }                                                                                          \
+    } while (0)
+
+/* From interrupt context or the main loop (a single instruction, so no need to disable
+ * interrupts) */
+void wakeup_post(uint8_t events);
+bool wakeup_pending(void);
+// Sleeps until at least one event is posted (returns right away if already), returns them
+uint8_t wakeup_wait(void);
+
+#endif // WAKEUP_H
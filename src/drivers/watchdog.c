@@ -0,0 +1,17 @@
+#include "drivers/watchdog.h"
+#include <msp430.h>
+
+/* WDTSSEL: ACLK
+ * WDTIS0/WDTIS1 cleared: Reset after 32768 clock cycles
+ * WDTCNTCL: Clear the counter */
+#define WDT_ACLK_32768_CLEAR (WDTPW + WDTSSEL + WDTCNTCL)
+
+void watchdog_start(void)
+{
+    WDTCTL = WDT_ACLK_32768_CLEAR;
+}
+
+void watchdog_kick(void)
+{
+    WDTCTL = WDT_ACLK_32768_CLEAR;
+}
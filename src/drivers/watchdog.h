@@ -0,0 +1,12 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+/* Resets the microcontroller if it isn't kicked in time, e.g. if the main loop gets stuck.
+ * It runs from ACLK (VLO), and the VLO varies between 4 and 20 kHz, so the timeout is
+ * somewhere between ~1.6 and ~8 s. It's held from boot (mcu_init) until started, so the
+ * initialization (e.g. of the range sensors) and the test functions don't have to kick it. */
+
+void watchdog_start(void);
+void watchdog_kick(void);
+
+#endif // WATCHDOG_H
@@ -2,20 +2,30 @@
 #include "common/trace.h"
 #include "drivers/mcu_init.h"
 #include "drivers/ir_remote.h"
+#include "drivers/watchdog.h"
 #include "app/drive.h"
 #include "app/enemy.h"
 #include "app/line.h"
 #include "app/state_machine.h"
+#include "app/params.h"
+#include "app/console.h"
+#include "app/input_record.h"
 
 int main(void)
 {
     mcu_init();
     trace_init();
+    params_init();
+    console_init();
     drive_init();
     enemy_init();
     line_init();
     ir_remote_init();
+#if defined(INPUT_RECORD)
+    input_record_init();
+#endif
 
+    watchdog_start();
     state_machine_run();
 
     ASSERT(0);
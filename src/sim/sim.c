@@ -0,0 +1,377 @@
+#include "sim/sim.h"
+#include "sim/sim_arena.h"
+#include "sim/sim_replay.h"
+#include "common/defines.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/* The simulation is configured through environment variables to keep main.c identical
+ * between the host build and the target build.
+ * SIM_DURATION_MS: Virtual time a match lasts before it's a draw
+ * SIM_START_MS: Virtual time at which the start command is sent (leaves the wait state)
+ * SIM_MATCHES: Number of matches to run, each from a different starting position
+ * SIM_SEED: Seed of the first match (match n uses SIM_SEED + n)
+ * SIM_OPPONENT: 0 (static), 1 (charge) or 2 (wander), see sim_opponent_e
+ * SIM_OPPONENT_SPEED: Duty cycle of the opponent motors (0 to 100)
+ *
+ * The application code keeps its state in statics and never returns, so when running
+ * several matches, each one runs in a forked child process, which reports its result back
+ * through a pipe. */
+#define SIM_DEFAULT_DURATION_MS (10000u)
+#define SIM_DEFAULT_START_MS (100u)
+#define SIM_DEFAULT_MATCHES (1u)
+#define SIM_DEFAULT_SEED (1u)
+#define SIM_DEFAULT_OPPONENT (SIM_OPPONENT_CHARGE)
+#define SIM_DEFAULT_OPPONENT_SPEED (50u)
+#define SIM_START_CMD (IR_CMD_1)
+
+#define SIM_IR_CMD_QUEUE_SIZE (8u)
+#define NS_PER_S (1000000000ull)
+
+struct sim_motor
+{
+    tb6612fng_mode_e mode;
+    uint8_t duty_cycle;
+};
+
+struct sim_match_result
+{
+    sim_outcome_e outcome;
+    uint32_t end_ms;
+    struct sim_reaction_stats reaction;
+};
+
+struct sim_iteration_stats
+{
+    uint32_t count;
+    uint64_t min_ns;
+    uint64_t max_ns;
+    uint64_t total_ns;
+};
+
+static struct
+{
+    uint32_t duration_ms;
+    uint32_t start_ms;
+    uint32_t matches;
+    uint32_t seed;
+    sim_opponent_e opponent;
+    uint8_t opponent_speed;
+    int result_fd; // Pipe to the parent process, or -1 if single match
+    bool replay;
+    uint32_t time_ms;
+    uint16_t ranges[VL53L0X_IDX_COUNT];
+    struct qre1113_voltages line_voltages;
+    struct sim_motor motors[2];
+    ir_cmd_e ir_cmds[SIM_IR_CMD_QUEUE_SIZE];
+    uint8_t ir_cmd_cnt;
+    struct sim_iteration_stats iterations;
+    uint64_t iteration_start_ns;
+    uint64_t wall_start_ns;
+} sim;
+
+static uint64_t wall_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * NS_PER_S + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t env_or_default(const char *name, uint32_t default_value)
+{
+    const char *value = getenv(name);
+    return value ? (uint32_t)strtoul(value, NULL, 10) : default_value;
+}
+
+static void sim_iteration_record(void)
+{
+    const uint64_t now_ns = wall_time_ns();
+    if (sim.iteration_start_ns) {
+        const uint64_t elapsed_ns = now_ns - sim.iteration_start_ns;
+        struct sim_iteration_stats *it = &sim.iterations;
+        if (it->count == 0 || elapsed_ns < it->min_ns) {
+            it->min_ns = elapsed_ns;
+        }
+        if (elapsed_ns > it->max_ns) {
+            it->max_ns = elapsed_ns;
+        }
+        it->total_ns += elapsed_ns;
+        it->count++;
+    }
+}
+
+static const char *outcome_to_string(sim_outcome_e outcome)
+{
+    switch (outcome) {
+    case SIM_OUTCOME_ONGOING:
+        return "ONGOING";
+    case SIM_OUTCOME_WIN:
+        return "WIN";
+    case SIM_OUTCOME_LOSS:
+        return "LOSS";
+    case SIM_OUTCOME_DRAW:
+        return "DRAW";
+    }
+    return "";
+}
+
+static void reaction_stats_add(struct sim_reaction_stats *total,
+                               const struct sim_reaction_stats *stats)
+{
+    if (stats->count == 0) {
+        return;
+    }
+    if (total->count == 0 || stats->min_ms < total->min_ms) {
+        total->min_ms = stats->min_ms;
+    }
+    if (stats->max_ms > total->max_ms) {
+        total->max_ms = stats->max_ms;
+    }
+    total->total_ms += stats->total_ms;
+    total->count += stats->count;
+}
+
+static void reaction_stats_print(const struct sim_reaction_stats *stats)
+{
+    if (stats->count) {
+        printf("reaction min %u ms mean %u ms max %u ms (%u detections)", stats->min_ms,
+               stats->total_ms / stats->count, stats->max_ms, stats->count);
+    } else {
+        printf("no reactions");
+    }
+}
+
+static void match_result_print(uint32_t match, const struct sim_match_result *result)
+{
+    printf("sim: match %u (seed %u) %s at %u ms, ", match, sim.seed + match,
+           outcome_to_string(result->outcome), result->end_ms);
+    reaction_stats_print(&result->reaction);
+    printf("\n");
+}
+
+static void wall_time_print(uint32_t virtual_ms)
+{
+    const uint64_t wall_ns = wall_time_ns() - sim.wall_start_ns;
+    printf("sim: %u ms virtual time in %.3f ms wall time (%.0fx real time)\n", virtual_ms,
+           (double)wall_ns / 1e6, wall_ns ? (double)virtual_ms * 1e6 / (double)wall_ns : 0.0);
+}
+
+void sim_report(void)
+{
+    wall_time_print(sim.time_ms);
+    const struct sim_iteration_stats *it = &sim.iterations;
+    if (it->count) {
+        printf("sim: %u iterations, latency min %llu ns mean %llu ns max %llu ns\n", it->count,
+               (unsigned long long)it->min_ns, (unsigned long long)(it->total_ns / it->count),
+               (unsigned long long)it->max_ns);
+    }
+}
+
+static void sim_match_end(void)
+{
+    const struct sim_match_result result = {
+        .outcome = sim_arena_outcome() == SIM_OUTCOME_ONGOING ? SIM_OUTCOME_DRAW
+                                                               : sim_arena_outcome(),
+        .end_ms = sim.time_ms,
+        .reaction = *sim_arena_reaction_stats(),
+    };
+    if (sim.result_fd >= 0) {
+        const ssize_t written = write(sim.result_fd, &result, sizeof(result));
+        _exit(written == sizeof(result) ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    match_result_print(0, &result);
+    sim_report();
+    exit(EXIT_SUCCESS);
+}
+
+static void sim_step(void)
+{
+    if (sim.time_ms == sim.start_ms) {
+        sim_ir_cmd_post(SIM_START_CMD);
+        sim_arena_start();
+    }
+    sim_arena_step();
+    if (sim_arena_outcome() != SIM_OUTCOME_ONGOING || sim.time_ms >= sim.duration_ms) {
+        sim_match_end();
+    }
+}
+
+// Returns in the child process (to run the application code) or exits when all are done
+static void run_matches(void)
+{
+    uint32_t outcomes[SIM_OUTCOME_DRAW + 1] = { 0 };
+    uint32_t crashes = 0;
+    uint64_t virtual_ms = 0;
+    struct sim_reaction_stats reaction = { 0 };
+    for (uint32_t match = 0; match < sim.matches; match++) {
+        int fds[2];
+        if (pipe(fds)) {
+            perror("pipe");
+            exit(EXIT_FAILURE);
+        }
+        const pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            exit(EXIT_FAILURE);
+        } else if (pid == 0) {
+            close(fds[0]);
+            sim.result_fd = fds[1];
+            sim_arena_init(sim.seed + match, sim.opponent, sim.opponent_speed);
+            // Traces from many matches are just noise, asserts still go to stderr
+            if (!freopen("/dev/null", "w", stdout)) {
+                _exit(EXIT_FAILURE);
+            }
+            return;
+        }
+        close(fds[1]);
+        struct sim_match_result result;
+        const bool received = read(fds[0], &result, sizeof(result)) == sizeof(result);
+        close(fds[0]);
+        int status;
+        waitpid(pid, &status, 0);
+        if (!received) {
+            // E.g. an assert (abort) in the application code
+            printf("sim: match %u (seed %u) CRASHED\n", match, sim.seed + match);
+            crashes++;
+            continue;
+        }
+        match_result_print(match, &result);
+        outcomes[result.outcome]++;
+        virtual_ms += result.end_ms;
+        reaction_stats_add(&reaction, &result.reaction);
+    }
+    const uint32_t finished = sim.matches - crashes;
+    printf("sim: %u matches, %u wins, %u losses, %u draws, %u crashes, win rate %.1f %%\n",
+           sim.matches, outcomes[SIM_OUTCOME_WIN], outcomes[SIM_OUTCOME_LOSS],
+           outcomes[SIM_OUTCOME_DRAW], crashes,
+           finished ? 100.0 * outcomes[SIM_OUTCOME_WIN] / finished : 0.0);
+    printf("sim: ");
+    reaction_stats_print(&reaction);
+    printf("\n");
+    wall_time_print((uint32_t)virtual_ms);
+    exit(crashes ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+void sim_init(void)
+{
+    sim.duration_ms = env_or_default("SIM_DURATION_MS", SIM_DEFAULT_DURATION_MS);
+    sim.start_ms = env_or_default("SIM_START_MS", SIM_DEFAULT_START_MS);
+    sim.matches = env_or_default("SIM_MATCHES", SIM_DEFAULT_MATCHES);
+    sim.seed = env_or_default("SIM_SEED", SIM_DEFAULT_SEED);
+    sim.opponent = (sim_opponent_e)env_or_default("SIM_OPPONENT", SIM_DEFAULT_OPPONENT);
+    sim.opponent_speed = (uint8_t)env_or_default("SIM_OPPONENT_SPEED", SIM_DEFAULT_OPPONENT_SPEED);
+    sim.result_fd = -1;
+    for (uint8_t i = 0; i < VL53L0X_IDX_COUNT; i++) {
+        sim.ranges[i] = VL53L0X_OUT_OF_RANGE;
+    }
+    sim.wall_start_ns = wall_time_ns();
+    // Don't buffer so that traces and asserts show up in order
+    setvbuf(stdout, NULL, _IONBF, 0);
+    if (sim.opponent > SIM_OPPONENT_WANDER || sim.opponent_speed > 100) {
+        fprintf(stderr, "sim: invalid SIM_OPPONENT or SIM_OPPONENT_SPEED\n");
+        exit(EXIT_FAILURE);
+    }
+#if defined(INPUT_REPLAY)
+    // Time and input come from the recording instead of the arena
+    sim.replay = true;
+    sim_replay_init();
+    return;
+#endif
+    if (sim.matches > 1) {
+        run_matches();
+    } else {
+        sim_arena_init(sim.seed, sim.opponent, sim.opponent_speed);
+    }
+}
+
+uint32_t sim_millis(void)
+{
+    return sim.time_ms;
+}
+
+void sim_set_millis(uint32_t ms)
+{
+    sim.time_ms = ms;
+}
+
+void sim_sleep_ms(uint32_t ms)
+{
+    sim_iteration_record();
+    // Step one millisecond at a time so no scheduled input is skipped, unless replaying, in
+    // which case the recording sets the time
+    for (uint32_t i = 0; i < ms && !sim.replay; i++) {
+        sim.time_ms++;
+        sim_step();
+    }
+    sim.iteration_start_ns = wall_time_ns();
+}
+
+void sim_set_range(vl53l0x_idx_e idx, uint16_t range)
+{
+    sim.ranges[idx] = range;
+}
+
+uint16_t sim_range(vl53l0x_idx_e idx)
+{
+    return sim.ranges[idx];
+}
+
+void sim_set_line_voltages(const struct qre1113_voltages *voltages)
+{
+    sim.line_voltages = *voltages;
+    sim_qre1113_sample(voltages);
+}
+
+void sim_line_voltages(struct qre1113_voltages *voltages)
+{
+    *voltages = sim.line_voltages;
+}
+
+void sim_ir_cmd_post(ir_cmd_e cmd)
+{
+    // Drop the command if full, same as a busy receiver would
+    if (sim.ir_cmd_cnt < ARRAY_SIZE(sim.ir_cmds)) {
+        sim.ir_cmds[sim.ir_cmd_cnt++] = cmd;
+    }
+}
+
+ir_cmd_e sim_ir_cmd_take(void)
+{
+    if (sim.ir_cmd_cnt == 0) {
+        return IR_CMD_NONE;
+    }
+    const ir_cmd_e cmd = sim.ir_cmds[0];
+    sim.ir_cmd_cnt--;
+    for (uint8_t i = 0; i < sim.ir_cmd_cnt; i++) {
+        sim.ir_cmds[i] = sim.ir_cmds[i + 1];
+    }
+    return cmd;
+}
+
+void sim_motor_set_mode(tb6612fng_e tb, tb6612fng_mode_e mode)
+{
+    sim.motors[tb].mode = mode;
+}
+
+void sim_motor_set_duty_cycle(tb6612fng_e tb, uint8_t duty_cycle)
+{
+    sim.motors[tb].duty_cycle = duty_cycle;
+}
+
+int8_t sim_motor_speed(tb6612fng_e tb)
+{
+    const struct sim_motor *motor = &sim.motors[tb];
+    switch (motor->mode) {
+    case TB6612FNG_MODE_STOP:
+        return 0;
+    case TB6612FNG_MODE_FORWARD:
+        return (int8_t)motor->duty_cycle;
+    case TB6612FNG_MODE_REVERSE:
+        return -(int8_t)motor->duty_cycle;
+    }
+    return 0;
+}
@@ -0,0 +1,41 @@
+#ifndef SIM_H
+#define SIM_H
+
+/* Simulated hardware for the host build (HW=HOST). The drivers used by the application
+ * code are replaced by simulated ones (src/sim/sim_*.c), which read and write the state
+ * kept here instead of touching registers. Time is a virtual clock that only advances when
+ * the application waits for an event (see sim_wakeup.c), so the application code runs as
+ * fast as the host allows instead of in real time. */
+
+#include "drivers/vl53l0x.h"
+#include "drivers/qre1113.h"
+#include "drivers/tb6612fng.h"
+#include "drivers/ir_remote.h"
+#include <stdint.h>
+
+void sim_init(void);
+// Prints the wall time and iteration latency
+void sim_report(void);
+
+// Virtual clock
+uint32_t sim_millis(void);
+void sim_set_millis(uint32_t ms);
+void sim_sleep_ms(uint32_t ms);
+
+// Sensor inputs
+void sim_set_range(vl53l0x_idx_e idx, uint16_t range);
+uint16_t sim_range(vl53l0x_idx_e idx);
+void sim_set_line_voltages(const struct qre1113_voltages *voltages);
+void sim_line_voltages(struct qre1113_voltages *voltages);
+// The line sensor interrupt on a new sample (see sim_qre1113.c)
+void sim_qre1113_sample(const struct qre1113_voltages *voltages);
+void sim_ir_cmd_post(ir_cmd_e cmd);
+ir_cmd_e sim_ir_cmd_take(void);
+
+// Motor outputs
+void sim_motor_set_mode(tb6612fng_e tb, tb6612fng_mode_e mode);
+void sim_motor_set_duty_cycle(tb6612fng_e tb, uint8_t duty_cycle);
+// Signed duty cycle (-100 to 100), negative when reversing
+int8_t sim_motor_speed(tb6612fng_e tb);
+
+#endif // SIM_H
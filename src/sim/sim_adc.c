@@ -0,0 +1,27 @@
+#include "drivers/adc.h"
+#include "common/defines.h"
+#include <string.h>
+
+// The line sensors are simulated at the qre1113 level (see sim_qre1113.c), so no sequences
+
+void adc_init(const struct adc_options *options)
+{
+    UNUSED(options);
+}
+
+void adc_get_channel_values(adc_channel_values_t values)
+{
+    memset(values, 0, sizeof(adc_channel_values_t));
+}
+
+uint32_t adc_get_sequence_count(void)
+{
+    return 0;
+}
+
+uint16_t adc_get_isr_cycles_max(void)
+{
+    return 0;
+}
+
+void adc_reset_isr_cycles_max(void) { }
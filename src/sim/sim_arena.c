@@ -0,0 +1,416 @@
+#include "sim/sim_arena.h"
+#include "sim/sim.h"
+#include "drivers/vl53l0x.h"
+#include "drivers/qre1113.h"
+#include "drivers/tb6612fng.h"
+#include "common/defines.h"
+#include <math.h>
+
+// Mini-sumo dohyo (77 cm diameter) with a white border line
+#define DOHYO_RADIUS_MM (385.0)
+#define DOHYO_LINE_WIDTH_MM (25.0)
+
+/* Both robots are 10x10 cm, but are modelled as circles to keep collisions and ray casting
+ * simple. The corners are what usually hit first, so use a radius slightly above half the
+ * width. */
+#define ROBOT_RADIUS_MM (55.0)
+#define ROBOT_WHEEL_TRACK_MM (85.0)
+// Wheel speed at 100 % duty cycle and time constant of the motors reaching a new speed
+#define ROBOT_MAX_SPEED_MM_PER_S (900.0)
+#define ROBOT_MOTOR_TIME_CONSTANT_S (0.05)
+
+#define STEP_S (0.001)
+#define SIM_PI (3.14159265358979323846)
+#define DEG_TO_RAD(deg) ((deg)*SIM_PI / 180.0)
+
+// What the QRE1113 reads above the black surface, the white line, and beyond the edge
+#define LINE_VOLTAGE_BLACK (900u)
+#define LINE_VOLTAGE_WHITE (150u)
+#define LINE_VOLTAGE_NOTHING (1000u)
+
+// VL53L0X field of view is 25 degrees, approximated by three rays
+#define RANGE_FOV_HALF_RAD DEG_TO_RAD(12.5)
+#define RANGE_MAX_MM (1200.0)
+// Same threshold as enemy.c uses to consider the opponent detected
+#define RANGE_DETECT_MM (600.0)
+
+#define START_RADIUS_MM (220.0)
+#define START_MIN_DISTANCE_MM (250.0)
+
+#define WANDER_TURN_PERIOD_MS (700u)
+
+struct vec2
+{
+    double x;
+    double y;
+};
+
+struct robot
+{
+    struct vec2 pos; // mm
+    double heading; // rad
+    struct vec2 direction; // cos and sin of heading, cached since they are used a lot
+    double wheel_speed_left; // mm/s
+    double wheel_speed_right; // mm/s
+};
+
+// Mounting position (x forward, y left of robot center) and direction of a sensor
+struct sensor_mount
+{
+    struct vec2 pos;
+    double angle;
+    struct vec2 direction; // Cached cos and sin of angle
+};
+
+static struct sensor_mount range_sensor_mounts[VL53L0X_IDX_COUNT] = {
+    [VL53L0X_IDX_FRONT] = { { 50.0, 0.0 }, 0.0 },
+    [VL53L0X_IDX_LEFT] = { { 0.0, 50.0 }, DEG_TO_RAD(90.0) },
+    [VL53L0X_IDX_RIGHT] = { { 0.0, -50.0 }, DEG_TO_RAD(-90.0) },
+    [VL53L0X_IDX_FRONT_LEFT] = { { 45.0, 35.0 }, DEG_TO_RAD(25.0) },
+    [VL53L0X_IDX_FRONT_RIGHT] = { { 45.0, -35.0 }, DEG_TO_RAD(-25.0) },
+};
+
+static struct vec2 fov_half_negative;
+static struct vec2 fov_half_positive;
+
+static const struct vec2 line_sensor_front_left = { 45.0, 45.0 };
+static const struct vec2 line_sensor_front_right = { 45.0, -45.0 };
+static const struct vec2 line_sensor_back_left = { -45.0, 45.0 };
+static const struct vec2 line_sensor_back_right = { -45.0, -45.0 };
+
+static struct
+{
+    struct robot us;
+    struct robot opponent;
+    sim_opponent_e opponent_strategy;
+    uint8_t opponent_speed;
+    double wander_turn; // -1, 0 or 1
+    uint32_t random_state;
+    bool started;
+    uint32_t started_ms;
+    sim_outcome_e outcome;
+    bool opponent_visible;
+    bool reaction_pending;
+    uint32_t visible_since_ms;
+    int8_t last_speed_left;
+    int8_t last_speed_right;
+    struct sim_reaction_stats reaction;
+} arena;
+
+// xorshift32, so each match is reproducible from its seed
+static uint32_t random_next(void)
+{
+    uint32_t x = arena.random_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    arena.random_state = x;
+    return x;
+}
+
+static double random_between(double min, double max)
+{
+    return min + (max - min) * ((double)random_next() / (double)UINT32_MAX);
+}
+
+static double vec2_length(struct vec2 v)
+{
+    return sqrt(v.x * v.x + v.y * v.y);
+}
+
+static double vec2_dot(struct vec2 a, struct vec2 b)
+{
+    return a.x * b.x + a.y * b.y;
+}
+
+static struct vec2 vec2_sub(struct vec2 a, struct vec2 b)
+{
+    return (struct vec2) { a.x - b.x, a.y - b.y };
+}
+
+static struct vec2 vec2_rotate(struct vec2 v, struct vec2 direction)
+{
+    return (struct vec2) { v.x * direction.x - v.y * direction.y,
+                           v.x * direction.y + v.y * direction.x };
+}
+
+static struct vec2 direction_of(double angle)
+{
+    return (struct vec2) { cos(angle), sin(angle) };
+}
+
+// Robot-local point to arena coordinates
+static struct vec2 robot_to_arena(const struct robot *robot, struct vec2 local)
+{
+    const struct vec2 rotated = vec2_rotate(local, robot->direction);
+    return (struct vec2) { robot->pos.x + rotated.x, robot->pos.y + rotated.y };
+}
+
+static double normalize_angle(double angle)
+{
+    while (angle > SIM_PI) {
+        angle -= 2.0 * SIM_PI;
+    }
+    while (angle < -SIM_PI) {
+        angle += 2.0 * SIM_PI;
+    }
+    return angle;
+}
+
+static bool outside_dohyo(struct vec2 pos)
+{
+    return vec2_length(pos) > DOHYO_RADIUS_MM;
+}
+
+// Differential drive with a first-order lag on each wheel (speeds in percent, -100 to 100)
+static void robot_move(struct robot *robot, double speed_left, double speed_right)
+{
+    const double k = STEP_S / ROBOT_MOTOR_TIME_CONSTANT_S;
+    robot->wheel_speed_left +=
+        (speed_left / 100.0 * ROBOT_MAX_SPEED_MM_PER_S - robot->wheel_speed_left) * k;
+    robot->wheel_speed_right +=
+        (speed_right / 100.0 * ROBOT_MAX_SPEED_MM_PER_S - robot->wheel_speed_right) * k;
+    const double speed = (robot->wheel_speed_left + robot->wheel_speed_right) / 2.0;
+    const double angular_speed =
+        (robot->wheel_speed_right - robot->wheel_speed_left) / ROBOT_WHEEL_TRACK_MM;
+    robot->pos.x += speed * robot->direction.x * STEP_S;
+    robot->pos.y += speed * robot->direction.y * STEP_S;
+    if (angular_speed != 0.0) {
+        robot->heading = normalize_angle(robot->heading + angular_speed * STEP_S);
+        robot->direction = direction_of(robot->heading);
+    }
+}
+
+/* Treat contact as between two equal masses: each robot is moved back by half the overlap
+ * along the line between them. A robot pushing one that stands still then moves at half its
+ * speed, and two robots pushing equally hard stall. Wheel traction is not modelled. */
+static void resolve_collision(void)
+{
+    const struct vec2 diff = vec2_sub(arena.opponent.pos, arena.us.pos);
+    const double distance = vec2_length(diff);
+    const double overlap = 2.0 * ROBOT_RADIUS_MM - distance;
+    if (overlap <= 0.0 || distance == 0.0) {
+        return;
+    }
+    const struct vec2 normal = { diff.x / distance, diff.y / distance };
+    arena.us.pos.x -= normal.x * overlap / 2.0;
+    arena.us.pos.y -= normal.y * overlap / 2.0;
+    arena.opponent.pos.x += normal.x * overlap / 2.0;
+    arena.opponent.pos.y += normal.y * overlap / 2.0;
+}
+
+// Distance along a ray to the opponent (circle), or a negative value if it misses
+static double ray_cast(struct vec2 origin, struct vec2 dir)
+{
+    const struct vec2 m = vec2_sub(origin, arena.opponent.pos);
+    const double b = vec2_dot(m, dir);
+    const double c = vec2_dot(m, m) - ROBOT_RADIUS_MM * ROBOT_RADIUS_MM;
+    if (c > 0.0 && b > 0.0) {
+        return -1.0;
+    }
+    const double discriminant = b * b - c;
+    if (discriminant < 0.0) {
+        return -1.0;
+    }
+    const double distance = -b - sqrt(discriminant);
+    return distance < 0.0 ? 0.0 : distance;
+}
+
+static uint16_t range_sensor_read(vl53l0x_idx_e idx)
+{
+    const struct sensor_mount *mount = &range_sensor_mounts[idx];
+    const struct vec2 origin = robot_to_arena(&arena.us, mount->pos);
+    const struct vec2 direction = vec2_rotate(mount->direction, arena.us.direction);
+    const double rays[] = { ray_cast(origin, direction),
+                            ray_cast(origin, vec2_rotate(direction, fov_half_negative)),
+                            ray_cast(origin, vec2_rotate(direction, fov_half_positive)) };
+    double closest = RANGE_MAX_MM;
+    for (uint8_t i = 0; i < ARRAY_SIZE(rays); i++) {
+        if (rays[i] >= 0.0 && rays[i] < closest) {
+            closest = rays[i];
+        }
+    }
+    return closest < RANGE_MAX_MM ? (uint16_t)closest : VL53L0X_OUT_OF_RANGE;
+}
+
+static uint16_t line_sensor_read(struct vec2 mount)
+{
+    const double distance = vec2_length(robot_to_arena(&arena.us, mount));
+    if (distance > DOHYO_RADIUS_MM) {
+        return LINE_VOLTAGE_NOTHING;
+    } else if (distance > DOHYO_RADIUS_MM - DOHYO_LINE_WIDTH_MM) {
+        return LINE_VOLTAGE_WHITE;
+    }
+    return LINE_VOLTAGE_BLACK;
+}
+
+static void update_sensors(void)
+{
+    for (uint8_t idx = 0; idx < VL53L0X_IDX_COUNT; idx++) {
+        sim_set_range(idx, range_sensor_read(idx));
+    }
+    const struct qre1113_voltages voltages = {
+        .front_left = line_sensor_read(line_sensor_front_left),
+        .front_right = line_sensor_read(line_sensor_front_right),
+        .back_left = line_sensor_read(line_sensor_back_left),
+        .back_right = line_sensor_read(line_sensor_back_right),
+    };
+    sim_set_line_voltages(&voltages);
+}
+
+static void opponent_turn_towards(double angle_error, double speed)
+{
+    if (fabs(angle_error) > DEG_TO_RAD(20.0)) {
+        const double turn = angle_error > 0.0 ? speed : -speed;
+        robot_move(&arena.opponent, -turn, turn);
+    } else {
+        const double steer = angle_error / DEG_TO_RAD(20.0) * speed / 2.0;
+        robot_move(&arena.opponent, speed - steer, speed + steer);
+    }
+}
+
+static void opponent_move(void)
+{
+    const double speed = arena.opponent_speed;
+    if (!arena.started) {
+        robot_move(&arena.opponent, 0.0, 0.0);
+        return;
+    }
+    switch (arena.opponent_strategy) {
+    case SIM_OPPONENT_STATIC:
+        robot_move(&arena.opponent, 0.0, 0.0);
+        break;
+    case SIM_OPPONENT_CHARGE:
+    {
+        const struct vec2 to_us = vec2_sub(arena.us.pos, arena.opponent.pos);
+        const double angle_error =
+            normalize_angle(atan2(to_us.y, to_us.x) - arena.opponent.heading);
+        opponent_turn_towards(angle_error, speed);
+    } break;
+    case SIM_OPPONENT_WANDER:
+    {
+        const struct vec2 front = robot_to_arena(&arena.opponent, (struct vec2) { 60.0, 0.0 });
+        if (vec2_length(front) > DOHYO_RADIUS_MM - 2.0 * DOHYO_LINE_WIDTH_MM) {
+            // Head back towards the center
+            const double angle_error = normalize_angle(
+                atan2(-arena.opponent.pos.y, -arena.opponent.pos.x) - arena.opponent.heading);
+            opponent_turn_towards(angle_error, speed);
+        } else {
+            if ((sim_millis() - arena.started_ms) % WANDER_TURN_PERIOD_MS == 0) {
+                arena.wander_turn = (double)(random_next() % 3) - 1.0;
+            }
+            const double steer = arena.wander_turn * speed / 3.0;
+            robot_move(&arena.opponent, speed - steer, speed + steer);
+        }
+    } break;
+    }
+}
+
+static void update_reaction(void)
+{
+    const uint32_t now_ms = sim_millis();
+    const bool visible = sim_range(VL53L0X_IDX_FRONT) < RANGE_DETECT_MM
+        || sim_range(VL53L0X_IDX_FRONT_LEFT) < RANGE_DETECT_MM
+        || sim_range(VL53L0X_IDX_FRONT_RIGHT) < RANGE_DETECT_MM;
+    const int8_t speed_left = sim_motor_speed(TB6612FNG_LEFT);
+    const int8_t speed_right = sim_motor_speed(TB6612FNG_RIGHT);
+    const bool motors_changed =
+        speed_left != arena.last_speed_left || speed_right != arena.last_speed_right;
+    arena.last_speed_left = speed_left;
+    arena.last_speed_right = speed_right;
+
+    if (visible && !arena.opponent_visible) {
+        arena.visible_since_ms = now_ms;
+        arena.reaction_pending = true;
+    } else if (!visible) {
+        // Lost before reacting, don't count it
+        arena.reaction_pending = false;
+    }
+    arena.opponent_visible = visible;
+
+    if (arena.reaction_pending && motors_changed) {
+        struct sim_reaction_stats *reaction = &arena.reaction;
+        const uint32_t reaction_ms = now_ms - arena.visible_since_ms;
+        if (reaction->count == 0 || reaction_ms < reaction->min_ms) {
+            reaction->min_ms = reaction_ms;
+        }
+        if (reaction_ms > reaction->max_ms) {
+            reaction->max_ms = reaction_ms;
+        }
+        reaction->total_ms += reaction_ms;
+        reaction->count++;
+        arena.reaction_pending = false;
+    }
+}
+
+static void update_outcome(void)
+{
+    const bool us_out = outside_dohyo(arena.us.pos);
+    const bool opponent_out = outside_dohyo(arena.opponent.pos);
+    if (us_out && opponent_out) {
+        arena.outcome = SIM_OUTCOME_DRAW;
+    } else if (us_out) {
+        arena.outcome = SIM_OUTCOME_LOSS;
+    } else if (opponent_out) {
+        arena.outcome = SIM_OUTCOME_WIN;
+    }
+}
+
+static void place_robot(struct robot *robot)
+{
+    const double angle = random_between(-SIM_PI, SIM_PI);
+    const double radius = random_between(0.0, START_RADIUS_MM);
+    robot->pos.x = radius * cos(angle);
+    robot->pos.y = radius * sin(angle);
+    robot->heading = random_between(-SIM_PI, SIM_PI);
+    robot->direction = direction_of(robot->heading);
+}
+
+void sim_arena_init(uint32_t seed, sim_opponent_e opponent, uint8_t opponent_speed)
+{
+    arena.random_state = seed ? seed : 1;
+    arena.opponent_strategy = opponent;
+    arena.opponent_speed = opponent_speed;
+    arena.outcome = SIM_OUTCOME_ONGOING;
+    for (uint8_t idx = 0; idx < VL53L0X_IDX_COUNT; idx++) {
+        range_sensor_mounts[idx].direction = direction_of(range_sensor_mounts[idx].angle);
+    }
+    fov_half_negative = direction_of(-RANGE_FOV_HALF_RAD);
+    fov_half_positive = direction_of(RANGE_FOV_HALF_RAD);
+    do {
+        place_robot(&arena.us);
+        place_robot(&arena.opponent);
+    } while (vec2_length(vec2_sub(arena.us.pos, arena.opponent.pos)) < START_MIN_DISTANCE_MM);
+    update_sensors();
+}
+
+void sim_arena_start(void)
+{
+    arena.started = true;
+    arena.started_ms = sim_millis();
+}
+
+void sim_arena_step(void)
+{
+    if (arena.outcome != SIM_OUTCOME_ONGOING) {
+        return;
+    }
+    robot_move(&arena.us, sim_motor_speed(TB6612FNG_LEFT), sim_motor_speed(TB6612FNG_RIGHT));
+    opponent_move();
+    resolve_collision();
+    update_sensors();
+    if (arena.started) {
+        update_reaction();
+    }
+    update_outcome();
+}
+
+sim_outcome_e sim_arena_outcome(void)
+{
+    return arena.outcome;
+}
+
+const struct sim_reaction_stats *sim_arena_reaction_stats(void)
+{
+    return &arena.reaction;
+}
@@ -0,0 +1,45 @@
+#ifndef SIM_ARENA_H
+#define SIM_ARENA_H
+
+/* 2D kinematic model of a mini-sumo match on the host (HW=HOST). Our robot is driven by
+ * the motor outputs of the application code, the opponent by a simple scripted strategy.
+ * Every step moves both robots (differential drive), resolves pushing, and produces the
+ * range sensor and line sensor inputs seen from our robot. */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum
+{
+    SIM_OPPONENT_STATIC, // Stands still
+    SIM_OPPONENT_CHARGE, // Turns towards us and drives straight at us
+    SIM_OPPONENT_WANDER, // Drives around and turns away from the edge
+} sim_opponent_e;
+
+typedef enum
+{
+    SIM_OUTCOME_ONGOING,
+    SIM_OUTCOME_WIN, // Opponent pushed out (or drove out)
+    SIM_OUTCOME_LOSS, // We left the dohyo
+    SIM_OUTCOME_DRAW,
+} sim_outcome_e;
+
+/* Reaction time is the time from when the opponent comes within detection range of one of
+ * the front range sensors until the application changes the motor outputs. */
+struct sim_reaction_stats
+{
+    uint32_t count;
+    uint32_t min_ms;
+    uint32_t max_ms;
+    uint32_t total_ms;
+};
+
+void sim_arena_init(uint32_t seed, sim_opponent_e opponent, uint8_t opponent_speed);
+// The opponent doesn't move until the match starts
+void sim_arena_start(void);
+// Advance one millisecond
+void sim_arena_step(void);
+sim_outcome_e sim_arena_outcome(void);
+const struct sim_reaction_stats *sim_arena_reaction_stats(void);
+
+#endif // SIM_ARENA_H
@@ -0,0 +1,17 @@
+#include "common/assert_handler.h"
+#include "sim/sim.h"
+#include "common/defines.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/* The host variant of ASSERT has no program counter to pass, so print the return address
+ * instead, which can be looked up the same way (make HW=HOST addr2line ADDR=...). Abort
+ * rather than blink so a debugger or core dump can show the full backtrace. */
+void assert_handler(uint16_t program_counter)
+{
+    UNUSED(program_counter);
+    fprintf(stderr, "ASSERT %p (%u ms)\n", __builtin_return_address(0), sim_millis());
+    // Keep what was written to the UART file (e.g. an input recording) up to the assert
+    fflush(NULL);
+    abort();
+}
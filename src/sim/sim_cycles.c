@@ -0,0 +1,28 @@
+#include "drivers/cycles.h"
+#include "common/defines.h"
+#include <time.h>
+
+#define NS_PER_S (1000000000ull)
+
+void cycles_init(void) { }
+
+// Host wall time scaled to the target clock, so it measures the host, not the target
+uint32_t cycles_get(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    const uint64_t ns = (uint64_t)ts.tv_sec * NS_PER_S + (uint64_t)ts.tv_nsec;
+    return (uint32_t)(ns * (CYCLES_16MHZ / CYCLES_1MHZ) / 1000u);
+}
+
+uint16_t cycles_get_16(void)
+{
+    return (uint16_t)cycles_get();
+}
+
+void cycles_get_extended(uint32_t *high, uint16_t *low)
+{
+    const uint32_t cycles = cycles_get();
+    *high = cycles >> 16;
+    *low = (uint16_t)cycles;
+}
@@ -0,0 +1,33 @@
+#include "drivers/flash.h"
+#include "common/assert_handler.h"
+#include <string.h>
+
+// The information flash in RAM (erased at boot, so the parameters start at their defaults)
+static uint8_t segments[FLASH_INFO_SEGMENT_COUNT][FLASH_INFO_SEGMENT_SIZE];
+
+void flash_init(void)
+{
+    memset(segments, 0xFF, sizeof(segments));
+}
+
+const void *flash_info_read(flash_info_segment_e segment)
+{
+    ASSERT(segment < FLASH_INFO_SEGMENT_COUNT);
+    return segments[segment];
+}
+
+void flash_info_erase(flash_info_segment_e segment)
+{
+    ASSERT(segment < FLASH_INFO_SEGMENT_COUNT);
+    memset(segments[segment], 0xFF, FLASH_INFO_SEGMENT_SIZE);
+}
+
+void flash_info_write(flash_info_segment_e segment, const void *data, uint8_t size)
+{
+    ASSERT(segment < FLASH_INFO_SEGMENT_COUNT && size <= FLASH_INFO_SEGMENT_SIZE);
+    // Like the flash, writing can only clear bits
+    const uint8_t *bytes = data;
+    for (uint8_t i = 0; i < size; i++) {
+        segments[segment][i] &= bytes[i];
+    }
+}
@@ -0,0 +1,9 @@
+#include "drivers/ir_remote.h"
+#include "sim/sim.h"
+
+void ir_remote_init(void) { }
+
+ir_cmd_e ir_remote_get_cmd(void)
+{
+    return sim_ir_cmd_take();
+}
@@ -0,0 +1,8 @@
+#include "drivers/mcu_init.h"
+#include "sim/sim.h"
+
+// There are no clocks, watchdog or pins to set up on the host, only the simulation itself
+void mcu_init(void)
+{
+    sim_init();
+}
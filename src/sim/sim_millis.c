@@ -0,0 +1,15 @@
+#include "drivers/millis.h"
+#include "sim/sim.h"
+
+void millis_init(void) { }
+
+uint32_t millis(void)
+{
+    return sim_millis();
+}
+
+// The virtual clock only has millisecond resolution
+uint32_t micros(void)
+{
+    return sim_millis() * 1000u;
+}
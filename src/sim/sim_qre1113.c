@@ -0,0 +1,48 @@
+#include "drivers/qre1113.h"
+#include "sim/sim.h"
+#include "common/assert_handler.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/* The real driver maps ADC channels to sensors through the pin configuration in io.c,
+ * which is register based, so the ADC is simulated at this level instead. */
+
+static qre1113_line_isr_t line_isr = NULL;
+static struct qre1113_voltages thresholds = { 0 };
+static uint8_t sensors_prev = 0;
+
+static bool initialized = false;
+void qre1113_init(void)
+{
+    ASSERT(!initialized);
+    initialized = true;
+}
+
+void qre1113_get_voltages(struct qre1113_voltages *voltages)
+{
+    sim_line_voltages(voltages);
+}
+
+void qre1113_set_line_isr(qre1113_line_isr_t isr)
+{
+    line_isr = isr;
+}
+
+void qre1113_set_thresholds(const struct qre1113_voltages *new_thresholds)
+{
+    thresholds = *new_thresholds;
+}
+
+// Same as the ADC interrupt of the real driver, but once per simulated millisecond
+void sim_qre1113_sample(const struct qre1113_voltages *voltages)
+{
+    uint8_t sensors = 0;
+    sensors |= voltages->front_left < thresholds.front_left ? QRE1113_FRONT_LEFT : 0;
+    sensors |= voltages->front_right < thresholds.front_right ? QRE1113_FRONT_RIGHT : 0;
+    sensors |= voltages->back_left < thresholds.back_left ? QRE1113_BACK_LEFT : 0;
+    sensors |= voltages->back_right < thresholds.back_right ? QRE1113_BACK_RIGHT : 0;
+    if (line_isr && sensors && !sensors_prev) {
+        line_isr(sensors);
+    }
+    sensors_prev = sensors;
+}
@@ -0,0 +1,81 @@
+#if defined(INPUT_REPLAY)
+#include "sim/sim_replay.h"
+#include "sim/sim.h"
+#include "app/input_record.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Replays a recording (see input_record.h) from the file in SIM_REPLAY_FILE. Each record is
+ * the input of one state machine iteration, and the virtual clock is set to the recorded
+ * time, so the application runs the same way it did when recording. */
+
+static FILE *file = NULL;
+static uint32_t time_ms = 0;
+static uint32_t record_count = 0;
+
+static void replay_fail(const char *reason)
+{
+    fprintf(stderr, "sim: replay failed after %u records, %s\n", record_count, reason);
+    exit(EXIT_FAILURE);
+}
+
+static uint8_t read_byte(void)
+{
+    const int c = fgetc(file);
+    if (c == EOF) {
+        replay_fail("truncated record");
+    }
+    return (uint8_t)c;
+}
+
+void sim_replay_init(void)
+{
+    const char *path = getenv("SIM_REPLAY_FILE");
+    if (!path) {
+        replay_fail("SIM_REPLAY_FILE not set");
+    }
+    file = fopen(path, "rb");
+    if (!file) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    uint8_t header[INPUT_RECORD_HEADER_SIZE];
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) || header[0] != 'N'
+        || header[1] != 'S' || header[2] != 'R') {
+        replay_fail("invalid header");
+    }
+    if (header[3] != INPUT_RECORD_VERSION) {
+        replay_fail("unsupported version");
+    }
+}
+
+void input_replay_next(struct input_record *record)
+{
+    const int first = fgetc(file);
+    if (first == EOF) {
+        printf("sim: replayed %u records (%u ms)\n", record_count, time_ms);
+        sim_report();
+        exit(EXIT_SUCCESS);
+    }
+    const uint8_t enemy = read_byte();
+    uint32_t delta_ms = (uint8_t)first >> INPUT_RECORD_DELTA_SHIFT;
+    record->line = (line_e)(first & INPUT_RECORD_LINE_MASK);
+    record->enemy.position = (enemy_pos_e)(enemy & INPUT_RECORD_POS_MASK);
+    record->enemy.range =
+        (enemy_range_e)((enemy >> INPUT_RECORD_RANGE_SHIFT) & INPUT_RECORD_RANGE_MASK);
+    record->fresh = enemy & INPUT_RECORD_FRESH_BIT;
+    record->cmd = (enemy & INPUT_RECORD_CMD_BIT) ? (ir_cmd_e)read_byte() : IR_CMD_NONE;
+    if (delta_ms == INPUT_RECORD_DELTA_EXTENDED) {
+        delta_ms = read_byte();
+        delta_ms |= (uint32_t)read_byte() << 8;
+    }
+    if (record->line > LINE_DIAGONAL_RIGHT || record->enemy.position > ENEMY_POS_IMPOSSIBLE) {
+        replay_fail("invalid record");
+    }
+    time_ms += delta_ms;
+    record->time_ms = time_ms;
+    record_count++;
+    sim_set_millis(time_ms);
+}
+
+#endif // INPUT_REPLAY
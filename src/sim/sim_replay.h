@@ -0,0 +1,8 @@
+#ifndef SIM_REPLAY_H
+#define SIM_REPLAY_H
+
+// Replay of an input recording in the host build (HW=HOST REPLAY=1), see input_record.h
+
+void sim_replay_init(void);
+
+#endif // SIM_REPLAY_H
@@ -0,0 +1,56 @@
+#include "drivers/tb6612fng.h"
+#include "sim/sim.h"
+#include "common/assert_handler.h"
+#include <stdbool.h>
+
+static bool initialized = false;
+void tb6612fng_init(void)
+{
+    ASSERT(!initialized);
+    initialized = true;
+}
+
+void tb6612fng_set_mode(tb6612fng_e tb, tb6612fng_mode_e mode)
+{
+    sim_motor_set_mode(tb, mode);
+}
+
+void tb6612fng_set_pwm(tb6612fng_e tb, uint8_t duty_cycle)
+{
+    // Same limit as the PWM driver
+    ASSERT(duty_cycle <= 100);
+    sim_motor_set_duty_cycle(tb, duty_cycle);
+}
+
+// The simulated interrupts only run between iterations, so no need for a critical section
+static bool emergency_posted = false;
+
+static void tb6612fng_write_motors(tb6612fng_mode_e mode_left, uint8_t duty_cycle_left,
+                                   tb6612fng_mode_e mode_right, uint8_t duty_cycle_right)
+{
+    tb6612fng_set_mode(TB6612FNG_LEFT, mode_left);
+    tb6612fng_set_mode(TB6612FNG_RIGHT, mode_right);
+    tb6612fng_set_pwm(TB6612FNG_LEFT, duty_cycle_left);
+    tb6612fng_set_pwm(TB6612FNG_RIGHT, duty_cycle_right);
+}
+
+bool tb6612fng_set_motors(tb6612fng_mode_e mode_left, uint8_t duty_cycle_left,
+                          tb6612fng_mode_e mode_right, uint8_t duty_cycle_right)
+{
+    if (emergency_posted) {
+        return false;
+    }
+    tb6612fng_write_motors(mode_left, duty_cycle_left, mode_right, duty_cycle_right);
+    return true;
+}
+
+void tb6612fng_post_emergency(tb6612fng_mode_e mode, uint8_t duty_cycle)
+{
+    emergency_posted = true;
+    tb6612fng_write_motors(mode, duty_cycle, mode, duty_cycle);
+}
+
+void tb6612fng_clear_emergency(void)
+{
+    emergency_posted = false;
+}
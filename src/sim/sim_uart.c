@@ -0,0 +1,62 @@
+#include "drivers/uart.h"
+#include "common/defines.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Written to the file in SIM_UART_FILE if set (e.g. to capture an input recording), stdout
+ * otherwise. Traces go to stdout directly (see trace.c). */
+static FILE *output = NULL;
+
+void uart_init(void)
+{
+    // Both trace and input record init the UART, which is fine on the host
+    if (output) {
+        return;
+    }
+    const char *path = getenv("SIM_UART_FILE");
+    output = path ? fopen(path, "wb") : stdout;
+    if (!output) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Written directly, so nothing is ever dropped or blocked
+void uart_set_tx_policy(uart_tx_policy_e policy)
+{
+    UNUSED(policy);
+}
+
+void uart_get_stats(struct uart_stats *stats)
+{
+    stats->tx_dropped = 0;
+    stats->tx_blocked = 0;
+    stats->rx_dropped = 0;
+}
+
+void uart_reset_stats(void) { }
+
+// Nothing is received in the simulation
+uint8_t uart_read(uint8_t *data, uint8_t size)
+{
+    UNUSED(data);
+    UNUSED(size);
+    return 0;
+}
+
+void _putchar(char c)
+{
+    fputc(c, output);
+}
+
+void uart_write(const uint8_t *data, uint16_t size)
+{
+    fwrite(data, 1, size, output);
+}
+
+void uart_init_assert(void) { }
+
+void uart_trace_assert(const char *string)
+{
+    fputs(string, stdout);
+}
@@ -0,0 +1,125 @@
+#include "drivers/vl53l0x.h"
+#include "sim/sim.h"
+#include "common/assert_handler.h"
+
+// A measurement takes as long as the timing budget
+#define SIM_TIMING_BUDGET_DEFAULT_MS (33u)
+#define SIM_TIMING_BUDGET_HIGH_SPEED_MS (20u)
+
+static bool initialized = false;
+static vl53l0x_ranging_e ranging = VL53L0X_RANGING_SINGLE;
+static uint32_t timing_budget_ms = SIM_TIMING_BUDGET_DEFAULT_MS;
+static uint32_t period_ms_timed = 0;
+static uint32_t measurement_period_ms = SIM_TIMING_BUDGET_DEFAULT_MS;
+static uint32_t last_measurement_ms = 0;
+static vl53l0x_ranges_t latest_ranges;
+
+vl53l0x_result_e vl53l0x_init(void)
+{
+    ASSERT(!initialized);
+    for (uint8_t i = 0; i < VL53L0X_IDX_COUNT; i++) {
+        latest_ranges[i].range = VL53L0X_OUT_OF_RANGE;
+    }
+    initialized = true;
+    return VL53L0X_RESULT_OK;
+}
+
+vl53l0x_result_e vl53l0x_read_range_single(vl53l0x_idx_e idx, uint16_t *range)
+{
+    ASSERT(initialized);
+    ASSERT(ranging == VL53L0X_RANGING_SINGLE);
+    *range = sim_range(idx);
+    return VL53L0X_RESULT_OK;
+}
+
+/* Same as the real driver, new values are only available when a measurement has finished.
+ * In single mode the next measurement starts when the values are read, while the sensors
+ * measure on their own in the continuous modes, so the period doesn't include the time
+ * until the values are read. */
+vl53l0x_result_e vl53l0x_read_range_multiple(vl53l0x_ranges_t ranges, bool *fresh_values)
+{
+    ASSERT(initialized);
+    const uint32_t now_ms = sim_millis();
+    const uint32_t elapsed_ms = now_ms - last_measurement_ms;
+    *fresh_values = elapsed_ms >= measurement_period_ms;
+    if (*fresh_values) {
+        if (ranging == VL53L0X_RANGING_SINGLE) {
+            last_measurement_ms = now_ms;
+        } else {
+            last_measurement_ms += elapsed_ms - (elapsed_ms % measurement_period_ms);
+        }
+        for (uint8_t i = 0; i < VL53L0X_IDX_COUNT; i++) {
+            latest_ranges[i].range = sim_range(i);
+            latest_ranges[i].time_ms = (uint16_t)now_ms;
+            latest_ranges[i].seq++;
+        }
+    }
+    for (uint8_t i = 0; i < VL53L0X_IDX_COUNT; i++) {
+        ranges[i] = latest_ranges[i];
+    }
+    return VL53L0X_RESULT_OK;
+}
+
+static void update_measurement_period(void)
+{
+    measurement_period_ms = timing_budget_ms;
+    if (ranging == VL53L0X_RANGING_TIMED && period_ms_timed > measurement_period_ms) {
+        measurement_period_ms = period_ms_timed;
+    }
+    last_measurement_ms = sim_millis();
+}
+
+vl53l0x_result_e vl53l0x_set_ranging(vl53l0x_ranging_e new_ranging, uint16_t period_ms)
+{
+    ASSERT(initialized);
+    ASSERT(new_ranging != VL53L0X_RANGING_TIMED || period_ms > 0);
+    ranging = new_ranging;
+    period_ms_timed = period_ms;
+    update_measurement_period();
+    return VL53L0X_RESULT_OK;
+}
+
+vl53l0x_result_e vl53l0x_set_timing_budget(uint32_t budget_us)
+{
+    ASSERT(initialized);
+    ASSERT(budget_us >= 20000);
+    timing_budget_ms = budget_us / 1000;
+    update_measurement_period();
+    return VL53L0X_RESULT_OK;
+}
+
+// Only affects the range on the real sensors, which isn't simulated
+vl53l0x_result_e vl53l0x_set_vcsel_period(vl53l0x_vcsel_period_e type, uint8_t period)
+{
+    ASSERT(initialized);
+    switch (type) {
+    case VL53L0X_VCSEL_PERIOD_PRE_RANGE:
+        ASSERT(period >= 12 && period <= 18 && !(period & 1));
+        break;
+    case VL53L0X_VCSEL_PERIOD_FINAL_RANGE:
+        ASSERT(period >= 8 && period <= 14 && !(period & 1));
+        break;
+    }
+    return VL53L0X_RESULT_OK;
+}
+
+vl53l0x_result_e vl53l0x_set_profile(vl53l0x_profile_e profile)
+{
+    ASSERT(initialized);
+    uint32_t new_timing_budget_ms = SIM_TIMING_BUDGET_DEFAULT_MS;
+    switch (profile) {
+    case VL53L0X_PROFILE_DEFAULT:
+    case VL53L0X_PROFILE_LONG_RANGE:
+        new_timing_budget_ms = SIM_TIMING_BUDGET_DEFAULT_MS;
+        break;
+    case VL53L0X_PROFILE_HIGH_SPEED:
+        new_timing_budget_ms = SIM_TIMING_BUDGET_HIGH_SPEED_MS;
+        break;
+    }
+    // Like the real sensors, a new profile costs the ongoing measurement
+    if (new_timing_budget_ms != timing_budget_ms) {
+        timing_budget_ms = new_timing_budget_ms;
+        update_measurement_period();
+    }
+    return VL53L0X_RESULT_OK;
+}
@@ -0,0 +1,22 @@
+#include "drivers/wakeup.h"
+#include "sim/sim.h"
+#include "common/defines.h"
+
+/* There are no interrupts in the simulation, so every wait is one tick (which advances the
+ * virtual clock) with all events, i.e. all inputs are read every millisecond like before. */
+
+void wakeup_post(uint8_t events)
+{
+    UNUSED(events);
+}
+
+bool wakeup_pending(void)
+{
+    return true;
+}
+
+uint8_t wakeup_wait(void)
+{
+    sim_sleep_ms(1);
+    return WAKEUP_ALL;
+}
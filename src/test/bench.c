@@ -0,0 +1,388 @@
+#include "drivers/mcu_init.h"
+#include "drivers/cycles.h"
+#include "drivers/vl53l0x.h"
+#include "drivers/qre1113.h"
+#include "app/drive.h"
+#include "app/line.h"
+#include "app/enemy.h"
+#include "app/input_history.h"
+#include "app/state_machine.h"
+#include "app/state_common.h"
+#include "app/params.h"
+#include "common/ring_buffer.h"
+#include "common/defines.h"
+#include "external/printf/printf.h"
+#include <msp430.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Measures the cycles per call of the hot functions with fixed input vectors. Built with the
+ * target flags and run in the mspdebug simulator with "make HW=NSUMO bench", which reads
+ * bench_results when the program reaches bench_done and writes them to a report (see
+ * tools/bench.py).
+ *
+ * The simulator emulates the CPU and Timer1_A (cycles_get), other peripherals are plain
+ * memory. That's enough for the drivers that only write registers, but the range and line
+ * sensor drivers wait for I2C and ADC, so they are replaced by the stubs below, which return
+ * the input vector instead. */
+
+#define BENCH_NAME_SIZE (10u)
+
+// Read by tools/bench.py, keep the layout in sync
+struct bench_result
+{
+    char name[BENCH_NAME_SIZE];
+    uint16_t calls;
+    uint32_t cycles_min;
+    uint32_t cycles_max;
+    uint32_t cycles_total;
+};
+
+struct bench
+{
+    const char *name;
+    // Sets up input vector i (not measured)
+    void (*setup)(uint8_t i);
+    void (*run)(void);
+    uint8_t vector_count;
+};
+
+static vl53l0x_ranges_t stub_ranges;
+static struct qre1113_voltages stub_voltages;
+
+vl53l0x_result_e vl53l0x_init(void)
+{
+    return VL53L0X_RESULT_OK;
+}
+
+vl53l0x_result_e vl53l0x_read_range_single(vl53l0x_idx_e idx, uint16_t *range)
+{
+    *range = stub_ranges[idx].range;
+    return VL53L0X_RESULT_OK;
+}
+
+vl53l0x_result_e vl53l0x_read_range_multiple(vl53l0x_ranges_t ranges, bool *fresh_values)
+{
+    memcpy(ranges, stub_ranges, sizeof(stub_ranges));
+    *fresh_values = true;
+    return VL53L0X_RESULT_OK;
+}
+
+vl53l0x_result_e vl53l0x_set_ranging(vl53l0x_ranging_e ranging, uint16_t period_ms)
+{
+    UNUSED(ranging);
+    UNUSED(period_ms);
+    return VL53L0X_RESULT_OK;
+}
+
+vl53l0x_result_e vl53l0x_set_timing_budget(uint32_t budget_us)
+{
+    UNUSED(budget_us);
+    return VL53L0X_RESULT_OK;
+}
+
+vl53l0x_result_e vl53l0x_set_vcsel_period(vl53l0x_vcsel_period_e type, uint8_t period)
+{
+    UNUSED(type);
+    UNUSED(period);
+    return VL53L0X_RESULT_OK;
+}
+
+vl53l0x_result_e vl53l0x_set_profile(vl53l0x_profile_e profile)
+{
+    UNUSED(profile);
+    return VL53L0X_RESULT_OK;
+}
+
+void qre1113_init(void) { }
+
+void qre1113_get_voltages(struct qre1113_voltages *voltages)
+{
+    *voltages = stub_voltages;
+}
+
+void qre1113_set_line_isr(qre1113_line_isr_t isr)
+{
+    UNUSED(isr);
+}
+
+void qre1113_set_thresholds(const struct qre1113_voltages *thresholds)
+{
+    UNUSED(thresholds);
+}
+
+// Front, front left, front right (mm), the other sensors are out of range
+static const uint16_t enemy_vectors[][3] = {
+    { VL53L0X_OUT_OF_RANGE, VL53L0X_OUT_OF_RANGE, VL53L0X_OUT_OF_RANGE },
+    { 150, VL53L0X_OUT_OF_RANGE, VL53L0X_OUT_OF_RANGE },
+    { 250, 280, VL53L0X_OUT_OF_RANGE },
+    { 90, 120, 110 },
+};
+
+static void bench_enemy_get_setup(uint8_t i)
+{
+    for (uint8_t idx = 0; idx < VL53L0X_IDX_COUNT; idx++) {
+        stub_ranges[idx].range = VL53L0X_OUT_OF_RANGE;
+    }
+    stub_ranges[VL53L0X_IDX_FRONT].range = enemy_vectors[i][0];
+    stub_ranges[VL53L0X_IDX_FRONT_LEFT].range = enemy_vectors[i][1];
+    stub_ranges[VL53L0X_IDX_FRONT_RIGHT].range = enemy_vectors[i][2];
+}
+
+static void bench_enemy_get_run(void)
+{
+    enemy_get();
+}
+
+// Front left, front right, back left, back right (below 700 is line)
+static const struct qre1113_voltages line_vectors[] = {
+    { 900, 900, 900, 900 },
+    { 300, 900, 900, 900 },
+    { 300, 300, 900, 900 },
+    { 900, 900, 900, 300 },
+};
+
+static void bench_line_get_setup(uint8_t i)
+{
+    stub_voltages = line_vectors[i];
+}
+
+static void bench_line_get_run(void)
+{
+    line_get();
+}
+
+static const drive_dir_e drive_vectors[] = {
+    DRIVE_DIR_FORWARD,
+    DRIVE_DIR_ROTATE_LEFT,
+    DRIVE_DIR_ARCTURN_WIDE_RIGHT,
+    DRIVE_DIR_REVERSE,
+};
+static drive_dir_e drive_dir;
+
+static void bench_drive_set_setup(uint8_t i)
+{
+    drive_dir = drive_vectors[i];
+}
+
+static void bench_drive_set_run(void)
+{
+    drive_set(drive_dir, DRIVE_SPEED_FAST);
+}
+
+// Same element type and size as the input history
+static struct input_history_buffer bench_rb;
+static const struct input bench_rb_input = { { ENEMY_POS_FRONT, ENEMY_RANGE_MID }, LINE_NONE };
+
+static void bench_rb_put_setup(uint8_t i)
+{
+    UNUSED(i);
+}
+
+static void bench_rb_put_run(void)
+{
+    input_history_buffer_put_overwrite(&bench_rb, &bench_rb_input);
+}
+
+static void bench_rb_get_setup(uint8_t i)
+{
+    UNUSED(i);
+    if (input_history_buffer_empty(&bench_rb)) {
+        input_history_buffer_put(&bench_rb, &bench_rb_input);
+    }
+}
+
+static void bench_rb_get_run(void)
+{
+    struct input input;
+    input_history_buffer_get(&bench_rb, &input);
+}
+
+// Same element type and size as the UART TX buffer
+DEFINE_RING_BUFFER(bench_queue, uint8_t, 16)
+static struct bench_queue bench_queue;
+static const uint8_t bench_queue_input = 'x';
+
+static void bench_queue_put_setup(uint8_t i)
+{
+    UNUSED(i);
+    if (bench_queue_full(&bench_queue)) {
+        bench_queue_get(&bench_queue, NULL);
+    }
+}
+
+static void bench_queue_put_run(void)
+{
+    bench_queue_put(&bench_queue, &bench_queue_input);
+}
+
+static void bench_queue_get_setup(uint8_t i)
+{
+    UNUSED(i);
+    if (bench_queue_empty(&bench_queue)) {
+        bench_queue_put(&bench_queue, &bench_queue_input);
+    }
+}
+
+static void bench_queue_get_run(void)
+{
+    uint8_t c;
+    bench_queue_get(&bench_queue, &c);
+}
+
+// A trace line worth of bytes, put with put_n and then emptied through a span
+static const uint8_t bench_chunk[12] = "f 150 fl 90\n";
+
+static void bench_put_n_setup(uint8_t i)
+{
+    UNUSED(i);
+    const uint8_t *span;
+    uint8_t count;
+    while ((count = bench_queue_peek_span(&bench_queue, &span))) {
+        bench_queue_commit_get(&bench_queue, count);
+    }
+}
+
+static void bench_put_n_run(void)
+{
+    bench_queue_put_n(&bench_queue, bench_chunk, sizeof(bench_chunk));
+}
+
+struct event_vector
+{
+    state_e state;
+    state_event_e event;
+    struct enemy enemy;
+};
+
+static const struct event_vector event_vectors[] = {
+    { STATE_SEARCH, STATE_EVENT_NONE, { ENEMY_POS_NONE, ENEMY_RANGE_NONE } },
+    { STATE_SEARCH, STATE_EVENT_TIMEOUT, { ENEMY_POS_NONE, ENEMY_RANGE_NONE } },
+    { STATE_SEARCH, STATE_EVENT_ENEMY, { ENEMY_POS_FRONT, ENEMY_RANGE_FAR } },
+    { STATE_ATTACK, STATE_EVENT_ENEMY, { ENEMY_POS_FRONT_LEFT, ENEMY_RANGE_CLOSE } },
+};
+static const struct event_vector *event_vector;
+
+static void bench_event_setup(uint8_t i)
+{
+    event_vector = &event_vectors[i];
+}
+
+static void bench_event_run(void)
+{
+    state_machine_bench_process_event(event_vector->state, event_vector->event,
+                                      &event_vector->enemy);
+}
+
+// The formatting of a typical trace, the output itself is limited by the UART
+static char printf_buffer[48];
+static uint8_t printf_vector;
+
+static void bench_printf_setup(uint8_t i)
+{
+    printf_vector = i;
+}
+
+static void bench_printf_run(void)
+{
+    switch (printf_vector) {
+    case 0:
+        snprintf(printf_buffer, sizeof(printf_buffer), "%s to %s (%s)", "SEARCH", "ATTACK",
+                 "ENEMY");
+        break;
+    case 1:
+        snprintf(printf_buffer, sizeof(printf_buffer), "f %u fl %u fr %u", 150u, 8190u, 42u);
+        break;
+    case 2:
+        snprintf(printf_buffer, sizeof(printf_buffer), "cycles %lu", 1234567ul);
+        break;
+    }
+}
+
+static void bench_overhead_setup(uint8_t i)
+{
+    UNUSED(i);
+}
+
+static void bench_overhead_run(void) { }
+
+static const struct bench benches[] = {
+    { "enemy_get", bench_enemy_get_setup, bench_enemy_get_run, ARRAY_SIZE(enemy_vectors) },
+    { "line_get", bench_line_get_setup, bench_line_get_run, ARRAY_SIZE(line_vectors) },
+    { "drive_set", bench_drive_set_setup, bench_drive_set_run, ARRAY_SIZE(drive_vectors) },
+    { "rb_put", bench_rb_put_setup, bench_rb_put_run, 1 },
+    { "rb_get", bench_rb_get_setup, bench_rb_get_run, 1 },
+    { "queue_put", bench_queue_put_setup, bench_queue_put_run, 1 },
+    { "queue_get", bench_queue_get_setup, bench_queue_get_run, 1 },
+    { "put_n", bench_put_n_setup, bench_put_n_run, 1 },
+    { "event", bench_event_setup, bench_event_run, ARRAY_SIZE(event_vectors) },
+    { "snprintf", bench_printf_setup, bench_printf_run, 3 },
+};
+
+#define BENCH_REPEAT (8u)
+
+struct bench_result bench_results[ARRAY_SIZE(benches)];
+
+static uint32_t bench_measure(const struct bench *bench, uint8_t i)
+{
+    bench->setup(i);
+    const uint32_t start = cycles_get();
+    bench->run();
+    return cycles_get() - start;
+}
+
+// Where tools/bench.py stops the simulator
+void __attribute__((noinline)) bench_done(void)
+{
+    while (1) { }
+}
+
+int main(void)
+{
+    mcu_init();
+    params_init();
+    drive_init();
+    line_init();
+    enemy_init();
+    /* Stop the millisecond tick (see millis.c), which the simulator delivers as well, so a
+     * sample that happens to contain it doesn't inflate the maximum. Nothing measured here
+     * needs millis(). The counter overflow interrupt stays on, since cycles_get needs it. */
+    TA1CCTL1 = 0;
+
+    // The cost of the measurement itself (cycles_get and the indirect call)
+    static const struct bench overhead = { "overhead", bench_overhead_setup, bench_overhead_run,
+                                           1 };
+    uint32_t overhead_cycles = UINT32_MAX;
+    for (uint8_t i = 0; i < BENCH_REPEAT; i++) {
+        const uint32_t cycles = bench_measure(&overhead, 0);
+        if (cycles < overhead_cycles) {
+            overhead_cycles = cycles;
+        }
+    }
+
+    for (uint8_t b = 0; b < ARRAY_SIZE(benches); b++) {
+        const struct bench *bench = &benches[b];
+        struct bench_result *result = &bench_results[b];
+        strncpy(result->name, bench->name, BENCH_NAME_SIZE - 1);
+        result->cycles_min = UINT32_MAX;
+        // Warm up, so one-time setup (e.g. of the state machine) isn't measured
+        for (uint8_t i = 0; i < bench->vector_count; i++) {
+            bench_measure(bench, i);
+        }
+        for (uint8_t repeat = 0; repeat < BENCH_REPEAT; repeat++) {
+            for (uint8_t i = 0; i < bench->vector_count; i++) {
+                const uint32_t cycles = bench_measure(bench, i) - overhead_cycles;
+                if (cycles < result->cycles_min) {
+                    result->cycles_min = cycles;
+                }
+                if (cycles > result->cycles_max) {
+                    result->cycles_max = cycles;
+                }
+                result->cycles_total += cycles;
+                result->calls++;
+            }
+        }
+    }
+    bench_done();
+    return 0;
+}
@@ -3,6 +3,7 @@
 #include "drivers/led.h"
 #include "drivers/uart.h"
 #include "drivers/ir_remote.h"
+#include "drivers/cycles.h"
 #include "drivers/pwm.h"
 #include "drivers/tb6612fng.h"
 #include "drivers/adc.h"
@@ -12,6 +13,8 @@
 #include "app/drive.h"
 #include "app/line.h"
 #include "app/enemy.h"
+#include "app/params.h"
+#include "app/console.h"
 #include "common/assert_handler.h"
 #include "common/defines.h"
 #include "common/enum_to_string.h"
@@ -195,6 +198,22 @@ static void test_ir_remote(void)
     }
 }
 
+SUPPRESS_UNUSED
+static void test_cycles(void)
+{
+    test_setup();
+    trace_init();
+    while (1) {
+        const uint32_t start = cycles_get();
+        BUSY_WAIT_ms(10);
+        const uint32_t elapsed = cycles_get() - start;
+        UNUSED(elapsed);
+        // Should be close to 160000
+        TRACE("Cycles %lu", elapsed);
+        BUSY_WAIT_ms(1000);
+    }
+}
+
 SUPPRESS_UNUSED
 static void test_pwm(void)
 {
@@ -248,7 +267,9 @@ static void test_drive(void)
 {
     test_setup();
     trace_init();
+    params_init();
     drive_init();
+    line_init();
     ir_remote_init();
     drive_speed_e speed = DRIVE_SPEED_SLOW;
     drive_dir_e dir = DRIVE_DIR_FORWARD;
@@ -302,7 +323,9 @@ SUPPRESS_UNUSED
 static void test_assert_motors(void)
 {
     test_setup();
+    params_init();
     drive_init();
+    line_init();
     drive_set(DRIVE_DIR_FORWARD, DRIVE_SPEED_MAX);
     BUSY_WAIT_ms(3000);
     ASSERT(0);
@@ -314,13 +337,21 @@ static void test_adc(void)
 {
     test_setup();
     trace_init();
-    adc_init();
+    const struct adc_options options = { .clock = ADC_CLOCK_FAST };
+    adc_init(&options);
+    uint32_t sequence_cnt_prev = adc_get_sequence_count();
     while (1) {
         adc_channel_values_t values;
         adc_get_channel_values(values);
         for (uint8_t i = 0; i < ADC_CHANNEL_COUNT; i++) {
             TRACE("ADC ch %u: %u", i, values[i]);
         }
+        // Roughly per second (the traces take some time too)
+        const uint32_t sequence_cnt = adc_get_sequence_count();
+        UNUSED(sequence_cnt_prev);
+        TRACE("ADC sequences/s: %lu isr max: %u cycles",
+              (unsigned long)(sequence_cnt - sequence_cnt_prev), adc_get_isr_cycles_max());
+        sequence_cnt_prev = sequence_cnt;
         BUSY_WAIT_ms(1000);
     }
 }
@@ -340,11 +371,27 @@ static void test_qre1113(void)
     }
 }
 
+SUPPRESS_UNUSED
+static void test_console(void)
+{
+    test_setup();
+    trace_init();
+    params_init();
+    console_init();
+    while (1) {
+        const console_request_e request = console_process();
+        if (request != CONSOLE_REQUEST_NONE) {
+            TRACE("Request %u", request);
+        }
+    }
+}
+
 SUPPRESS_UNUSED
 static void test_line(void)
 {
     test_setup();
     trace_init();
+    params_init();
     line_init();
     while (1) {
         TRACE("Line %u", line_to_string(line_get()));
@@ -394,6 +441,49 @@ static void test_i2c(void)
     }
 }
 
+static volatile uint16_t i2c_callback_count = 0;
+static void test_i2c_async_callback(struct i2c_transaction *transaction)
+{
+    UNUSED(transaction);
+    i2c_callback_count++;
+}
+
+SUPPRESS_UNUSED
+static void test_i2c_async(void)
+{
+    test_setup();
+    trace_init();
+    i2c_init();
+    // Same setup as test_i2c
+    io_set_out(IO_XSHUT_FRONT, IO_OUT_HIGH);
+    BUSY_WAIT_ms(100);
+    const uint8_t id_addr = 0xC0;
+    uint8_t vl53l0x_id = 0;
+    struct i2c_transaction transaction = { .slave_addr = 0x29,
+                                           .addr = &id_addr,
+                                           .addr_size = 1,
+                                           .rx_data = &vl53l0x_id,
+                                           .rx_size = 1,
+                                           .callback = test_i2c_async_callback };
+    while (1) {
+        vl53l0x_id = 0;
+        i2c_submit(&transaction);
+        // Count how long the CPU is free to do other things
+        uint16_t polls = 0;
+        while (i2c_poll(&transaction) == I2C_RESULT_PENDING) {
+            polls++;
+        }
+        UNUSED(polls);
+        if (transaction.result) {
+            TRACE("I2C error result %d", transaction.result);
+        } else {
+            TRACE("Read id 0x%X (expected 0xEE) after %u polls, %u callbacks", vl53l0x_id, polls,
+                  i2c_callback_count);
+        }
+        BUSY_WAIT_ms(1000);
+    }
+}
+
 SUPPRESS_UNUSED
 void test_vl53l0x(void)
 {
@@ -431,19 +521,28 @@ void test_vl53l0x_multiple(void)
     }
 
     while (1) {
-        vl53l0x_ranges_t ranges = { 0, 0, 0, 0, 0 };
+        vl53l0x_ranges_t ranges;
         bool fresh_values = false;
-        result = vl53l0x_read_range_multiple(ranges, &fresh_values);
+        // The reads run in the background and only move on when called, so call it often
+        result = VL53L0X_RESULT_OK;
+        for (uint16_t i = 0; i < 1000 && !result; i++) {
+            bool fresh = false;
+            result = vl53l0x_read_range_multiple(ranges, &fresh);
+            fresh_values |= fresh;
+            BUSY_WAIT_ms(1);
+        }
         if (result) {
             TRACE("Range measure failed (result %u)", result);
+        } else {
+            TRACE("Range measure (fresh %d) f %u fl %u fr %u l %u r %u", fresh_values,
+                  ranges[VL53L0X_IDX_FRONT].range, ranges[VL53L0X_IDX_FRONT_LEFT].range,
+                  ranges[VL53L0X_IDX_FRONT_RIGHT].range, ranges[VL53L0X_IDX_LEFT].range,
+                  ranges[VL53L0X_IDX_RIGHT].range);
+            TRACE("Sequence f %u fl %u fr %u", ranges[VL53L0X_IDX_FRONT].seq,
+                  ranges[VL53L0X_IDX_FRONT_LEFT].seq, ranges[VL53L0X_IDX_FRONT_RIGHT].seq);
         }
-        TRACE("Range measure (fresh %d) f %u fl %u fr %u l %u r %u", fresh_values,
-                                                          ranges[VL53L0X_IDX_FRONT],
-                                                          ranges[VL53L0X_IDX_FRONT_LEFT],
-                                                          ranges[VL53L0X_IDX_FRONT_RIGHT],
-                                                          ranges[VL53L0X_IDX_LEFT],
-                                                          ranges[VL53L0X_IDX_RIGHT]);
-        BUSY_WAIT_ms(1000);
+        vl53l0x_trace_script_stats();
+        TRACE("I2C isr max: %u cycles", i2c_get_isr_cycles_max());
     }
 }
 
@@ -452,6 +551,7 @@ void test_enemy(void)
 {
     test_setup();
     trace_init();
+    params_init();
     enemy_init();
     while (1) {
         struct enemy enemy = enemy_get();
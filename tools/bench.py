@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+"""Runs the benchmarks of src/test/bench.c in the mspdebug simulator (make HW=NSUMO bench)
+
+Stops the simulator when the program reaches bench_done, reads bench_results from memory and
+writes them as a JSON report. Pass an earlier report with --baseline to print the change in
+mean cycles per benchmark."""
+
+import argparse
+import json
+import os
+import re
+import shlex
+import struct
+import subprocess
+import sys
+
+# struct bench_result in src/test/bench.c (little endian, no padding)
+RESULT_FORMAT = '<10sHIII'
+RESULT_SIZE = struct.calcsize(RESULT_FORMAT)
+# mcu_init asserts that the DCO calibration (info flash A) has been programmed, use the values
+# of a typical device (CALDCO_16MHZ, CALBC1_16MHZ ... CALDCO_1MHZ, CALBC1_1MHZ)
+CALIBRATION = '0x10f8 0x95 0x8f 0x8a 0x8e 0x86 0x8d 0xb8 0x86'
+# Timer1_A, which cycles_get reads (CCR0 and overflow vectors)
+TIMER_SETUP = ['simio add timer ta1', 'simio config ta1 base 0x180',
+               'simio config ta1 irq0 13', 'simio config ta1 irq1 12',
+               'simio config ta1 iv 0x11e']
+TIMEOUT_S = 120
+MEMORY_LINE = re.compile(r'^\s*(?:0x)?[0-9a-fA-F]+:\s+((?:[0-9a-fA-F]{2}\s+)+)')
+
+
+def symbol(nm, elf, name):
+    output = subprocess.run([nm, '-S', elf], check=True, capture_output=True, text=True).stdout
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) == 4 and fields[3] == name:
+            return int(fields[0], 16), int(fields[1], 16)
+    sys.exit(f'{name} not found in {elf}')
+
+
+def command_with_env(command):
+    # The Makefile passes the command with its environment (LD_LIBRARY_PATH=... mspdebug)
+    args = shlex.split(command)
+    env = dict(os.environ)
+    while args and re.match(r'^\w+=', args[0]):
+        key, value = args.pop(0).split('=', 1)
+        env[key] = value
+    return args, env
+
+
+def simulate(mspdebug, elf, address, size):
+    args, env = command_with_env(mspdebug)
+    commands = [f'prog {elf}', f'mw {CALIBRATION}'] + TIMER_SETUP + [
+        'setbreak bench_done', 'setbreak assert_handler', 'run', f'md 0x{address:x} {size}']
+    try:
+        output = subprocess.run(args + ['-q', 'sim'] + commands, check=True, env=env,
+                                capture_output=True, text=True, timeout=TIMEOUT_S).stdout
+    except subprocess.TimeoutExpired:
+        sys.exit(f'Simulation did not finish within {TIMEOUT_S} s')
+    data = bytearray()
+    for line in output.splitlines():
+        memory = MEMORY_LINE.match(line)
+        if memory:
+            data += bytes.fromhex(memory.group(1))
+    if len(data) < size:
+        sys.exit(f'Could not read bench_results from the simulator output:\n{output}')
+    return bytes(data[:size])
+
+
+def parse(data):
+    benchmarks = []
+    for offset in range(0, len(data) - RESULT_SIZE + 1, RESULT_SIZE):
+        name, calls, cycles_min, cycles_max, cycles_total = struct.unpack_from(
+            RESULT_FORMAT, data, offset)
+        name = name.split(b'\0')[0].decode()
+        if calls == 0:
+            sys.exit(f'Benchmark {offset // RESULT_SIZE} ({name or "?"}) did not run, '
+                     'did the program assert?')
+        benchmarks.append({'name': name, 'calls': calls, 'min': cycles_min, 'max': cycles_max,
+                           'mean': round(cycles_total / calls, 1)})
+    return benchmarks
+
+
+def revision():
+    result = subprocess.run(['git', 'describe', '--always', '--dirty'], capture_output=True,
+                            text=True)
+    return result.stdout.strip() if result.returncode == 0 else 'unknown'
+
+
+def print_table(benchmarks, baseline):
+    baseline_means = {b['name']: b['mean'] for b in baseline['benchmarks']} if baseline else {}
+    print(f'{"name":<10} {"calls":>6} {"min":>8} {"max":>8} {"mean":>10} {"delta":>8}')
+    for b in benchmarks:
+        delta = ''
+        if b['name'] in baseline_means and baseline_means[b['name']]:
+            change = (b['mean'] - baseline_means[b['name']]) / baseline_means[b['name']]
+            delta = f'{change:+.1%}'
+        print(f'{b["name"]:<10} {b["calls"]:>6} {b["min"]:>8} {b["max"]:>8} '
+              f'{b["mean"]:>10} {delta:>8}')
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--mspdebug', default='mspdebug', help='mspdebug command')
+    parser.add_argument('--nm', default='msp430-elf-nm', help='nm of the msp430 toolchain')
+    parser.add_argument('--elf', required=True, help='bench program built with -DBENCH')
+    parser.add_argument('--report', required=True, help='where to write the JSON report')
+    parser.add_argument('--baseline', help='earlier report to compare against')
+    args = parser.parse_args()
+
+    baseline = None
+    if args.baseline:
+        with open(args.baseline) as baseline_file:
+            baseline = json.load(baseline_file)
+
+    address, size = symbol(args.nm, args.elf, 'bench_results')
+    benchmarks = parse(simulate(args.mspdebug, args.elf, address, size))
+    report = {'target': 'msp430g2553', 'unit': 'cycles', 'revision': revision(),
+              'benchmarks': benchmarks}
+    with open(args.report, 'w') as report_file:
+        json.dump(report, report_file, indent=2)
+        report_file.write('\n')
+    print_table(benchmarks, baseline)
+    print(f'Wrote {args.report}')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+"""Generates src/app/state_transitions.h from docs/state_machine.uml (make transitions)
+
+Reads the top-level transitions (From --> To : Event) of the diagram, including the ones
+in comments starting with '! (not drawn), and writes them as an X-macro. The event is the
+first line of the label. Transitions inside composite states are internal to the states
+and not part of the table. Completeness is checked when compiling state_machine.c."""
+
+import re
+import sys
+
+UML_PATH = 'docs/state_machine.uml'
+HEADER_PATH = 'src/app/state_transitions.h'
+COLUMN_LIMIT = 100
+
+TRANSITION = re.compile(r"^(?:'!\s*)?(\w+)\s*-+>\s*(\w+)\s*:\s*(.+)$")
+STATE = re.compile(r'^state\s+"[^"]*"\s+as\s+(\w+)$')
+
+
+def parse(path):
+    states = []
+    transitions = []
+    depth = 0
+    with open(path) as uml:
+        for line_nbr, line in enumerate(uml, 1):
+            line = line.strip()
+            if line.endswith('{'):
+                depth += 1
+                continue
+            if line == '}':
+                depth -= 1
+                continue
+            if depth > 0:
+                continue
+            state = STATE.match(line)
+            if state:
+                states.append(state.group(1))
+                continue
+            transition = TRANSITION.match(line)
+            if not transition:
+                continue
+            from_state, to_state, label = transition.groups()
+            for state in (from_state, to_state):
+                if state not in states:
+                    sys.exit(f'{path}:{line_nbr}: unknown state {state}')
+            event = label.split('\\n')[0].strip()
+            transitions.append((from_state.upper(), event.upper(), to_state.upper()))
+    return transitions
+
+
+def generate(transitions):
+    lines = [
+        '#ifndef STATE_TRANSITIONS_H',
+        '#define STATE_TRANSITIONS_H',
+        '',
+        '/* Generated from docs/state_machine.uml by tools/gen_state_transitions.py, don\'t',
+        ' * edit by hand, run "make transitions" instead.',
+        ' *',
+        ' * X(from, event, to), where from/to are state_e and event is state_event_e without',
+        ' * prefix. */',
+        '',
+    ]
+    macro = ['#define STATE_TRANSITIONS(X)']
+    macro += [f'    X({f}, {e}, {t})' for f, e, t in transitions]
+    for i, line in enumerate(macro):
+        if i < len(macro) - 1:
+            line = line.ljust(COLUMN_LIMIT - 1) + '\\'
+        lines.append(line)
+    lines += ['', '#endif // STATE_TRANSITIONS_H', '']
+    return '\n'.join(lines)
+
+
+def main():
+    with open(HEADER_PATH, 'w') as header:
+        header.write(generate(parse(UML_PATH)))
+
+
+if __name__ == '__main__':
+    main()
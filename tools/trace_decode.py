@@ -0,0 +1,164 @@
+#!/usr/bin/env python3
+"""Decodes the tokenized traces of a TRACE=TOKENIZED build (see src/common/trace.h)
+
+Looks up the format strings in the .trace_fmt section of the ELF, which isn't loaded to the
+target, and prints the traces read from the stream (a file, a configured serial port or
+stdin). Each frame is [sync][size][token (LE)][arguments], the arguments are decoded
+according to the conversions in the format string. A frame is only accepted if its token is
+known and its arguments fill it exactly, otherwise the decoder looks for the next sync byte,
+so it recovers from lost bytes. Skipped bytes are printed if they are text (e.g. an assert)."""
+
+import argparse
+import re
+import struct
+import sys
+
+SECTION = '.trace_fmt'
+SYNC = 0xA5
+SIZE_TRUNCATED = 0x80
+HEADER_SIZE = 2
+CONVERSION = re.compile(r'%[-+ #0]*\d*(?:\.\d+)?(l?)([diuxXcs%])')
+
+
+def read_section(elf_path, name):
+    with open(elf_path, 'rb') as elf_file:
+        elf = elf_file.read()
+    if elf[:4] != b'\x7fELF' or elf[4] != 1:
+        sys.exit(f'{elf_path} is not a 32-bit ELF')
+    shoff, = struct.unpack_from('<I', elf, 0x20)
+    shentsize, shnum, shstrndx = struct.unpack_from('<HHH', elf, 0x2E)
+    headers = [struct.unpack_from('<IIIIIIIIII', elf, shoff + i * shentsize)
+               for i in range(shnum)]
+    strtab_offset = headers[shstrndx][4]
+    for header in headers:
+        name_start = strtab_offset + header[0]
+        section_name = elf[name_start:elf.index(b'\0', name_start)].decode()
+        if section_name == name:
+            addr, offset, size = header[3], header[4], header[5]
+            return addr, elf[offset:offset + size]
+    sys.exit(f'{elf_path} has no {name} section, was it built with TRACE=TOKENIZED?')
+
+
+def format_strings(elf_path):
+    addr, data = read_section(elf_path, SECTION)
+    strings = {}
+    start = 0
+    while start < len(data):
+        end = data.index(b'\0', start)
+        if end > start:
+            strings[(addr + start) & 0xFFFF] = data[start:end].decode(errors='replace')
+        start = end + 1
+    return strings
+
+
+def decode_args(fmt, payload):
+    """Returns the arguments that fit in the payload and how many bytes they used"""
+    args = []
+    pos = 0
+    for long_modifier, conversion in CONVERSION.findall(fmt):
+        if conversion == '%':
+            continue
+        if conversion == 's':
+            if b'\0' not in payload[pos:]:
+                break
+            end = payload.index(b'\0', pos)
+            args.append(payload[pos:end].decode(errors='replace'))
+            pos = end + 1
+            continue
+        size = 4 if long_modifier else 2
+        if pos + size > len(payload):
+            break
+        signed = conversion in 'di'
+        value = int.from_bytes(payload[pos:pos + size], 'little', signed=signed)
+        pos += size
+        args.append(chr(value) if conversion == 'c' else value)
+    return tuple(args), pos
+
+
+def format_truncated(fmt, args):
+    """Formats the arguments that fit, and ? for the ones left out"""
+    remaining = list(args)
+
+    def replace(match):
+        if match.group(2) == '%':
+            return '%'
+        if not remaining:
+            return '?'
+        return match.group(0) % remaining.pop(0)
+    return '<truncated> ' + CONVERSION.sub(replace, fmt)
+
+
+def decode_frame(frame, truncated, strings):
+    """Returns the text of the frame, or None if it isn't a valid frame"""
+    token = int.from_bytes(frame[:2], 'little')
+    fmt = strings.get(token)
+    if fmt is None:
+        return None
+    args, used = decode_args(fmt, frame[2:])
+    if truncated:
+        return format_truncated(fmt, args) if used <= len(frame) - 2 else None
+    if used != len(frame) - 2:
+        return None
+    try:
+        return fmt % args
+    except (ValueError, TypeError):
+        return None
+
+
+def write_skipped(skipped, out):
+    """Prints the text in the skipped bytes and how many other bytes there were"""
+    text = bytes(byte for byte in skipped if 0x20 <= byte < 0x7F or byte in b'\n\t')
+    binary_count = len(skipped) - len(text) - skipped.count(b'\r')
+    if binary_count:
+        out.write(f'<skipped {binary_count} bytes>\n')
+    out.write(text.decode())
+    skipped.clear()
+
+
+def decode(stream, strings, out):
+    buffer = bytearray()
+    skipped = bytearray()
+    while True:
+        size = buffer[1] & ~SIZE_TRUNCATED if len(buffer) >= HEADER_SIZE else 0
+        if not buffer or (buffer[0] == SYNC and len(buffer) < HEADER_SIZE + size):
+            data = stream.read(HEADER_SIZE + size - len(buffer) if buffer else 1)
+            if not data:
+                skipped.extend(buffer)
+                write_skipped(skipped, out)
+                return
+            buffer.extend(data)
+            continue
+        frame = bytes(buffer[HEADER_SIZE:HEADER_SIZE + size])
+        text = None
+        if buffer[0] == SYNC and size >= 2:
+            text = decode_frame(frame, bool(buffer[1] & SIZE_TRUNCATED), strings)
+        if text is None:
+            # Not a frame (after lost bytes or text), look for the next sync byte
+            skipped.append(buffer.pop(0))
+            if skipped[-1] == ord('\n'):
+                write_skipped(skipped, out)
+            continue
+        write_skipped(skipped, out)
+        out.write(text)
+        out.flush()
+        del buffer[:HEADER_SIZE + size]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--elf', required=True, help='ELF the target runs')
+    parser.add_argument('input', nargs='?', default='-',
+                        help='trace stream, e.g. /dev/ttyUSB0 (configure it with '
+                        'stty -F /dev/ttyUSB0 115200 raw) or a logfile (default stdin)')
+    args = parser.parse_args()
+
+    strings = format_strings(args.elf)
+    if args.input == '-':
+        decode(sys.stdin.buffer, strings, sys.stdout)
+    else:
+        with open(args.input, 'rb', buffering=0) as stream:
+            decode(stream, strings, sys.stdout)
+
+
+if __name__ == '__main__':
+    main()